@@ -0,0 +1,133 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#include <string.h>
+
+#include "api_cache.h"
+#include "memory.h"
+
+/*
+ * The cache is meant for a small set of commands issued over and over, so
+ * the entries are searched linearly, only comparing the sources of the ones
+ * whose hashes match.
+ */
+
+/** FNV-1a over the source. */
+static uint32_t parse_cache_hash(const char *source)
+{
+    uint32_t hash = 2166136261u;
+    while (*source) {
+        hash ^= (unsigned char)*source++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void parse_cache_unlink(struct ParseCache *cache, struct ParseCacheEntry *entry)
+{
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        cache->first = entry->next;
+    }
+
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        cache->last = entry->prev;
+    }
+
+    --cache->size;
+}
+
+static void parse_cache_link_first(struct ParseCache *cache, struct ParseCacheEntry *entry)
+{
+    entry->prev = NULL;
+    entry->next = cache->first;
+
+    if (cache->first) {
+        cache->first->prev = entry;
+    } else {
+        cache->last = entry;
+    }
+
+    cache->first = entry;
+    ++cache->size;
+}
+
+void parse_cache_release(struct ParseCache *cache, struct ParseCacheEntry *entry)
+{
+    parse_cache_unlink(cache, entry);
+    alm_deinit(&entry->alm);
+    mem_free(entry->source);
+    mem_free(entry);
+}
+
+static void parse_cache_evict(struct ParseCache *cache, struct ParseCacheEntry *entry)
+{
+    ast_node_free(entry->expr);
+    parse_cache_release(cache, entry);
+}
+
+void parse_cache_init(struct ParseCache *cache, int capacity)
+{
+    cache->first = NULL;
+    cache->last = NULL;
+    cache->size = 0;
+    cache->capacity = capacity;
+    cache->hits = 0;
+    cache->misses = 0;
+}
+
+void parse_cache_deinit(struct ParseCache *cache)
+{
+    parse_cache_resize(cache, 0);
+}
+
+void parse_cache_resize(struct ParseCache *cache, int capacity)
+{
+    cache->capacity = capacity;
+    while (cache->size > capacity) {
+        parse_cache_evict(cache, cache->last);
+    }
+}
+
+struct ParseCacheEntry *parse_cache_find(struct ParseCache *cache, const char *source)
+{
+    struct ParseCacheEntry *entry;
+    uint32_t hash = parse_cache_hash(source);
+
+    for (entry = cache->first; entry; entry = entry->next) {
+        if (entry->hash == hash && strcmp(entry->source, source) == 0) {
+            parse_cache_unlink(cache, entry);
+            parse_cache_link_first(cache, entry);
+            ++cache->hits;
+            return entry;
+        }
+    }
+
+    ++cache->misses;
+    return NULL;
+}
+
+struct ParseCacheEntry *parse_cache_insert(
+        struct ParseCache *cache,
+        const char *source,
+        struct AstNode *expr,
+        struct AstLocMap *alm)
+{
+    struct ParseCacheEntry *entry = mem_malloc(sizeof(*entry));
+    int length = strlen(source);
+
+    if (cache->size == cache->capacity) {
+        parse_cache_evict(cache, cache->last);
+    }
+
+    entry->hash = parse_cache_hash(source);
+    entry->source = mem_malloc(length + 1);
+    memcpy(entry->source, source, length + 1);
+    entry->expr = expr;
+    entry->alm = *alm;
+
+    parse_cache_link_first(cache, entry);
+    return entry;
+}
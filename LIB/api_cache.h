@@ -0,0 +1,52 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#ifndef API_CACHE_H
+#define API_CACHE_H
+
+#include <stdint.h>
+
+#include "ast.h"
+#include "ast_loc_map.h"
+
+/**
+ * A parsed command, kept together with its source and location map. The
+ * entries are linked from the most to the least recently used.
+ */
+struct ParseCacheEntry {
+    struct ParseCacheEntry *prev;
+    struct ParseCacheEntry *next;
+    uint32_t hash;
+    char *source;
+    struct AstNode *expr;
+    struct AstLocMap alm;
+};
+
+struct ParseCache {
+    struct ParseCacheEntry *first;
+    struct ParseCacheEntry *last;
+    int size;
+    int capacity;
+    int64_t hits;
+    int64_t misses;
+};
+
+void parse_cache_init(struct ParseCache *cache, int capacity);
+void parse_cache_deinit(struct ParseCache *cache);
+
+/** Changes the capacity, evicting the least recently used entries. */
+void parse_cache_resize(struct ParseCache *cache, int capacity);
+
+/** Finds the entry of the source, making it the most recently used. */
+struct ParseCacheEntry *parse_cache_find(struct ParseCache *cache, const char *source);
+
+/** Takes over the parsed source, evicting the least recently used entry. */
+struct ParseCacheEntry *parse_cache_insert(
+        struct ParseCache *cache,
+        const char *source,
+        struct AstNode *expr,
+        struct AstLocMap *alm);
+
+/** Removes the entry whose AST has been taken over by the runtime. */
+void parse_cache_release(struct ParseCache *cache, struct ParseCacheEntry *entry);
+
+#endif
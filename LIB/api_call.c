@@ -0,0 +1,247 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "api_call.h"
+#include "api_view.h"
+#include "collection.h"
+#include "error.h"
+#include "runtime.h"
+
+/*
+ * A direct CLIF pushes its result through the calls below, which only keep
+ * track of the compounds it has started, so that they may be finalized once
+ * their elements are pushed. The errors of the handler are reported through
+ * the error state, like those of the BIFs. The values are checked like those
+ * of the literals: the elements of an array must be of matching types and no
+ * value may exceed the size a value can have.
+ */
+
+struct CallCompound {
+    VAL_LOC_T loc;
+    VAL_LOC_T size_loc;
+    VAL_LOC_T data_begin;
+    bool array;
+};
+
+struct MoonCall {
+    struct MoonViewScope scope;
+    VAL_LOC_T *arg_locs;
+    int arg_count;
+    int result_count;
+    struct { struct CallCompound *data; int cap, size; } open;
+};
+
+/** Checks whether another value may be pushed, counting the results. */
+static bool api_call_push(struct MoonCall *call)
+{
+    if (err_state()) {
+        return false;
+    }
+
+    if (call->open.size == 0 && call->result_count++ > 0) {
+        err_push("EVAL", "Direct CLIF returned more than one value");
+        return false;
+    }
+
+    return true;
+}
+
+/** Checks a value pushed into an array against the first element. */
+static void api_call_pushed(struct MoonCall *call, VAL_LOC_T loc)
+{
+    struct CallCompound *parent;
+
+    if (call->open.size == 0) {
+        return;
+    }
+
+    parent = call->open.data + call->open.size - 1;
+    if (parent->array &&
+        loc != parent->data_begin &&
+        !rt_val_pair_homo(call->scope.rt, parent->data_begin, loc)) {
+        err_push("EVAL", "Direct CLIF pushed array elements of distinct types");
+    }
+}
+
+void api_call_direct(
+        struct Runtime *rt,
+        DirectClifHandler handler,
+        VAL_LOC_T *arg_locs,
+        int arg_count)
+{
+    struct MoonCall call;
+
+    view_scope_init(&call.scope, rt);
+    call.arg_locs = arg_locs;
+    call.arg_count = arg_count;
+    call.result_count = 0;
+    call.open.data = NULL;
+    call.open.cap = 0;
+    call.open.size = 0;
+
+    handler(&call);
+
+    if (!err_state() && call.open.size > 0) {
+        err_push("EVAL", "Direct CLIF left a compound unfinished");
+    }
+
+    if (!err_state() && call.result_count == 0) {
+        rt_val_push_unit(&rt->stack);
+    }
+
+    ARRAY_FREE(call.open);
+    view_scope_deinit(&call.scope);
+}
+
+struct MoonView mn_call_arg(struct MoonCall *call, int index)
+{
+    return view_make(&call->scope, call->arg_locs[index]);
+}
+
+void mn_call_push_bool(struct MoonCall *call, bool value)
+{
+    VAL_LOC_T loc = call->scope.rt->stack.top;
+
+    if (api_call_push(call)) {
+        rt_val_push_bool(&call->scope.rt->stack, value);
+        api_call_pushed(call, loc);
+    }
+}
+
+void mn_call_push_char(struct MoonCall *call, char value)
+{
+    VAL_LOC_T loc = call->scope.rt->stack.top;
+
+    if (api_call_push(call)) {
+        rt_val_push_char(&call->scope.rt->stack, value);
+        api_call_pushed(call, loc);
+    }
+}
+
+void mn_call_push_int(struct MoonCall *call, int64_t value)
+{
+    VAL_LOC_T loc = call->scope.rt->stack.top;
+
+    if (api_call_push(call)) {
+        rt_val_push_int(&call->scope.rt->stack, value);
+        api_call_pushed(call, loc);
+    }
+}
+
+void mn_call_push_real(struct MoonCall *call, double value)
+{
+    VAL_LOC_T loc = call->scope.rt->stack.top;
+
+    if (api_call_push(call)) {
+        rt_val_push_real(&call->scope.rt->stack, value);
+        api_call_pushed(call, loc);
+    }
+}
+
+void mn_call_push_string(struct MoonCall *call, const char *value)
+{
+    VAL_LOC_T loc = call->scope.rt->stack.top;
+    size_t length = strlen(value);
+
+    if (length > UINT16_MAX / (VAL_HEAD_BYTES + VAL_CHAR_BYTES)) {
+        err_push("EVAL", "Direct CLIF pushed a string too long to be stored");
+        return;
+    }
+
+    if (api_call_push(call)) {
+        rt_val_push_string(
+            &call->scope.rt->stack,
+            (char*)value,
+            (char*)value + length);
+        api_call_pushed(call, loc);
+    }
+}
+
+void mn_call_push_unit(struct MoonCall *call)
+{
+    VAL_LOC_T loc = call->scope.rt->stack.top;
+
+    if (api_call_push(call)) {
+        rt_val_push_unit(&call->scope.rt->stack);
+        api_call_pushed(call, loc);
+    }
+}
+
+static void api_call_push_compound(struct MoonCall *call, bool array)
+{
+    struct CallCompound compound;
+    struct Stack *stack = &call->scope.rt->stack;
+
+    if (!api_call_push(call)) {
+        return;
+    }
+
+    compound.loc = stack->top;
+    compound.array = array;
+    if (array) {
+        rt_val_push_array_init(stack, &compound.size_loc);
+    } else {
+        rt_val_push_tuple_init(stack, &compound.size_loc);
+    }
+    compound.data_begin = stack->top;
+
+    ARRAY_APPEND(call->open, compound);
+}
+
+void mn_call_push_array(struct MoonCall *call)
+{
+    api_call_push_compound(call, true);
+}
+
+void mn_call_push_tuple(struct MoonCall *call)
+{
+    api_call_push_compound(call, false);
+}
+
+void mn_call_push_end(struct MoonCall *call)
+{
+    struct CallCompound compound;
+    struct Stack *stack = &call->scope.rt->stack;
+
+    if (err_state()) {
+        return;
+    }
+
+    if (call->open.size == 0) {
+        err_push("EVAL", "Direct CLIF ended a compound it has not started");
+        return;
+    }
+
+    compound = call->open.data[--call->open.size];
+    if (stack->top - compound.data_begin > UINT16_MAX) {
+        err_push("EVAL", "Direct CLIF pushed a compound too large to be stored");
+        return;
+    }
+
+    rt_val_push_cpd_final(stack, compound.size_loc, stack->top - compound.data_begin);
+    api_call_pushed(call, compound.loc);
+}
+
+void mn_call_push_copy(struct MoonCall *call, struct MoonView view)
+{
+    VAL_LOC_T loc;
+
+    if (view.entry) {
+        err_push("EVAL", "Direct CLIF may not push a dictionary entry");
+        return;
+    }
+
+    if (api_call_push(call)) {
+        loc = call->scope.rt->stack.top;
+        rt_val_push_copy(&call->scope.rt->stack, view.loc);
+        api_call_pushed(call, loc);
+    }
+}
+
+void mn_call_fail(struct MoonCall *call, const char *message)
+{
+    (void)call;
+    err_push("CLIF", "%s", message);
+}
@@ -0,0 +1,21 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#ifndef API_CALL_H
+#define API_CALL_H
+
+#include "moon.h"
+#include "rt_val.h"
+
+struct Runtime;
+
+/**
+ * Calls a direct CLIF handler on the provided argument locations, leaving
+ * its result on top of the stack.
+ */
+void api_call_direct(
+        struct Runtime *rt,
+        DirectClifHandler handler,
+        VAL_LOC_T *arg_locs,
+        int arg_count);
+
+#endif
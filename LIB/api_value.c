@@ -5,6 +5,45 @@
 #include "rt_val.h"
 #include "runtime.h"
 
+enum MoonValueType mn_api_value_type(struct Runtime *rt, VAL_LOC_T loc)
+{
+    if (rt_val_is_string(rt, loc)) {
+        return MN_STRING;
+    }
+
+    switch (rt_val_peek_type(&rt->stack, loc)) {
+    case VAL_BOOL:
+        return MN_BOOL;
+    case VAL_CHAR:
+        return MN_CHAR;
+    case VAL_INT:
+        return MN_INT;
+    case VAL_REAL:
+        return MN_REAL;
+    case VAL_ARRAY:
+        return MN_ARRAY;
+    case VAL_TUPLE:
+        return MN_TUPLE;
+    case VAL_DICT:
+        return MN_DICT;
+    case VAL_FUNCTION:
+        return MN_FUNCTION;
+    case VAL_SEQ:
+        return MN_SEQUENCE;
+    case VAL_SAMPLER:
+        return MN_SAMPLER;
+    case VAL_CHANNEL:
+        return MN_CHANNEL;
+    case VAL_PTR:
+        return MN_REFERENCE;
+    case VAL_DATATYPE:
+    case VAL_UNIT:
+        break;
+    }
+
+    return MN_UNIT;
+}
+
 struct MoonValue *mn_make_api_value(struct Runtime *rt, VAL_LOC_T loc)
 {
     struct MoonValue *result = mem_malloc(sizeof(*result));
@@ -48,10 +87,27 @@ struct MoonValue *mn_make_api_value(struct Runtime *rt, VAL_LOC_T loc)
         result->data.compound = mn_make_api_value_compound(rt, loc);
         break;
 
+    case VAL_DICT:
+        result->type = MN_DICT;
+        result->data.compound = mn_make_api_value_dict(rt, loc);
+        break;
+
     case VAL_FUNCTION:
         result->type = MN_FUNCTION;
         break;
 
+    case VAL_SEQ:
+        result->type = MN_SEQUENCE;
+        break;
+
+    case VAL_SAMPLER:
+        result->type = MN_SAMPLER;
+        break;
+
+    case VAL_CHANNEL:
+        result->type = MN_CHANNEL;
+        break;
+
     case VAL_PTR:
         result->type = MN_REFERENCE;
         result->data.pointer = rt_val_peek_ptr(rt, loc);
@@ -78,6 +134,23 @@ struct MoonValue *mn_make_api_value_compound(struct Runtime *rt, VAL_LOC_T loc)
     return result;
 }
 
+struct MoonValue *mn_make_api_value_dict(struct Runtime *rt, VAL_LOC_T loc)
+{
+    int i, len = rt_val_dict_len(&rt->stack, loc);
+    VAL_LOC_T current_loc = rt_val_dict_first_loc(&rt->stack, loc);
+    struct MoonValue *result = NULL, *result_end = NULL;
+    for (i = 0; i < len; ++i) {
+        struct MoonValue *entry = mem_malloc(sizeof(*entry));
+        VAL_LOC_T value_loc = rt_val_next_loc(rt, current_loc);
+        entry->type = MN_TUPLE;
+        entry->data.compound = mn_make_api_value(rt, current_loc);
+        entry->data.compound->next = mn_make_api_value(rt, value_loc);
+        entry->next = NULL;
+        LIST_APPEND(entry, &result, &result_end);
+        current_loc = rt_val_next_loc(rt, value_loc);
+    }
+    return result;
+}
 
 void mn_api_value_free(struct MoonValue *value)
 {
@@ -91,6 +164,9 @@ void mn_api_value_free(struct MoonValue *value)
         case MN_INT:
         case MN_REAL:
         case MN_FUNCTION:
+        case MN_SEQUENCE:
+        case MN_SAMPLER:
+        case MN_CHANNEL:
         case MN_REFERENCE:
         case MN_UNIT:
             break;
@@ -101,6 +177,7 @@ void mn_api_value_free(struct MoonValue *value)
 
         case MN_ARRAY:
         case MN_TUPLE:
+        case MN_DICT:
             mn_api_value_free(value->data.compound);
             break;
         }
@@ -6,8 +6,10 @@
 #include "moon.h"
 #include "rt_val.h"
 
+enum MoonValueType mn_api_value_type(struct Runtime *rt, VAL_LOC_T loc);
 struct MoonValue *mn_make_api_value(struct Runtime *rt, VAL_LOC_T loc);
 struct MoonValue *mn_make_api_value_compound(struct Runtime *rt, VAL_LOC_T loc);
+struct MoonValue *mn_make_api_value_dict(struct Runtime *rt, VAL_LOC_T loc);
 void mn_api_value_free(struct MoonValue *value);
 
 #endif
@@ -0,0 +1,210 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#include "api_value.h"
+#include "api_view.h"
+#include "memory.h"
+#include "rt_val.h"
+#include "runtime.h"
+
+/* The characters of a string are not contiguous on the stack, so the strings
+ * read through the views are copied to chunks, which live as long as the
+ * scope of the views. */
+#define VIEW_CHUNK_SIZE (64 * 1024)
+
+struct ViewChunk {
+    struct ViewChunk *next;
+    int size;
+    int cap;
+    char data[];
+};
+
+void view_scope_init(struct MoonViewScope *scope, struct Runtime *rt)
+{
+    scope->rt = rt;
+    scope->strings = NULL;
+}
+
+void view_scope_deinit(struct MoonViewScope *scope)
+{
+    while (scope->strings) {
+        struct ViewChunk *next = scope->strings->next;
+        mem_free(scope->strings);
+        scope->strings = next;
+    }
+}
+
+struct MoonView view_make(struct MoonViewScope *scope, VAL_LOC_T loc)
+{
+    struct MoonView result = { scope, loc, false };
+    return result;
+}
+
+static struct MoonView view_make_child(struct MoonView parent, VAL_LOC_T loc, bool entry)
+{
+    struct MoonView result = { parent.scope, loc, entry };
+    return result;
+}
+
+enum MoonValueType mn_view_type(struct MoonView view)
+{
+    return view.entry ? MN_TUPLE : mn_api_value_type(view.scope->rt, view.loc);
+}
+
+/** Returns the size of each element if they are all of the same size. */
+static VAL_SIZE_T mn_view_stride(struct Runtime *rt, VAL_LOC_T loc)
+{
+    VAL_LOC_T first_loc = rt_val_cpd_first_loc(loc);
+
+    if (rt_val_peek_type(&rt->stack, loc) != VAL_ARRAY ||
+        rt_val_peek_size(&rt->stack, loc) == 0) {
+        return 0;
+    }
+
+    switch (rt_val_peek_type(&rt->stack, first_loc)) {
+    case VAL_BOOL:
+    case VAL_CHAR:
+    case VAL_INT:
+    case VAL_REAL:
+    case VAL_UNIT:
+        return VAL_HEAD_BYTES + rt_val_peek_size(&rt->stack, first_loc);
+    default:
+        return 0;
+    }
+}
+
+int mn_view_len(struct MoonView view)
+{
+    struct Runtime *rt = view.scope->rt;
+    VAL_SIZE_T stride;
+
+    if (view.entry) {
+        return 2;
+    }
+
+    switch (rt_val_peek_type(&rt->stack, view.loc)) {
+    case VAL_ARRAY:
+        if ((stride = mn_view_stride(rt, view.loc))) {
+            return rt_val_peek_size(&rt->stack, view.loc) / stride;
+        }
+        return rt_val_cpd_len(rt, view.loc);
+
+    case VAL_TUPLE:
+        return rt_val_cpd_len(rt, view.loc);
+
+    case VAL_DICT:
+        return rt_val_dict_len(&rt->stack, view.loc);
+
+    default:
+        return 0;
+    }
+}
+
+struct MoonView mn_view_at(struct MoonView view, int index)
+{
+    struct Runtime *rt = view.scope->rt;
+    VAL_SIZE_T stride;
+    VAL_LOC_T loc;
+
+    if (view.entry) {
+        loc = index == 0 ? view.loc : rt_val_next_loc(rt, view.loc);
+        return view_make_child(view, loc, false);
+    }
+
+    if (rt_val_peek_type(&rt->stack, view.loc) == VAL_DICT) {
+        loc = rt_val_dict_first_loc(&rt->stack, view.loc);
+        while (index--) {
+            loc = rt_val_next_loc(rt, rt_val_next_loc(rt, loc));
+        }
+        return view_make_child(view, loc, true);
+    }
+
+    loc = rt_val_cpd_first_loc(view.loc);
+    if ((stride = mn_view_stride(rt, view.loc))) {
+        return view_make_child(view, loc + index * stride, false);
+    }
+
+    while (index--) {
+        loc = rt_val_next_loc(rt, loc);
+    }
+    return view_make_child(view, loc, false);
+}
+
+bool mn_view_visit(struct MoonView view, MoonViewVisitor visitor, void *data)
+{
+    struct Runtime *rt = view.scope->rt;
+    VAL_LOC_T loc;
+    int i, len = mn_view_len(view);
+    bool dict = !view.entry && rt_val_peek_type(&rt->stack, view.loc) == VAL_DICT;
+
+    if (len == 0) {
+        return true;
+    }
+
+    if (view.entry) {
+        loc = view.loc;
+    } else if (dict) {
+        loc = rt_val_dict_first_loc(&rt->stack, view.loc);
+    } else {
+        loc = rt_val_cpd_first_loc(view.loc);
+    }
+
+    for (i = 0; i < len; ++i) {
+        if (!visitor(view_make_child(view, loc, dict), data)) {
+            return false;
+        }
+        loc = rt_val_next_loc(rt, loc);
+        if (dict) {
+            loc = rt_val_next_loc(rt, loc);
+        }
+    }
+
+    return true;
+}
+
+bool mn_view_bool(struct MoonView view)
+{
+    return rt_val_peek_bool(view.scope->rt, view.loc);
+}
+
+char mn_view_char(struct MoonView view)
+{
+    return rt_val_peek_char(view.scope->rt, view.loc);
+}
+
+int64_t mn_view_int(struct MoonView view)
+{
+    return rt_val_peek_int(view.scope->rt, view.loc);
+}
+
+double mn_view_real(struct MoonView view)
+{
+    return rt_val_peek_real(view.scope->rt, view.loc);
+}
+
+const char *mn_view_string_ptr(struct MoonView view)
+{
+    struct Runtime *rt = view.scope->rt;
+    struct ViewChunk *chunk = view.scope->strings;
+    int i, len = mn_view_len(view);
+    VAL_LOC_T loc = rt_val_cpd_first_loc(view.loc);
+    char *result;
+
+    if (!chunk || chunk->cap - chunk->size < len + 1) {
+        int cap = len + 1 > VIEW_CHUNK_SIZE ? len + 1 : VIEW_CHUNK_SIZE;
+        chunk = mem_malloc(sizeof(*chunk) + cap);
+        chunk->next = view.scope->strings;
+        chunk->size = 0;
+        chunk->cap = cap;
+        view.scope->strings = chunk;
+    }
+
+    result = chunk->data + chunk->size;
+    for (i = 0; i < len; ++i) {
+        result[i] = rt_val_peek_char(rt, loc);
+        loc += VAL_HEAD_BYTES + VAL_CHAR_BYTES;
+    }
+    result[len] = '\0';
+    chunk->size += len + 1;
+
+    return result;
+}
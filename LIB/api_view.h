@@ -0,0 +1,24 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#ifndef API_VIEW_H
+#define API_VIEW_H
+
+#include "moon.h"
+#include "rt_val.h"
+
+struct ViewChunk;
+
+/**
+ * The runtime whose stack the views read and the buffers of the strings read
+ * through them, released together with the views.
+ */
+struct MoonViewScope {
+    struct Runtime *rt;
+    struct ViewChunk *strings;
+};
+
+void view_scope_init(struct MoonViewScope *scope, struct Runtime *rt);
+void view_scope_deinit(struct MoonViewScope *scope);
+struct MoonView view_make(struct MoonViewScope *scope, VAL_LOC_T loc);
+
+#endif
@@ -1,6 +1,7 @@
 /* Copyright (C) 2014-2016 Krzysztof Stachowiak */
 
 #include "stdlib.h"
+#include <string.h>
 
 #include "error.h"
 #include "memory.h"
@@ -9,26 +10,136 @@
 #include "runtime.h"
 #include "rt_val.h"
 #include "parse.h"
+#include "api_cache.h"
 #include "api_value.h"
+#include "api_view.h"
+#include "eval.h"
+#include "task.h"
 
 struct MoonContext {
     struct Runtime *rt;
+    struct MoonViewScope views;
+    struct ParseCache parse_cache;
 };
 
-struct MoonContext *mn_create(void)
+/* The scope of the captures of the function is only established once, the
+ * locations of the arguments are reused by each call. */
+struct MoonFunction {
+    struct MoonContext *ctx;
+    struct EvalCall call;
+    struct AstLocMap alm;
+    VAL_LOC_T *arg_locs;
+    char *symbol;
+};
+
+/* The parameters are bound in a scope of their own, established once, only
+ * their locations are updated by each execution. */
+struct MoonPrepared {
+    struct MoonContext *ctx;
+    struct AstNode *expr;
+    struct AstLocMap alm;
+    struct SymMap params;
+    struct SymMapNode **param_nodes;
+    int param_count;
+};
+
+static struct MoonContext *mn_make_context(struct Runtime *rt, int cache_capacity)
 {
     struct MoonContext *result = mem_malloc(sizeof(*result));
-    atexit(err_reset);
-    result->rt = rt_make();
+    result->rt = rt;
+    view_scope_init(&result->views, rt);
+    parse_cache_init(&result->parse_cache, cache_capacity);
     return result;
 }
 
+struct MoonContext *mn_create(void)
+{
+    return mn_make_context(rt_make(), 0);
+}
+
+struct MoonContext *mn_clone(struct MoonContext *ctx)
+{
+    return mn_make_context(rt_clone(ctx->rt), ctx->parse_cache.capacity);
+}
+
+bool mn_dump_image(struct MoonContext *ctx, const char *filename)
+{
+    err_reset();
+    return rt_image_dump(ctx->rt, (char*)filename);
+}
+
+struct MoonContext *mn_load_image(const char *filename)
+{
+    struct Runtime *rt;
+
+    err_reset();
+
+    if (!(rt = rt_image_load((char*)filename))) {
+        return NULL;
+    }
+
+    return mn_make_context(rt, 0);
+}
+
 void mn_destroy(struct MoonContext *ctx)
 {
+    view_scope_deinit(&ctx->views);
+    parse_cache_deinit(&ctx->parse_cache);
     rt_free(ctx->rt);
     mem_free(ctx);
 }
 
+void mn_seed(struct MoonContext *ctx, uint64_t seed)
+{
+    rt_seed(ctx->rt, seed, 0);
+}
+
+void mn_seed_stream(struct MoonContext *ctx, uint64_t seed, uint64_t stream)
+{
+    rt_seed(ctx->rt, seed, stream);
+}
+
+void mn_set_workers(struct MoonContext *ctx, int count)
+{
+    rt_set_pool_size(ctx->rt, count > 0 ? count : 0);
+}
+
+void mn_set_step_limit(struct MoonContext *ctx, int64_t steps)
+{
+    ctx->rt->budget.step_limit = steps > 0 ? steps : 0;
+}
+
+void mn_set_stack_limit(struct MoonContext *ctx, int64_t bytes)
+{
+    ctx->rt->budget.stack_limit = bytes > 0 ? bytes : 0;
+}
+
+void mn_set_time_limit(struct MoonContext *ctx, int64_t ms)
+{
+    ctx->rt->budget.time_limit_ms = ms > 0 ? ms : 0;
+}
+
+void mn_set_time_slice(struct MoonContext *ctx, int64_t steps)
+{
+    ctx->rt->budget.slice = steps > 0 ? steps : 0;
+}
+
+void mn_set_parse_cache(struct MoonContext *ctx, int capacity)
+{
+    parse_cache_resize(&ctx->parse_cache, capacity > 0 ? capacity : 0);
+}
+
+void mn_parse_cache_stats(struct MoonContext *ctx, int64_t *hits, int64_t *misses)
+{
+    *hits = ctx->parse_cache.hits;
+    *misses = ctx->parse_cache.misses;
+}
+
+void mn_interrupt(struct MoonContext *ctx)
+{
+    rt_interrupt(ctx->rt);
+}
+
 void mn_set_debugger(struct MoonContext *ctx, bool state)
 {
     ctx->rt->debug = state;
@@ -40,14 +151,41 @@ bool mn_register_clif(struct MoonContext *ctx, const char *symbol, int arity, Cl
     return !err_state();
 }
 
+bool mn_register_async_clif(struct MoonContext *ctx, const char *symbol, int arity, AsyncClifHandler handler)
+{
+    rt_register_async_clif_handler(ctx->rt, (char*)symbol, arity, handler);
+    return !err_state();
+}
+
+bool mn_register_direct_clif(struct MoonContext *ctx, const char *symbol, int arity, DirectClifHandler handler)
+{
+    rt_register_direct_clif_handler(ctx->rt, (char*)symbol, arity, handler);
+    return !err_state();
+}
+
+/** Checks that the context is not in the middle of a suspended task. */
+static bool mn_check_idle(struct MoonContext *ctx)
+{
+    if (ctx->rt->task) {
+        err_push("LIB", "Context is busy with a suspended task");
+        return false;
+    }
+    return true;
+}
+
 bool mn_exec_file(struct MoonContext *ctx, const char *filename)
 {
     char *source;
     struct AstNode *ast_list;
     struct AstLocMap alm;
+    bool result;
 
     err_reset();
 
+    if (!mn_check_idle(ctx)) {
+        return false;
+    }
+
     if (!(source = my_getfile((char*)filename))) {
         err_push("LIB", "Failed loading a file");
         return false;
@@ -58,7 +196,11 @@ bool mn_exec_file(struct MoonContext *ctx, const char *filename)
         return false;
     }
 
-    if (!rt_consume_list(ctx->rt, ast_list, &alm, NULL)) {
+    rt_budget_start(ctx->rt);
+    result = rt_consume_list(ctx->rt, ast_list, &alm, NULL);
+    rt_clear_interrupt(ctx->rt);
+
+    if (!result) {
         mem_free(source);
         return false;
     }
@@ -67,41 +209,413 @@ bool mn_exec_file(struct MoonContext *ctx, const char *filename)
     return true;
 }
 
-struct MoonValue *mn_exec_command(struct MoonContext *ctx, const char *source)
+/**
+ * Evaluates a single expression, whose result is left on the stack, past its
+ * top, until anything else is evaluated. The parsed expression is kept in
+ * the cache, if enabled, unless the runtime takes it over or it fails.
+ */
+static bool mn_exec_expression(struct MoonContext *ctx, const char *source, VAL_LOC_T *result_loc)
 {
+    struct ParseCache *cache = &ctx->parse_cache;
+    struct ParseCacheEntry *entry = NULL;
     struct AstNode *expr;
+    struct AstLocMap local_alm, *alm = &local_alm;
+    bool cacheable = false, retained = false;
+
+    err_reset();
+
+    if (!mn_check_idle(ctx)) {
+        return false;
+    }
+
+    if (cache->capacity && (entry = parse_cache_find(cache, source))) {
+        expr = entry->expr;
+        alm = &entry->alm;
+
+    } else {
+        alm_init(&local_alm);
+
+        expr = parse_source_build_alm((char*)source, &local_alm);
+        if (err_state()) {
+            err_push("LIB", "Failed executing command: %s", source);
+            alm_deinit(&local_alm);
+            return false;
+        }
+
+        cacheable = cache->capacity && expr && !expr->next;
+    }
+
+    rt_budget_start(ctx->rt);
+    if (entry || cacheable) {
+        rt_consume_shared(ctx->rt, expr, alm, result_loc, &retained);
+    } else {
+        rt_consume_one(ctx->rt, expr, alm, result_loc, NULL);
+    }
+    rt_clear_interrupt(ctx->rt);
+
+    /* A new entry is only inserted once the expression is known to be left
+     * to the cache, so that a retained one never evicts a live entry. */
+    if (entry) {
+        if (retained) {
+            parse_cache_release(cache, entry);
+        }
+    } else if (cacheable && !retained && !err_state()) {
+        parse_cache_insert(cache, source, expr, &local_alm);
+    } else {
+        if (cacheable && !retained) {
+            ast_node_free(expr);
+        }
+        alm_deinit(&local_alm);
+    }
+
+    if (err_state()) {
+        err_push("LIB", "Failed executing command: %s", source);
+        return false;
+    }
+
+    return true;
+}
+
+struct MoonValue *mn_exec_command(struct MoonContext *ctx, const char *source)
+{
     VAL_LOC_T result_loc;
+
+    if (mn_exec_expression(ctx, source, &result_loc) && result_loc) {
+        return mn_make_api_value(ctx->rt, result_loc);
+    } else {
+        return NULL;
+    }
+}
+
+bool mn_exec_view(struct MoonContext *ctx, const char *source, struct MoonView *view)
+{
+    VAL_LOC_T result_loc;
+
+    view_scope_deinit(&ctx->views);
+    view_scope_init(&ctx->views, ctx->rt);
+
+    if (!mn_exec_expression(ctx, source, &result_loc)) {
+        return false;
+    }
+
+    *view = view_make(&ctx->views, result_loc);
+    return true;
+}
+
+
+void mn_dispose(struct MoonValue* value)
+{
+    mn_api_value_free(value);
+}
+
+struct MoonFunction *mn_get_function(struct MoonContext *ctx, const char *symbol)
+{
+    struct MoonFunction *result;
+    struct SymMapNode *smn;
+    struct ValueFuncData func_data;
+
+    err_reset();
+
+    smn = sym_map_find(&ctx->rt->global_sym_map, (char*)symbol);
+    if (!smn || rt_val_peek_type(&ctx->rt->stack, smn->stack_loc) != VAL_FUNCTION) {
+        err_push("LIB", "Symbol %s is not bound to a function", symbol);
+        return NULL;
+    }
+
+    func_data = rt_val_function_data(ctx->rt, smn->stack_loc);
+
+    result = mem_malloc(sizeof(*result));
+    result->ctx = ctx;
+    alm_init(&result->alm);
+    result->arg_locs = mem_malloc((func_data.arity - func_data.appl_count + 1) * sizeof(*result->arg_locs));
+    result->symbol = mem_malloc(strlen(symbol) + 1);
+    memcpy(result->symbol, symbol, strlen(symbol) + 1);
+
+    eval_call_init(
+        &result->call,
+        ctx->rt,
+        &ctx->rt->global_sym_map,
+        &result->alm,
+        smn->stack_loc,
+        func_data.arity - func_data.appl_count);
+
+    return result;
+}
+
+/**
+ * Pushes the arguments and calls the function. The result is left on the
+ * stack, past its top, until anything else is evaluated.
+ */
+static bool mn_call_function(struct MoonFunction *func, struct MoonValue *args, VAL_LOC_T *result_loc)
+{
+    struct Runtime *rt = func->ctx->rt;
+    VAL_LOC_T begin = rt->stack.top;
+    int count = 0;
+
+    err_reset();
+
+    if (!mn_check_idle(func->ctx)) {
+        return false;
+    }
+
+    for (; args; args = args->next) {
+        if (count == func->call.arg_count) {
+            ++count;
+            break;
+        }
+        func->arg_locs[count++] = rt->stack.top;
+        eval_push_client_result(rt, args);
+        if (err_state()) {
+            break;
+        }
+    }
+
+    if (!err_state() && count != func->call.arg_count) {
+        err_push(
+            "LIB",
+            "Function of arity %d called with %s%d argument(s)",
+            func->call.arg_count,
+            count > func->call.arg_count ? "more than " : "",
+            count > func->call.arg_count ? func->call.arg_count : count);
+    }
+
+    if (!err_state()) {
+        rt_budget_start(rt);
+        *result_loc = eval_call(&func->call, func->arg_locs);
+        rt_clear_interrupt(rt);
+    }
+
+    rt->stack.top = begin;
+
+    if (err_state()) {
+        err_push("LIB", "Failed calling function %s", func->symbol);
+        return false;
+    }
+
+    return true;
+}
+
+struct MoonValue *mn_call(struct MoonFunction *func, struct MoonValue *args)
+{
+    VAL_LOC_T result_loc;
+
+    if (mn_call_function(func, args, &result_loc)) {
+        return mn_make_api_value(func->ctx->rt, result_loc);
+    } else {
+        return NULL;
+    }
+}
+
+bool mn_call_view(struct MoonFunction *func, struct MoonValue *args, struct MoonView *view)
+{
+    VAL_LOC_T result_loc;
+
+    view_scope_deinit(&func->ctx->views);
+    view_scope_init(&func->ctx->views, func->ctx->rt);
+
+    if (!mn_call_function(func, args, &result_loc)) {
+        return false;
+    }
+
+    *view = view_make(&func->ctx->views, result_loc);
+    return true;
+}
+
+void mn_function_free(struct MoonFunction *func)
+{
+    eval_call_deinit(&func->call);
+    alm_deinit(&func->alm);
+    mem_free(func->arg_locs);
+    mem_free(func->symbol);
+    mem_free(func);
+}
+
+struct MoonPrepared *mn_prepare(struct MoonContext *ctx, const char *source, const char **param_names)
+{
+    struct MoonPrepared *result;
+    struct AstNode *expr;
     struct AstLocMap alm;
+    int i, count = 0;
 
     err_reset();
+
     alm_init(&alm);
 
     expr = parse_source_build_alm((char*)source, &alm);
     if (err_state()) {
-        err_push("LIB", "Failed executing command: %s", source);
-    alm_deinit(&alm);
+        err_push("LIB", "Failed preparing command: %s", source);
+        alm_deinit(&alm);
         return NULL;
     }
 
-    rt_consume_one(ctx->rt, expr, &alm, &result_loc, NULL);
-    if (err_state()) {
-        err_push("LIB", "Failed executing command: %s", source);
-    alm_deinit(&alm);
+    if (!expr || expr->next) {
+        err_push("LIB", "Prepared command must be a single expression: %s", source);
+        ast_node_free(expr);
+        alm_deinit(&alm);
         return NULL;
     }
 
-    alm_deinit(&alm);
+    result = mem_malloc(sizeof(*result));
+    result->ctx = ctx;
+    result->expr = expr;
+    result->alm = alm;
+    sym_map_init_local(&result->params, &ctx->rt->global_sym_map);
 
-    if (result_loc) {
-        return mn_make_api_value(ctx->rt, result_loc);
+    for (; param_names && param_names[count]; ++count) {
+        if (sym_map_find_shallow(&result->params, (char*)param_names[count])) {
+            err_push("LIB", "Parameter %s declared more than once", param_names[count]);
+            result->param_nodes = NULL;
+            mn_prepared_free(result);
+            return NULL;
+        }
+        sym_map_insert(&result->params, (char*)param_names[count], 0);
+    }
+
+    /* The nodes only move while the symbols are being inserted. */
+    result->param_count = count;
+    result->param_nodes = mem_malloc((count + 1) * sizeof(*result->param_nodes));
+    for (i = 0; i < count; ++i) {
+        result->param_nodes[i] = sym_map_find_shallow(&result->params, (char*)param_names[i]);
+    }
+
+    return result;
+}
+
+/**
+ * Binds the parameters and evaluates the prepared expression. The result is
+ * left on the stack, past its top, until anything else is evaluated.
+ */
+static bool mn_execute_prepared(struct MoonPrepared *prep, struct MoonValue *params, VAL_LOC_T *result_loc)
+{
+    struct Runtime *rt = prep->ctx->rt;
+    struct SymMap scope;
+    VAL_LOC_T begin = rt->stack.top;
+    int count = 0;
+
+    err_reset();
+
+    if (!mn_check_idle(prep->ctx)) {
+        return false;
+    }
+
+    for (; params; params = params->next) {
+        if (count == prep->param_count) {
+            ++count;
+            break;
+        }
+        prep->param_nodes[count++]->stack_loc = rt->stack.top;
+        eval_push_client_result(rt, params);
+        if (err_state()) {
+            break;
+        }
+    }
+
+    if (!err_state() && count != prep->param_count) {
+        err_push(
+            "LIB",
+            "Command of %d parameter(s) executed with %s%d argument(s)",
+            prep->param_count,
+            count > prep->param_count ? "more than " : "",
+            count > prep->param_count ? prep->param_count : count);
+    }
+
+    /* The symbols bound by the expression itself are dropped with the inner
+     * scope, so that each execution starts from the parameters alone. */
+    if (!err_state()) {
+        sym_map_init_local(&scope, &prep->params);
+        rt_budget_start(rt);
+        *result_loc = eval(prep->expr, rt, &scope, &prep->alm);
+        rt_clear_interrupt(rt);
+        sym_map_deinit(&scope);
+    }
+
+    rt->stack.top = begin;
+
+    if (err_state()) {
+        err_push("LIB", "Failed executing prepared command");
+        return false;
+    }
+
+    return true;
+}
+
+struct MoonValue *mn_execute(struct MoonPrepared *prep, struct MoonValue *params)
+{
+    VAL_LOC_T result_loc;
+
+    if (mn_execute_prepared(prep, params, &result_loc)) {
+        return mn_make_api_value(prep->ctx->rt, result_loc);
     } else {
         return NULL;
     }
 }
 
-void mn_dispose(struct MoonValue* value)
+bool mn_execute_view(struct MoonPrepared *prep, struct MoonValue *params, struct MoonView *view)
 {
-    mn_api_value_free(value);
+    VAL_LOC_T result_loc;
+
+    view_scope_deinit(&prep->ctx->views);
+    view_scope_init(&prep->ctx->views, prep->ctx->rt);
+
+    if (!mn_execute_prepared(prep, params, &result_loc)) {
+        return false;
+    }
+
+    *view = view_make(&prep->ctx->views, result_loc);
+    return true;
+}
+
+void mn_prepared_free(struct MoonPrepared *prep)
+{
+    ast_node_free(prep->expr);
+    alm_deinit(&prep->alm);
+    sym_map_deinit(&prep->params);
+    mem_free(prep->param_nodes);
+    mem_free(prep);
+}
+
+struct MoonTask *mn_task_start(struct MoonContext *ctx, const char *source)
+{
+    struct AstNode *expr;
+    struct AstLocMap alm;
+
+    err_reset();
+
+    if (!mn_check_idle(ctx)) {
+        return NULL;
+    }
+
+    alm_init(&alm);
+
+    expr = parse_source_build_alm((char*)source, &alm);
+    if (err_state()) {
+        err_push("LIB", "Failed starting task: %s", source);
+        alm_deinit(&alm);
+        return NULL;
+    }
+
+    return task_start(ctx->rt, expr, &alm);
+}
+
+bool mn_resume(struct MoonTask *task, struct MoonValue *result)
+{
+    err_reset();
+    return task_resume(task, result);
+}
+
+enum MoonTaskState mn_task_state(struct MoonTask *task)
+{
+    return task_state(task);
+}
+
+struct MoonValue *mn_task_result(struct MoonTask *task)
+{
+    return task_take_result(task);
+}
+
+void mn_task_free(struct MoonTask *task)
+{
+    task_free(task);
 }
 
 bool mn_error_state(void)
@@ -114,3 +628,8 @@ const char *mn_error_message(void)
     return err_msg();
 }
 
+void mn_error_reset(void)
+{
+    err_reset();
+}
+
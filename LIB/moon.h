@@ -18,7 +18,11 @@ enum MoonValueType {
     MN_STRING,
     MN_ARRAY,
     MN_TUPLE,
+    MN_DICT,
     MN_FUNCTION,
+    MN_SEQUENCE,
+    MN_SAMPLER,
+    MN_CHANNEL,
     MN_REFERENCE,
     MN_UNIT
 };
@@ -39,19 +43,226 @@ struct MoonValue {
 
 typedef struct MoonValue* (*ClifHandler)(struct MoonValue *args);
 
+struct MoonTask;
+
+/**
+ * An asynchronous CLIF handler only starts the host operation, the script
+ * calling it is suspended until the host passes the result to mn_resume.
+ * The arguments are released once the handler returns.
+ */
+typedef void (*AsyncClifHandler)(struct MoonTask *task, struct MoonValue *args);
+
 struct MoonContext;
+struct MoonViewScope;
+
+/**
+ * A read-only view of a value on the stack of a context, which reads it in
+ * place instead of copying it to MoonValue nodes.
+ */
+struct MoonView {
+    struct MoonViewScope *scope;
+    int64_t loc;
+    bool entry;
+};
+
+/** Called for each element of a view, returns false to stop the visit. */
+typedef bool (*MoonViewVisitor)(struct MoonView element, void *data);
+
+/**
+ * A direct CLIF handler reads its arguments in place, as views, and pushes
+ * its result straight onto the stack with the mn_call_push functions.
+ */
+struct MoonCall;
+typedef void (*DirectClifHandler)(struct MoonCall *call);
+
+struct MoonFunction;
+struct MoonPrepared;
+
+enum MoonTaskState {
+    MN_TASK_SUSPENDED,
+    MN_TASK_PREEMPTED,
+    MN_TASK_FINISHED,
+    MN_TASK_FAILED
+};
+
+/*
+ * Thread safety
+ * =============
+ * A context may only be used by one thread at a time, but distinct contexts,
+ * clones included, may be used concurrently by distinct threads without any
+ * locking. The error state is kept per thread and describes the most recent
+ * failure of a call made by the calling thread; a thread about to exit
+ * should call mn_error_reset to release it.
+ *
+ * The CLIF handlers, direct ones included, are called on the thread
+ * executing the script, except for the calls made within _pmap_, which run
+ * on the worker threads of the context, possibly concurrently. A task must
+ * be resumed by the thread that started it. mn_interrupt is the only call
+ * which may be made by any thread at any time.
+ */
 
 struct MoonContext *mn_create(void);
+
+/**
+ * Creates an independent context with the same global definitions, much
+ * cheaper than loading them again. The clone shares only the definitions'
+ * syntax trees, which are never modified.
+ */
+struct MoonContext *mn_clone(struct MoonContext *ctx);
+
+/**
+ * Stores the state of the context in a file, which may only be loaded by the
+ * same build of the program. The context must not contain any CLIFs, they
+ * should be registered after the image is loaded.
+ */
+bool mn_dump_image(struct MoonContext *ctx, const char *filename);
+struct MoonContext *mn_load_image(const char *filename);
 void mn_destroy(struct MoonContext *ctx);
 
+/**
+ * Makes the random numbers of the context, seeded nondeterministically on
+ * creation, reproducible. Parallel contexts should be given the same seed
+ * and distinct streams, which yield independent sequences.
+ */
+void mn_seed(struct MoonContext *ctx, uint64_t seed);
+void mn_seed_stream(struct MoonContext *ctx, uint64_t seed, uint64_t stream);
+
+/**
+ * Sets the number of the workers of _pmap_ and _par_, started upon the
+ * first call, by default one per processor beside the calling thread. Zero
+ * makes them run on the calling thread alone.
+ */
+void mn_set_workers(struct MoonContext *ctx, int count);
+
+/**
+ * Limit each mn_exec_file, mn_exec_command and mn_task_start evaluation,
+ * which fails once a limit is exceeded: the number of the evaluated
+ * expressions, the bytes on the stack of the context, global definitions
+ * included, noticed at the next step, and the wall-clock time, noticed
+ * within a thousand steps. Zero removes a limit. The workers of _pmap_ and
+ * _par_ are each given what is left of the budget.
+ */
+void mn_set_step_limit(struct MoonContext *ctx, int64_t steps);
+void mn_set_stack_limit(struct MoonContext *ctx, int64_t bytes);
+void mn_set_time_limit(struct MoonContext *ctx, int64_t ms);
+
+/**
+ * Makes a task yield to the host in the MN_TASK_PREEMPTED state each time it
+ * has taken the given number of steps. It continues with mn_resume, passing
+ * no result.
+ */
+void mn_set_time_slice(struct MoonContext *ctx, int64_t steps);
+
+/**
+ * Keeps up to the given number of the commands executed by mn_exec_command
+ * and mn_exec_view parsed, dropping the least recently used first. The
+ * commands binding symbols, spawning fibers or failing are not kept. Disabled by
+ * default and by a size of zero; a clone starts empty, with the same size.
+ */
+void mn_set_parse_cache(struct MoonContext *ctx, int capacity);
+void mn_parse_cache_stats(struct MoonContext *ctx, int64_t *hits, int64_t *misses);
+
+/**
+ * Makes the evaluation in progress fail at its next function call or loop
+ * iteration, its workers included. An idle context fails its next
+ * evaluation instead, a suspended task fails once resumed.
+ */
+void mn_interrupt(struct MoonContext *ctx);
 void mn_set_debugger(struct MoonContext *ctx, bool state);
 bool mn_register_clif(struct MoonContext *ctx, const char *symbol, int arity, ClifHandler handler);
+
+/** Registers a CLIF which fails when called outside of a task. */
+bool mn_register_async_clif(struct MoonContext *ctx, const char *symbol, int arity, AsyncClifHandler handler);
+bool mn_register_direct_clif(struct MoonContext *ctx, const char *symbol, int arity, DirectClifHandler handler);
 bool mn_exec_file(struct MoonContext *ctx, const char *filename);
 struct MoonValue *mn_exec_command(struct MoonContext *ctx, const char *source);
+
+/**
+ * Evaluates a command like mn_exec_command, but only returns a view of the
+ * result, valid until the context evaluates anything else.
+ */
+bool mn_exec_view(struct MoonContext *ctx, const char *source, struct MoonView *view);
 void mn_dispose(struct MoonValue* value);
 
+/**
+ * Returns a handle of the function bound to a global symbol, which is called
+ * with the arguments pushed straight onto the stack, without any parsing.
+ * It must be freed before the context is destroyed.
+ */
+struct MoonFunction *mn_get_function(struct MoonContext *ctx, const char *symbol);
+struct MoonValue *mn_call(struct MoonFunction *func, struct MoonValue *args);
+bool mn_call_view(struct MoonFunction *func, struct MoonValue *args, struct MoonView *view);
+void mn_function_free(struct MoonFunction *func);
+
+/**
+ * Parses a command once, declaring its parameters, given as a NULL terminated
+ * array of names. Each execution binds them to the arguments, in order, and
+ * evaluates the command again. The command must be a single expression,
+ * possibly a _do_ block, the symbols it binds only last for one execution.
+ * The handle must be freed before the context is destroyed and after any
+ * fiber spawned by the command is done.
+ */
+struct MoonPrepared *mn_prepare(struct MoonContext *ctx, const char *source, const char **param_names);
+struct MoonValue *mn_execute(struct MoonPrepared *prep, struct MoonValue *params);
+bool mn_execute_view(struct MoonPrepared *prep, struct MoonValue *params, struct MoonView *view);
+void mn_prepared_free(struct MoonPrepared *prep);
+
+/**
+ * The views of arrays, tuples and dictionaries have elements, those of the
+ * dictionaries being the tuples of their keys and values. The accessors
+ * expect an index within mn_view_len and a view of the matching type.
+ */
+enum MoonValueType mn_view_type(struct MoonView view);
+int mn_view_len(struct MoonView view);
+
+/**
+ * Immediate for the arrays of scalars, otherwise skips the preceding
+ * elements, so mn_view_visit should be preferred for a whole compound.
+ */
+struct MoonView mn_view_at(struct MoonView view, int index);
+bool mn_view_visit(struct MoonView view, MoonViewVisitor visitor, void *data);
+bool mn_view_bool(struct MoonView view);
+char mn_view_char(struct MoonView view);
+int64_t mn_view_int(struct MoonView view);
+double mn_view_real(struct MoonView view);
+
+/** Copies the characters to a buffer living as long as the view. */
+const char *mn_view_string_ptr(struct MoonView view);
+
+/** Returns a view of an argument, valid until the handler returns. */
+struct MoonView mn_call_arg(struct MoonCall *call, int index);
+
+/**
+ * Push the single result of a direct CLIF, pushing nothing returns a unit. A
+ * compound is started with mn_call_push_array or mn_call_push_tuple, followed
+ * by its elements and closed by mn_call_push_end.
+ */
+void mn_call_push_bool(struct MoonCall *call, bool value);
+void mn_call_push_char(struct MoonCall *call, char value);
+void mn_call_push_int(struct MoonCall *call, int64_t value);
+void mn_call_push_real(struct MoonCall *call, double value);
+void mn_call_push_string(struct MoonCall *call, const char *value);
+void mn_call_push_unit(struct MoonCall *call);
+void mn_call_push_array(struct MoonCall *call);
+void mn_call_push_tuple(struct MoonCall *call);
+void mn_call_push_end(struct MoonCall *call);
+void mn_call_push_copy(struct MoonCall *call, struct MoonView view);
+void mn_call_fail(struct MoonCall *call, const char *message);
+
+/**
+ * Runs a command until it finishes or calls an asynchronous CLIF, which
+ * suspends it until mn_resume passes the result. The context cannot execute
+ * anything else meanwhile. Freeing a suspended task cancels it.
+ */
+struct MoonTask *mn_task_start(struct MoonContext *ctx, const char *source);
+bool mn_resume(struct MoonTask *task, struct MoonValue *result);
+enum MoonTaskState mn_task_state(struct MoonTask *task);
+struct MoonValue *mn_task_result(struct MoonTask *task);
+void mn_task_free(struct MoonTask *task);
+
 bool mn_error_state(void);
 const char *mn_error_message(void);
+void mn_error_reset(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,159 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#include "api_value.h"
+#include "coro.h"
+#include "error.h"
+#include "memory.h"
+#include "task.h"
+
+struct MoonTask {
+    struct Runtime *rt;
+    struct Coro *coro;
+    struct AstNode *expr;
+    struct AstLocMap alm;
+    enum MoonTaskState state;
+    struct MoonValue *resumed;
+    struct MoonValue *result;
+    bool cancelled;
+};
+
+static void task_main(struct Coro *coro, void *data)
+{
+    struct MoonTask *task = data;
+    VAL_LOC_T result_loc;
+
+    (void)coro;
+
+    if (rt_consume_one(task->rt, task->expr, &task->alm, &result_loc, NULL)) {
+        if (result_loc) {
+            task->result = mn_make_api_value(task->rt, result_loc);
+        }
+        task->state = MN_TASK_FINISHED;
+    } else {
+        task->state = MN_TASK_FAILED;
+    }
+}
+
+/** Runs the coroutine until it gets suspended or finishes. */
+static bool task_run(struct MoonTask *task)
+{
+    if (coro_resume(task->coro)) {
+        return true;
+    }
+
+    task->rt->task = NULL;
+    rt_clear_interrupt(task->rt);
+    alm_deinit(&task->alm);
+
+    if (task->state == MN_TASK_FAILED) {
+        err_push("LIB", "Task failed");
+        return false;
+    }
+
+    return true;
+}
+
+struct MoonTask *task_start(struct Runtime *rt, struct AstNode *expr, struct AstLocMap *alm)
+{
+    struct MoonTask *task = mem_malloc(sizeof(*task));
+
+    task->rt = rt;
+    task->coro = coro_make(task_main, task, CORO_STACK_SIZE);
+    task->expr = expr;
+    task->alm = *alm;
+    task->state = MN_TASK_SUSPENDED;
+    task->resumed = NULL;
+    task->result = NULL;
+    task->cancelled = false;
+
+    rt->task = task;
+    rt_budget_start(rt);
+    task_run(task);
+
+    return task;
+}
+
+bool task_resume(struct MoonTask *task, struct MoonValue *result)
+{
+    if ((task->state != MN_TASK_SUSPENDED && task->state != MN_TASK_PREEMPTED) ||
+        coro_running(task->coro)) {
+        err_push("LIB", "Only a suspended or preempted task may be resumed");
+        mn_api_value_free(result);
+        return false;
+    }
+
+    if (task->state == MN_TASK_PREEMPTED) {
+        mn_api_value_free(result);
+        result = NULL;
+    }
+
+    task->resumed = result;
+    return task_run(task);
+}
+
+bool task_await(struct MoonTask *task, struct MoonValue **result)
+{
+    coro_yield(task->coro);
+
+    if (task->cancelled) {
+        err_push("LIB", "Task cancelled");
+        return false;
+    }
+
+    /* The interrupt may have arrived while the task was suspended. */
+    if (!rt_check_interrupt(task->rt)) {
+        mn_api_value_free(task->resumed);
+        task->resumed = NULL;
+        return false;
+    }
+
+    *result = task->resumed;
+    task->resumed = NULL;
+    return true;
+}
+
+bool task_preempt(struct MoonTask *task)
+{
+    task->state = MN_TASK_PREEMPTED;
+    coro_yield(task->coro);
+    task->state = MN_TASK_SUSPENDED;
+
+    if (task->cancelled) {
+        err_push("LIB", "Task cancelled");
+        return false;
+    }
+
+    return true;
+}
+
+enum MoonTaskState task_state(struct MoonTask *task)
+{
+    return task->state;
+}
+
+struct MoonValue *task_take_result(struct MoonTask *task)
+{
+    struct MoonValue *result = task->result;
+    task->result = NULL;
+    return result;
+}
+
+void task_free(struct MoonTask *task)
+{
+    struct ErrFrame *errors;
+
+    /* A suspended or preempted task is unwound like upon an error, which
+     * releases the resources held by the evaluation, without touching the
+     * caller's error state. */
+    if (task->state == MN_TASK_SUSPENDED || task->state == MN_TASK_PREEMPTED) {
+        errors = err_detach();
+        task->cancelled = true;
+        task_run(task);
+        err_reset();
+        err_attach(errors);
+    }
+
+    mn_api_value_free(task->result);
+    coro_free(task->coro);
+    mem_free(task);
+}
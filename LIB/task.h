@@ -0,0 +1,38 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#ifndef TASK_H
+#define TASK_H
+
+#include "moon.h"
+#include "runtime.h"
+
+/**
+ * Starts evaluating the expression on a coroutine, taking the ownership of
+ * the expression and of the location map. Returns once the evaluation has
+ * finished or got suspended.
+ */
+struct MoonTask *task_start(struct Runtime *rt, struct AstNode *expr, struct AstLocMap *alm);
+
+/**
+ * Resumes the suspended or preempted task, taking the ownership of the
+ * result, which only a suspended task receives.
+ */
+bool task_resume(struct MoonTask *task, struct MoonValue *result);
+
+/**
+ * Suspends the task from within, until the host resumes it. Returns false if
+ * the task is cancelled instead, which should be handled as an error.
+ */
+bool task_await(struct MoonTask *task, struct MoonValue **result);
+
+/**
+ * Preempts the task from within once its time slice is over, until the host
+ * resumes it. Returns false if the task is cancelled instead.
+ */
+bool task_preempt(struct MoonTask *task);
+
+enum MoonTaskState task_state(struct MoonTask *task);
+struct MoonValue *task_take_result(struct MoonTask *task);
+void task_free(struct MoonTask *task);
+
+#endif
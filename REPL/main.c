@@ -102,7 +102,7 @@ static char *repl_read(void)
     char *line;
 
     printf("%s", prompt);
-    line = my_getline(&eof_flag);
+    line = my_getline(stdin, &eof_flag);
 
     if (eof_flag) {
         mem_free(line);
@@ -159,9 +159,23 @@ static void repl_print(struct MoonValue *value)
             repl_print(value->data.compound);
             printf("}");
             break;
+        case MN_DICT:
+            printf("(dict [");
+            repl_print(value->data.compound);
+            printf("])");
+            break;
         case MN_FUNCTION:
             printf("function");
             break;
+        case MN_SEQUENCE:
+            printf("sequence");
+            break;
+        case MN_SAMPLER:
+            printf("sampler");
+            break;
+        case MN_CHANNEL:
+            printf("channel");
+            break;
         case MN_REFERENCE:
             printf("reference");
             break;
@@ -176,21 +190,72 @@ static void repl_print(struct MoonValue *value)
     }
 }
 
-int main()
+/**
+ * Sets up the context either from an image or by reading the standard
+ * library. The "--dump-image <file>" option only writes the image of the
+ * freshly read standard library, "--image <file>" starts from an image.
+ */
+static bool repl_init_context(int argc, char *argv[], bool *dump_only)
 {
-    printf("%s", banner);
+    char *error_message;
+
+    *dump_only = false;
+
+    if (argc == 3 && strcmp(argv[1], "--image") == 0) {
+        if ((ctx = mn_load_image(argv[2]))) {
+            return true;
+        }
+        error_message = (char*)mn_error_message();
+        printf("Error while loading image\n");
+        printf("%s", error_message);
+        mem_free(error_message);
+        mn_error_reset();
+        return false;
+    }
 
     ctx = mn_create();
 
     if (!mn_exec_file(ctx, stdfilename)) {
-        char *error_message = (char*)mn_error_message();
+        error_message = (char*)mn_error_message();
         printf("Error while reading standard library\n");
         printf("%s", error_message);
         mem_free(error_message);
+        mn_error_reset();
         mn_destroy(ctx);
+        return false;
+    }
+
+    if (argc == 3 && strcmp(argv[1], "--dump-image") == 0) {
+        *dump_only = true;
+        if (!mn_dump_image(ctx, argv[2])) {
+            error_message = (char*)mn_error_message();
+            printf("Error while writing image\n");
+            printf("%s", error_message);
+            mem_free(error_message);
+            mn_error_reset();
+            mn_destroy(ctx);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    bool dump_only;
+
+    printf("%s", banner);
+
+    if (!repl_init_context(argc, argv, &dump_only)) {
         return 1;
     }
 
+    if (dump_only) {
+        mn_destroy(ctx);
+        return 0;
+    }
+
     if (!mn_register_clif(ctx, "debug", 0, repl_clif_dbg) ||
         !mn_register_clif(ctx, "quit", 0, repl_clif_quit) ||
         !mn_register_clif(ctx, "load", 1, repl_clif_load)) {
@@ -198,6 +263,7 @@ int main()
             printf("Error while setting up REPL environment\n");
             printf("%s", error_message);
             mem_free(error_message);
+            mn_error_reset();
             mn_destroy(ctx);
             return 1;
     }
@@ -232,6 +298,7 @@ int main()
     }
 
     ts_deinit();
+    mn_error_reset();
     mn_destroy(ctx);
     return 0;
 }
@@ -0,0 +1,851 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "moon.h"
+
+/*
+ * The tests of the embedding API, calling the library the way a host does.
+ * Each test starts from a fresh context with the standard library loaded.
+ */
+
+static const char *std_path;
+static const char *current_test_name;
+static int tests_performed, tests_failed;
+
+#define check(CONDITION, FORMAT, ...) \
+    do { \
+        ++tests_performed; \
+        if (!(CONDITION)) { \
+            printf("[FAIL][%s] " FORMAT "\n", current_test_name, ##__VA_ARGS__); \
+            ++tests_failed; \
+        } \
+    } while(0)
+
+static struct MoonContext *begin_test(const char *name)
+{
+    struct MoonContext *ctx = mn_create();
+    current_test_name = name;
+    if (!mn_exec_file(ctx, std_path)) {
+        fprintf(stderr, "Failed loading the standard library: %s\n", std_path);
+        exit(EXIT_FAILURE);
+    }
+    return ctx;
+}
+
+/** Executes a command expected to succeed with a unit or any other value. */
+static void exec(struct MoonContext *ctx, const char *source)
+{
+    struct MoonValue *value = mn_exec_command(ctx, source);
+    check(value, "Failed executing %s", source);
+    mn_dispose(value);
+}
+
+/** Executes a command expected to yield an integer, returns -1 otherwise. */
+static int64_t exec_int(struct MoonContext *ctx, const char *source)
+{
+    int64_t result = -1;
+    struct MoonValue *value = mn_exec_command(ctx, source);
+    if (value && value->type == MN_INT) {
+        result = value->data.integer;
+    }
+    mn_dispose(value);
+    mn_error_reset();
+    return result;
+}
+
+static bool exec_fails(struct MoonContext *ctx, const char *source)
+{
+    struct MoonValue *value = mn_exec_command(ctx, source);
+    bool result = !value && mn_error_state();
+    mn_dispose(value);
+    mn_error_reset();
+    return result;
+}
+
+static struct MoonValue *make_int(int64_t value)
+{
+    struct MoonValue *result = malloc(sizeof(*result));
+    result->type = MN_INT;
+    result->data.integer = value;
+    result->next = NULL;
+    return result;
+}
+
+/** Builds a list of integer arguments. */
+static struct MoonValue *make_ints(int count, int64_t first, int64_t step)
+{
+    struct MoonValue *result = NULL, **tail = &result;
+    while (count--) {
+        *tail = make_int(first);
+        tail = &(*tail)->next;
+        first += step;
+    }
+    return result;
+}
+
+/** Calls a function handle expected to yield an integer, returns -1 otherwise. */
+static int64_t call_int(struct MoonFunction *func, struct MoonValue *args)
+{
+    int64_t result = -1;
+    struct MoonValue *value = mn_call(func, args);
+    if (value && value->type == MN_INT) {
+        result = value->data.integer;
+    }
+    mn_dispose(value);
+    mn_dispose(args);
+    mn_error_reset();
+    return result;
+}
+
+static bool call_fails(struct MoonFunction *func, struct MoonValue *args)
+{
+    struct MoonValue *value = mn_call(func, args);
+    bool result = !value && mn_error_state();
+    mn_dispose(value);
+    mn_dispose(args);
+    mn_error_reset();
+    return result;
+}
+
+/** Copies a file, overwriting a byte at the offset or truncating it there. */
+static void copy_file(const char *src, const char *dst, long offset, bool truncate)
+{
+    FILE *in = fopen(src, "rb"), *out = fopen(dst, "wb");
+    long position = 0;
+    int c;
+
+    while ((c = fgetc(in)) != EOF) {
+        if (position == offset && truncate) {
+            break;
+        }
+        fputc(position == offset ? c ^ 0xff : c, out);
+        ++position;
+    }
+
+    fclose(in);
+    fclose(out);
+}
+
+/* Contexts.
+ * =========
+ */
+
+static void test_clone(void)
+{
+    struct MoonContext *ctx = begin_test("Clone isolation");
+    struct MoonContext *clone;
+
+    exec(ctx, "(bind k 3)");
+    exec(ctx, "(bind k^ (ptr k))");
+    exec(ctx, "(bind triple (func (x) (* x k)))");
+    clone = mn_clone(ctx);
+
+    exec(clone, "(poke k^ 5)");
+    exec(clone, "(bind only_clone 1)");
+    check(exec_int(clone, "k") == 5, "Assignment failed in the clone");
+    check(exec_int(ctx, "k") == 3, "Assignment in the clone visible in the original");
+    check(exec_fails(ctx, "only_clone"), "Binding in the clone visible in the original");
+
+    exec(ctx, "(bind only_original 1)");
+    check(exec_fails(clone, "only_original"), "Binding in the original visible in the clone");
+
+    /* The globals are looked up in the context of the call, and the
+     * definitions outlive the original. */
+    check(exec_int(ctx, "(triple 2)") == 6, "Function of the original failed");
+    mn_destroy(ctx);
+    check(exec_int(clone, "(triple 2)") == 10, "Function of the original failed in the clone");
+    check(exec_int(clone, "(length \"abc\")") == 3, "Standard library not available in the clone");
+
+    mn_destroy(clone);
+}
+
+static bool image_rejected(const char *filename)
+{
+    struct MoonContext *ctx = mn_load_image(filename);
+    bool result = !ctx && mn_error_state();
+    if (ctx) {
+        mn_destroy(ctx);
+    }
+    mn_error_reset();
+    return result;
+}
+
+static void test_image(void)
+{
+    struct MoonContext *ctx = begin_test("Image round-trip");
+    struct MoonContext *loaded;
+    const char *image = "api_test.img", *tampered = "api_test_tampered.img";
+
+    exec(ctx, "(bind k 3)");
+    exec(ctx, "(bind triple (func (x) (* x k)))");
+    check(mn_dump_image(ctx, image), "Failed dumping an image");
+    mn_destroy(ctx);
+
+    loaded = mn_load_image(image);
+    check(loaded, "Failed loading an image");
+    if (loaded) {
+        check(exec_int(loaded, "(triple 2)") == 6, "Function not restored from the image");
+        check(exec_int(loaded, "(foldl + 0 [ 1 2 3 ])") == 6, "Standard library not restored from the image");
+        exec(loaded, "(bind l 4)");
+        check(exec_int(loaded, "(+ k l)") == 7, "Loaded context not extensible");
+        mn_destroy(loaded);
+    }
+
+    current_test_name = "Image rejection";
+
+    copy_file(image, tampered, 0, false);
+    check(image_rejected(tampered), "Image of a broken magic string loaded");
+
+    copy_file(image, tampered, 8, false);
+    check(image_rejected(tampered), "Image of a foreign build loaded");
+
+    copy_file(image, tampered, 100, true);
+    check(image_rejected(tampered), "Truncated image loaded");
+
+    check(image_rejected(std_path), "Source file loaded as an image");
+    check(image_rejected("no_such_file.img"), "Missing image loaded");
+
+    ctx = begin_test("Image rejection");
+    mn_register_clif(ctx, "host_func", 0, NULL);
+    check(!mn_dump_image(ctx, tampered), "Image of a CLIF dumped");
+    mn_error_reset();
+    mn_destroy(ctx);
+
+    remove(image);
+    remove(tampered);
+}
+
+/* Tasks.
+ * ======
+ */
+
+static struct MoonTask *fetch_task;
+static int64_t fetch_arg;
+static bool fetch_reentrant_resumed;
+
+static void fetch(struct MoonTask *task, struct MoonValue *args)
+{
+    fetch_task = task;
+    fetch_arg = args->data.integer;
+    fetch_reentrant_resumed = mn_resume(task, NULL);
+    mn_error_reset();
+}
+
+static void test_task(void)
+{
+    struct MoonContext *ctx = begin_test("Task suspension");
+    struct MoonTask *task;
+    struct MoonValue *result;
+
+    mn_register_async_clif(ctx, "fetch", 1, fetch);
+
+    task = mn_task_start(ctx, "(+ 1 (fetch 41))");
+    check(mn_task_state(task) == MN_TASK_SUSPENDED, "Task not suspended by an asynchronous CLIF");
+    check(fetch_task == task && fetch_arg == 41, "Asynchronous CLIF called with wrong arguments");
+    check(!fetch_reentrant_resumed, "Task resumed from within its own CLIF");
+    check(exec_fails(ctx, "(+ 1 2)"), "Command executed meanwhile a task is suspended");
+
+    check(mn_resume(task, make_int(42)), "Failed resuming a task");
+    check(mn_task_state(task) == MN_TASK_FINISHED, "Task not finished after resumption");
+    result = mn_task_result(task);
+    check(result && result->type == MN_INT && result->data.integer == 43, "Wrong task result");
+    mn_dispose(result);
+
+    check(!mn_resume(task, make_int(42)) && mn_error_state(), "Finished task resumed");
+    mn_error_reset();
+    mn_task_free(task);
+
+    current_test_name = "Task cancellation";
+    task = mn_task_start(ctx, "(+ 1 (fetch 1))");
+    check(mn_task_state(task) == MN_TASK_SUSPENDED, "Task not suspended by an asynchronous CLIF");
+    mn_task_free(task);
+    check(!mn_error_state(), "Cancellation altered the error state");
+    check(exec_int(ctx, "(+ 1 2)") == 3, "Context not idle after cancelling a task");
+
+    current_test_name = "Asynchronous CLIF outside of a task";
+    check(exec_fails(ctx, "(fetch 1)"), "Asynchronous CLIF called outside of a task");
+
+    /* The coroutine stack must be as deep as the one of the main thread. */
+    current_test_name = "Deep recursion in a task";
+    exec(ctx, "(bind deep (func (n) (if (eq n 0) 0 (+ 1 (deep (- n 1))))))");
+    task = mn_task_start(ctx, "(+ (deep 2000) (fetch 1))");
+    check(mn_task_state(task) == MN_TASK_SUSPENDED, "Deeply recursing task not suspended");
+    check(mn_resume(task, make_int(1)), "Failed resuming a deeply recursing task");
+    result = mn_task_result(task);
+    check(result && result->type == MN_INT && result->data.integer == 2001, "Wrong deep recursion result");
+    mn_dispose(result);
+    mn_task_free(task);
+
+    mn_destroy(ctx);
+}
+
+/* Budgets.
+ * ========
+ */
+
+static void test_budget(void)
+{
+    struct MoonContext *ctx = begin_test("Step limit");
+    struct MoonTask *task;
+    struct MoonValue *result;
+    int slices;
+
+    exec(ctx, "(bind deep (func (n) (if (eq n 0) 0 (+ 1 (deep (- n 1))))))");
+    exec(ctx, "(bind i 0)");
+    exec(ctx, "(bind i^ (ptr i))");
+
+    mn_set_step_limit(ctx, 1000);
+    check(exec_int(ctx, "(deep 10)") == 10, "Evaluation within the step limit failed");
+    check(exec_fails(ctx, "(deep 1000)"), "Step limit not enforced");
+    check(exec_int(ctx, "(deep 10)") == 10, "Step limit not reset for the next evaluation");
+    mn_set_step_limit(ctx, 0);
+    check(exec_int(ctx, "(deep 1000)") == 1000, "Step limit not removed");
+
+    /* A single (deep 100) takes some 1400 steps. */
+    current_test_name = "Step limit of concurrent evaluations";
+    mn_set_step_limit(ctx, 3000);
+    check(exec_int(ctx, "(length (par (deep 100) (deep 100)))") == 2, "Evaluation within the step limit failed");
+    check(exec_fails(ctx, "(par (deep 100) (deep 100) (deep 100))"), "Step limit not shared by _par_");
+    check(exec_fails(ctx, "(par (par (deep 100) (deep 100)) (deep 100))"), "Step limit not shared by nested _par_");
+    check(exec_fails(ctx, "(pmap deep [ 100 100 100 ])"), "Step limit not shared by _pmap_");
+    mn_set_workers(ctx, 0);
+    check(exec_fails(ctx, "(par (deep 100) (deep 100) (deep 100))"), "Step limit not shared without workers");
+    mn_set_step_limit(ctx, 0);
+
+    current_test_name = "Stack limit";
+    mn_set_stack_limit(ctx, 40000);
+    check(exec_int(ctx, "(deep 10)") == 10, "Evaluation within the stack limit failed");
+    check(exec_fails(ctx, "(deep 1000)"), "Stack limit not enforced");
+    mn_set_stack_limit(ctx, 0);
+    check(exec_int(ctx, "(deep 1000)") == 1000, "Stack limit not removed");
+
+    current_test_name = "Time limit";
+    mn_set_time_limit(ctx, 50);
+    check(exec_fails(ctx, "(while true (poke i^ (+ (peek i^) 1)))"), "Time limit not enforced");
+    check(exec_int(ctx, "(deep 10)") == 10, "Time limit not reset for the next evaluation");
+    mn_set_time_limit(ctx, 0);
+
+    /* The steps of the slices add up to the whole evaluation. */
+    current_test_name = "Time slices";
+    mn_set_time_slice(ctx, 100);
+    task = mn_task_start(ctx, "(deep 1000)");
+    for (slices = 1; mn_task_state(task) == MN_TASK_PREEMPTED && mn_resume(task, NULL); ++slices);
+    check(slices > 10, "Task preempted only %d times", slices - 1);
+    check(mn_task_state(task) == MN_TASK_FINISHED, "Preempted task not finished");
+    result = mn_task_result(task);
+    check(result && result->type == MN_INT && result->data.integer == 1000, "Wrong preempted task result");
+    mn_dispose(result);
+    mn_task_free(task);
+
+    task = mn_task_start(ctx, "(deep 1000)");
+    check(mn_task_state(task) == MN_TASK_PREEMPTED, "Task not preempted");
+    mn_task_free(task);
+    check(exec_int(ctx, "(deep 1000)") == 1000, "Commands preempted outside of a task");
+
+    mn_set_step_limit(ctx, 500);
+    task = mn_task_start(ctx, "(deep 1000)");
+    while (mn_task_state(task) == MN_TASK_PREEMPTED && mn_resume(task, NULL));
+    check(mn_task_state(task) == MN_TASK_FAILED, "Step limit not enforced across the slices");
+    mn_error_reset();
+    mn_task_free(task);
+
+    mn_destroy(ctx);
+}
+
+static void *interrupt_later(void *data)
+{
+    struct timespec delay = { 0, 50 * 1000 * 1000 };
+    nanosleep(&delay, NULL);
+    mn_interrupt(data);
+    return NULL;
+}
+
+static void test_interrupt(void)
+{
+    struct MoonContext *ctx = begin_test("Interrupt from another thread");
+    struct MoonTask *task;
+    pthread_t thread;
+
+    exec(ctx, "(bind i 0)");
+    exec(ctx, "(bind i^ (ptr i))");
+
+    pthread_create(&thread, NULL, interrupt_later, ctx);
+    check(exec_fails(ctx, "(while true (poke i^ (+ (peek i^) 1)))"), "Loop not interrupted");
+    pthread_join(thread, NULL);
+    check(exec_int(ctx, "(+ 1 2)") == 3, "Interrupt not cleared after the evaluation");
+
+    current_test_name = "Interrupt of an idle context";
+    mn_interrupt(ctx);
+    check(exec_fails(ctx, "(length (map (func (x) x) [ 1 2 3 ]))"), "Pending interrupt ignored");
+    check(exec_int(ctx, "(+ 1 2)") == 3, "Pending interrupt not cleared");
+
+    current_test_name = "Interrupt of a suspended task";
+    mn_register_async_clif(ctx, "fetch", 1, fetch);
+    task = mn_task_start(ctx, "(+ 1 (fetch 1))");
+    mn_interrupt(ctx);
+    check(!mn_resume(task, make_int(1)), "Interrupted task resumed");
+    check(mn_task_state(task) == MN_TASK_FAILED, "Interrupted task not failed");
+    mn_error_reset();
+    mn_task_free(task);
+    check(exec_int(ctx, "(+ 1 2)") == 3, "Interrupt not cleared after the task");
+
+    mn_destroy(ctx);
+}
+
+/* Views.
+ * ======
+ */
+
+/** Sums the integers, or the products of the dictionary entries. */
+static bool sum_visitor(struct MoonView element, void *data)
+{
+    int64_t *sum = data;
+    if (mn_view_type(element) == MN_TUPLE) {
+        *sum += mn_view_int(mn_view_at(element, 0)) * mn_view_int(mn_view_at(element, 1));
+    } else {
+        *sum += mn_view_int(element);
+    }
+    return true;
+}
+
+static bool stop_visitor(struct MoonView element, void *data)
+{
+    int *count = data;
+    (void)element;
+    return ++*count < 2;
+}
+
+static void test_view(void)
+{
+    struct MoonContext *ctx = begin_test("Views of arrays");
+    struct MoonView view, element;
+    int64_t sum = 0;
+    int count = 0;
+
+    check(mn_exec_view(ctx, "[ 1 2 3 ]", &view), "Failed viewing an array");
+    check(mn_view_type(view) == MN_ARRAY && mn_view_len(view) == 3, "Wrong array view");
+    check(mn_view_int(mn_view_at(view, 2)) == 3, "Wrong array element");
+    check(mn_view_visit(view, sum_visitor, &sum) && sum == 6, "Wrong array visit");
+    check(!mn_view_visit(view, stop_visitor, &count) && count == 2, "Array visit not stopped");
+
+    check(mn_exec_view(ctx, "[ \"abc\" \"cde\" ]", &view), "Failed viewing an array of strings");
+    check(mn_view_len(view) == 2, "Wrong array of strings length");
+    element = mn_view_at(view, 1);
+    check(mn_view_type(element) == MN_STRING && !strcmp(mn_view_string_ptr(element), "cde"),
+          "Wrong array of strings element");
+
+    check(mn_exec_view(ctx, "[]", &view), "Failed viewing an empty array");
+    check(mn_view_len(view) == 0 && mn_view_visit(view, stop_visitor, &count), "Wrong empty array view");
+
+    current_test_name = "Views of tuples";
+    check(mn_exec_view(ctx, "{ 1 'a' 2.5 [ 4 5 ] }", &view), "Failed viewing a tuple");
+    check(mn_view_type(view) == MN_TUPLE && mn_view_len(view) == 4, "Wrong tuple view");
+    check(mn_view_int(mn_view_at(view, 0)) == 1, "Wrong tuple integer");
+    check(mn_view_char(mn_view_at(view, 1)) == 'a', "Wrong tuple character");
+    check(mn_view_real(mn_view_at(view, 2)) == 2.5, "Wrong tuple real");
+    element = mn_view_at(view, 3);
+    check(mn_view_type(element) == MN_ARRAY && mn_view_int(mn_view_at(element, 1)) == 5,
+          "Wrong nested array");
+
+    current_test_name = "Views of dictionaries";
+    check(mn_exec_view(ctx, "(dict [ { 1 10 } { 2 20 } { 3 30 } ])", &view), "Failed viewing a dictionary");
+    check(mn_view_type(view) == MN_DICT && mn_view_len(view) == 3, "Wrong dictionary view");
+    element = mn_view_at(view, 1);
+    check(mn_view_type(element) == MN_TUPLE && mn_view_len(element) == 2 &&
+          mn_view_int(mn_view_at(element, 1)) == 10 * mn_view_int(mn_view_at(element, 0)),
+          "Wrong dictionary entry");
+    sum = 0;
+    check(mn_view_visit(view, sum_visitor, &sum) && sum == 140, "Wrong dictionary visit");
+
+    current_test_name = "Views of strings";
+    check(mn_exec_view(ctx, "(cat \"hello\" \" world\")", &view), "Failed viewing a string");
+    check(mn_view_type(view) == MN_STRING && mn_view_len(view) == 11, "Wrong string view");
+    check(mn_view_char(mn_view_at(view, 4)) == 'o', "Wrong string character");
+    check(!strcmp(mn_view_string_ptr(view), "hello world"), "Wrong string copy");
+    check(mn_exec_view(ctx, "\"\"", &view) && !strcmp(mn_view_string_ptr(view), ""), "Wrong empty string copy");
+
+    check(!mn_exec_view(ctx, "(at [] 1)", &view) && mn_error_state(), "Failing view succeeded");
+    mn_error_reset();
+
+    mn_destroy(ctx);
+}
+
+/* Direct CLIFs.
+ * =============
+ */
+
+static void direct_sum(struct MoonCall *call)
+{
+    int64_t sum = 0;
+    mn_view_visit(mn_call_arg(call, 0), sum_visitor, &sum);
+    mn_call_push_int(call, sum);
+}
+
+static void direct_square(struct MoonCall *call)
+{
+    int64_t x = mn_view_int(mn_call_arg(call, 0));
+    mn_call_push_int(call, x * x);
+}
+
+/** Returns the tuples of the integers below the argument and their names. */
+static void direct_names(struct MoonCall *call)
+{
+    static const char *names[] = { "nil", "one", "two" };
+    int64_t i, n = mn_view_int(mn_call_arg(call, 0));
+
+    mn_call_push_array(call);
+    for (i = 0; i < n; ++i) {
+        mn_call_push_tuple(call);
+        mn_call_push_int(call, i);
+        mn_call_push_string(call, names[i]);
+        mn_call_push_end(call);
+    }
+    mn_call_push_end(call);
+}
+
+static void direct_last(struct MoonCall *call)
+{
+    struct MoonView arg = mn_call_arg(call, 0);
+    mn_call_push_copy(call, mn_view_at(arg, mn_view_len(arg) - 1));
+}
+
+static void direct_nothing(struct MoonCall *call)
+{
+    (void)call;
+}
+
+static void direct_two_values(struct MoonCall *call)
+{
+    mn_call_push_int(call, 1);
+    mn_call_push_int(call, 2);
+}
+
+static void direct_unfinished(struct MoonCall *call)
+{
+    mn_call_push_array(call);
+    mn_call_push_int(call, 1);
+}
+
+static void direct_unmatched_end(struct MoonCall *call)
+{
+    mn_call_push_int(call, 1);
+    mn_call_push_end(call);
+}
+
+static void direct_ints(struct MoonCall *call)
+{
+    int64_t count = mn_view_int(mn_call_arg(call, 0));
+    int64_t i;
+
+    mn_call_push_array(call);
+    for (i = 0; i < count; i++) {
+        mn_call_push_int(call, i);
+    }
+    mn_call_push_end(call);
+}
+
+static void direct_mixed(struct MoonCall *call)
+{
+    mn_call_push_array(call);
+    mn_call_push_int(call, 1);
+    mn_call_push_string(call, "two");
+    mn_call_push_end(call);
+}
+
+static void direct_fail(struct MoonCall *call)
+{
+    mn_call_fail(call, "Host operation failed");
+}
+
+static void test_direct_clif(void)
+{
+    struct MoonContext *ctx = begin_test("Direct CLIF results");
+    struct MoonValue *value;
+    char *message;
+
+    mn_register_direct_clif(ctx, "d_sum", 1, direct_sum);
+    mn_register_direct_clif(ctx, "d_square", 1, direct_square);
+    mn_register_direct_clif(ctx, "d_names", 1, direct_names);
+    mn_register_direct_clif(ctx, "d_last", 1, direct_last);
+    mn_register_direct_clif(ctx, "d_nothing", 0, direct_nothing);
+    mn_register_direct_clif(ctx, "d_two_values", 0, direct_two_values);
+    mn_register_direct_clif(ctx, "d_unfinished", 0, direct_unfinished);
+    mn_register_direct_clif(ctx, "d_unmatched_end", 0, direct_unmatched_end);
+    mn_register_direct_clif(ctx, "d_ints", 1, direct_ints);
+    mn_register_direct_clif(ctx, "d_mixed", 0, direct_mixed);
+    mn_register_direct_clif(ctx, "d_fail", 0, direct_fail);
+
+    check(exec_int(ctx, "(d_sum [ 1 2 3 4 ])") == 10, "Wrong scalar result");
+    check(exec_int(ctx, "(foldl + 0 (map d_square [ 1 2 3 ]))") == 14, "Direct CLIF failed as an argument");
+    check(exec_int(ctx, "(length (d_names 3))") == 3, "Wrong array result");
+    check(exec_int(ctx, "(if (eq (d_names 3) [ { 0 \"nil\" } { 1 \"one\" } { 2 \"two\" } ]) 1 0)") == 1,
+          "Wrong nested compound result");
+    check(exec_int(ctx, "(if (eq (d_names 0) []) 1 0)") == 1, "Wrong empty array result");
+    check(exec_int(ctx, "(if (eq (d_last [ { 1 'a' } { 2 'b' } ]) { 2 'b' }) 1 0)") == 1, "Wrong copied result");
+    check(exec_int(ctx, "(length (d_ints 5957))") == 5957, "Largest array result rejected");
+
+    value = mn_exec_command(ctx, "(d_nothing)");
+    check(value && value->type == MN_UNIT, "Empty result not a unit");
+    mn_dispose(value);
+
+    current_test_name = "Direct CLIF failures";
+    check(exec_fails(ctx, "(d_two_values)"), "Second value accepted");
+    check(exec_fails(ctx, "(d_unfinished)"), "Unfinished compound accepted");
+    check(exec_fails(ctx, "(d_unmatched_end)"), "Unmatched end accepted");
+    check(exec_fails(ctx, "(d_last (dict [ { 1 2 } ]))"), "Dictionary entry copied");
+    check(exec_fails(ctx, "(d_sum [ 1 2 ] 3)"), "Wrong arity accepted");
+    check(exec_fails(ctx, "(length (d_ints 5958))"), "Oversized array accepted");
+    check(exec_fails(ctx, "(length (d_ints 10000))"), "Oversized array accepted");
+    check(exec_fails(ctx, "(d_mixed)"), "Heterogeneous array accepted");
+
+    value = mn_exec_command(ctx, "(d_fail)");
+    message = (char*)mn_error_message();
+    check(!value && strstr(message, "Host operation failed"), "Failure not reported");
+    free(message);
+    mn_error_reset();
+
+    check(exec_int(ctx, "(+ (d_sum [ 1 2 ]) 1)") == 4, "Context broken by the failures");
+
+    mn_destroy(ctx);
+}
+
+/* Function handles.
+ * =================
+ */
+
+static void test_function(void)
+{
+    struct MoonContext *ctx = begin_test("Function handle calls");
+    struct MoonFunction *add3, *add_4_6, *times2, *failing;
+    struct MoonValue *args;
+    struct MoonView view;
+    int64_t i;
+
+    exec(ctx, "(bind k 100)");
+    exec(ctx, "(bind k^ (ptr k))");
+    exec(ctx, "(bind add3 (func (x y z) (+ x (+ y (+ z k)))))");
+    exec(ctx, "(bind add_4_6 (add3 4 6))");
+    exec(ctx, "(bind times2 (* 2))");
+    exec(ctx, "(bind failing (func (x) (at [] x)))");
+
+    add3 = mn_get_function(ctx, "add3");
+    add_4_6 = mn_get_function(ctx, "add_4_6");
+    times2 = mn_get_function(ctx, "times2");
+    failing = mn_get_function(ctx, "failing");
+    check(add3 && add_4_6 && times2 && failing, "Failed getting function handles");
+
+    for (i = 0; i < 100; ++i) {
+        if (call_int(add3, make_ints(3, i, 1)) != 3 * i + 103) {
+            break;
+        }
+    }
+    check(i == 100, "Wrong result of the call %d", (int)i);
+    check(call_int(add_4_6, make_ints(1, 5, 0)) == 115, "Wrong result of a partial application");
+    check(call_int(times2, make_ints(1, 21, 0)) == 42, "Wrong result of a partial BIF application");
+
+    exec(ctx, "(poke k^ 200)");
+    check(call_int(add3, make_ints(3, 0, 0)) == 200, "Global assignment not visible to the handle");
+
+    args = make_int(4);
+    check(mn_call_view(times2, args, &view) && mn_view_int(view) == 8, "Wrong viewed result");
+    mn_dispose(args);
+
+    current_test_name = "Function handle failures";
+    check(call_fails(add3, make_ints(2, 1, 1)), "Too few arguments accepted");
+    check(call_fails(add3, make_ints(4, 1, 1)), "Too many arguments accepted");
+    check(call_fails(add3, NULL), "No arguments accepted");
+    check(call_fails(failing, make_int(1)), "Failing function succeeded");
+    check(call_int(add3, make_ints(3, 1, 0)) == 203, "Handle broken by the failures");
+
+    check(!mn_get_function(ctx, "k") && mn_error_state(), "Handle of a non-function made");
+    mn_error_reset();
+    check(!mn_get_function(ctx, "no_such_symbol") && mn_error_state(), "Handle of an unbound symbol made");
+    mn_error_reset();
+
+    mn_function_free(add3);
+    mn_function_free(add_4_6);
+    mn_function_free(times2);
+    mn_function_free(failing);
+    mn_destroy(ctx);
+}
+
+/* Prepared commands.
+ * ==================
+ */
+
+static int64_t execute_int(struct MoonPrepared *prep, struct MoonValue *params)
+{
+    int64_t result = -1;
+    struct MoonValue *value = mn_execute(prep, params);
+    if (value && value->type == MN_INT) {
+        result = value->data.integer;
+    }
+    mn_dispose(value);
+    mn_dispose(params);
+    mn_error_reset();
+    return result;
+}
+
+static bool prepare_fails(struct MoonContext *ctx, const char *source, const char **param_names)
+{
+    struct MoonPrepared *prep = mn_prepare(ctx, source, param_names);
+    bool result = !prep && mn_error_state();
+    if (prep) {
+        mn_prepared_free(prep);
+    }
+    mn_error_reset();
+    return result;
+}
+
+static void test_prepared(void)
+{
+    struct MoonContext *ctx = begin_test("Prepared command parameters");
+    const char *xy[] = { "x", "y", NULL }, *xx[] = { "x", "x", NULL };
+    struct MoonPrepared *linear, *local, *constant;
+    struct MoonValue *params;
+    struct MoonView view;
+    int64_t i;
+
+    exec(ctx, "(bind k 10)");
+    linear = mn_prepare(ctx, "(+ x (* y k))", xy);
+    local = mn_prepare(ctx, "(do (bind t (* x y)) (+ t 1))", xy);
+    constant = mn_prepare(ctx, "(+ k 1)", NULL);
+    check(linear && local && constant, "Failed preparing commands");
+
+    for (i = 0; i < 100; ++i) {
+        if (execute_int(linear, make_ints(2, i, 1)) != i + (i + 1) * 10) {
+            break;
+        }
+    }
+    check(i == 100, "Wrong result of the execution %d", (int)i);
+
+    check(execute_int(local, make_ints(2, 2, 1)) == 7, "Wrong result of a command binding a symbol");
+    check(execute_int(local, make_ints(2, 3, 1)) == 13, "Command binding a symbol not executed again");
+    check(exec_fails(ctx, "t"), "Symbol bound by a prepared command outlived it");
+    check(exec_fails(ctx, "x"), "Parameter visible to other commands");
+    check(execute_int(constant, NULL) == 11, "Wrong result of a command without parameters");
+
+    params = make_ints(2, 1, 1);
+    check(mn_execute_view(linear, params, &view) && mn_view_int(view) == 21, "Wrong viewed result");
+    mn_dispose(params);
+
+    current_test_name = "Prepared command failures";
+    check(execute_int(linear, make_ints(1, 1, 0)) == -1, "Too few parameters accepted");
+    check(execute_int(linear, make_ints(3, 1, 0)) == -1, "Too many parameters accepted");
+    check(execute_int(linear, make_ints(2, 2, 2)) == 42, "Command broken by the failures");
+
+    check(prepare_fails(ctx, "(+ x x)", xx), "Duplicate parameter names accepted");
+    check(prepare_fails(ctx, "(+ x 1) (+ y 1)", xy), "Several expressions accepted");
+    check(prepare_fails(ctx, "", NULL), "Empty command accepted");
+    check(prepare_fails(ctx, "(+ x", xy), "Malformed command accepted");
+
+    mn_prepared_free(linear);
+    mn_prepared_free(local);
+    mn_prepared_free(constant);
+    mn_destroy(ctx);
+}
+
+/* Parse cache.
+ * ============
+ */
+
+/** Executes a command, returns whether it has been found in the cache. */
+static bool cache_hit(struct MoonContext *ctx, const char *source)
+{
+    int64_t hits, misses, hits_before, misses_before;
+
+    mn_parse_cache_stats(ctx, &hits_before, &misses_before);
+    mn_dispose(mn_exec_command(ctx, source));
+    mn_error_reset();
+    mn_parse_cache_stats(ctx, &hits, &misses);
+
+    return hits == hits_before + 1 && misses == misses_before;
+}
+
+static void test_parse_cache(void)
+{
+    struct MoonContext *ctx = begin_test("Parse cache hits");
+    struct MoonContext *clone;
+    const char *a = "(+ k 1)", *b = "(+ k 2)", *c = "(+ k 3)";
+    int64_t hits, misses;
+
+    exec(ctx, "(bind k 10)");
+    exec(ctx, "(bind k^ (ptr k))");
+    check(!cache_hit(ctx, a) && !cache_hit(ctx, a), "Command cached while disabled");
+    mn_parse_cache_stats(ctx, &hits, &misses);
+    check(hits == 0 && misses == 0, "Disabled cache counted");
+
+    mn_set_parse_cache(ctx, 2);
+    check(!cache_hit(ctx, a), "Hit in an empty cache");
+    check(cache_hit(ctx, a), "Repeated command missed");
+    check(exec_int(ctx, a) == 11, "Wrong result of a cached command");
+    exec(ctx, "(poke k^ 20)");
+    check(exec_int(ctx, a) == 21, "Cached command not evaluated again");
+
+    current_test_name = "Parse cache eviction";
+    check(!cache_hit(ctx, b), "Hit of a new command");
+    check(cache_hit(ctx, a), "Command missed before the eviction");
+    check(!cache_hit(ctx, c), "Hit of a new command");
+    check(!cache_hit(ctx, b), "Least recently used command not evicted");
+    check(!cache_hit(ctx, a), "Most recently used command not kept");
+    check(cache_hit(ctx, b), "Command missed after the eviction");
+
+    mn_set_parse_cache(ctx, 1);
+    check(!cache_hit(ctx, a), "Command kept past a shrink");
+    check(cache_hit(ctx, a), "Command missed after a shrink");
+
+    current_test_name = "Parse cache exclusions";
+    mn_set_parse_cache(ctx, 2);
+    check(!cache_hit(ctx, b), "Hit of a new command");
+    check(!cache_hit(ctx, "(bind l 1)"), "Bind cached");
+    check(!cache_hit(ctx, "(spawn (func () (+ k 1)))"), "Spawn cached");
+    check(!cache_hit(ctx, "(at [] 1)") && !cache_hit(ctx, "(at [] 1)"), "Failing command cached");
+    check(cache_hit(ctx, a) && cache_hit(ctx, b), "Live command evicted by an excluded one");
+    check(exec_int(ctx, "l") == 1, "Symbol not bound by an excluded command");
+
+    clone = mn_clone(ctx);
+    current_test_name = "Parse cache clone";
+    check(!cache_hit(clone, a), "Clone started with a filled cache");
+    check(cache_hit(clone, a), "Clone cache disabled");
+    mn_destroy(clone);
+
+    mn_destroy(ctx);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s {std.mn}\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std_path = argv[1];
+
+    test_clone();
+    test_image();
+    test_task();
+    test_budget();
+    test_interrupt();
+    test_view();
+    test_direct_clif();
+    test_function();
+    test_prepared();
+    test_parse_cache();
+
+    mn_error_reset();
+
+    printf(
+        "Summary:\n"
+        "* %d/%d checks succeeded.\n",
+        tests_performed - tests_failed,
+        tests_performed);
+
+    return tests_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -12,6 +12,9 @@
 
 #define COMMENT_CHAR '#'
 
+/* Fixed, so that pmap runs on worker threads on any machine. */
+#define TEST_POOL_SIZE 3
+
 static struct Runtime *rt;
 int unexpected_fails;
 VAL_LOC_T last_loc;
@@ -48,6 +51,14 @@ char *type_to_string(enum ValueType type)
         return "unit";
     case VAL_DATATYPE:
         return "datatype";
+    case VAL_DICT:
+        return "dict";
+    case VAL_SEQ:
+        return "sequence";
+    case VAL_SAMPLER:
+        return "sampler";
+    case VAL_CHANNEL:
+        return "channel";
     }
 }
 
@@ -144,6 +155,7 @@ void run_command_test(char *args)
     rt_free(rt);
 
     rt = rt_make();
+    rt_set_pool_size(rt, TEST_POOL_SIZE);
     current_test_name = (char*)mem_malloc(len);
     memcpy(current_test_name, args, len - 1);
     current_test_name[len - 1] = '\0';
@@ -352,6 +364,7 @@ bool run_script(FILE *script)
 {
     bool eof = false;
     rt = rt_make();
+    rt_set_pool_size(rt, TEST_POOL_SIZE);
     unexpected_fails = 0;
     tests_performed = tests_failed = 0;
     last_expression = NULL;
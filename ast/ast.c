@@ -363,6 +363,32 @@ struct AstNode *ast_make_spec_succ(struct AstNode *pointer)
     return result;
 }
 
+struct AstNode *ast_make_spec_pipeline(struct AstNode *expr)
+{
+    struct AstNode *result = mem_malloc(sizeof(*result));
+
+    result->next = NULL;
+    result->type = AST_SPECIAL;
+
+    result->data.special.type = AST_SPEC_PIPELINE;
+    result->data.special.data.pipeline.expr = expr;
+
+    return result;
+}
+
+struct AstNode *ast_make_spec_par(struct AstNode *exprs)
+{
+    struct AstNode *result = mem_malloc(sizeof(*result));
+
+    result->next = NULL;
+    result->type = AST_SPECIAL;
+
+    result->data.special.type = AST_SPEC_PAR;
+    result->data.special.data.par.exprs = exprs;
+
+    return result;
+}
+
 struct AstNode *ast_make_func_call(
     struct AstNode *func,
     struct AstNode *args)
@@ -614,6 +640,16 @@ static void ast_special_succ_free(struct AstSpecSucc *succ)
     ast_node_free(succ->pointer);
 }
 
+static void ast_special_pipeline_free(struct AstSpecPipeline *pipeline)
+{
+    ast_node_free(pipeline->expr);
+}
+
+static void ast_special_par_free(struct AstSpecPar *par)
+{
+    ast_node_free(par->exprs);
+}
+
 static void ast_special_free(struct AstSpecial *special)
 {
     switch (special->type) {
@@ -708,6 +744,14 @@ static void ast_special_free(struct AstSpecial *special)
     case AST_SPEC_SUCC:
         ast_special_succ_free(&special->data.succ);
         break;
+
+    case AST_SPEC_PIPELINE:
+        ast_special_pipeline_free(&special->data.pipeline);
+        break;
+
+    case AST_SPEC_PAR:
+        ast_special_par_free(&special->data.par);
+        break;
     }
 }
 
@@ -844,6 +888,10 @@ bool ast_list_contains_symbol(struct AstNode *list, char *symbol)
                 return ast_list_contains_symbol(list->data.special.data.inc.pointer, symbol);
             case AST_SPEC_SUCC:
                 return ast_list_contains_symbol(list->data.special.data.succ.pointer, symbol);
+            case AST_SPEC_PIPELINE:
+                return ast_list_contains_symbol(list->data.special.data.pipeline.expr, symbol);
+            case AST_SPEC_PAR:
+                return ast_list_contains_symbol(list->data.special.data.par.exprs, symbol);
             }
         case AST_FUNCTION_CALL:
             return
@@ -47,7 +47,13 @@ enum AstSpecialType {
     AST_SPEC_BEGIN,
     AST_SPEC_END,
     AST_SPEC_INC,
-    AST_SPEC_SUCC
+    AST_SPEC_SUCC,
+
+    /* Collection processing */
+    AST_SPEC_PIPELINE,
+
+    /* Concurrency */
+    AST_SPEC_PAR
 };
 
 enum AstLiteralCompoundType {
@@ -185,6 +191,14 @@ struct AstSpecSucc {
     struct AstNode *pointer;
 };
 
+struct AstSpecPipeline {
+    struct AstNode *expr;
+};
+
+struct AstSpecPar {
+    struct AstNode *exprs;
+};
+
 struct AstSpecial {
     enum AstSpecialType type;
     union {
@@ -211,6 +225,8 @@ struct AstSpecial {
         struct AstSpecEnd end;
         struct AstSpecInc inc;
         struct AstSpecSucc succ;
+        struct AstSpecPipeline pipeline;
+        struct AstSpecPar par;
     } data;
 };
 
@@ -320,6 +336,10 @@ struct AstNode *ast_make_spec_inc(struct AstNode* pointer);
 
 struct AstNode *ast_make_spec_succ(struct AstNode* pointer);
 
+struct AstNode *ast_make_spec_pipeline(struct AstNode* expr);
+
+struct AstNode *ast_make_spec_par(struct AstNode* exprs);
+
 struct AstNode *ast_make_func_call(
         struct AstNode *func,
         struct AstNode *args);
@@ -0,0 +1,600 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast_image.h"
+#include "collection.h"
+#include "memory.h"
+
+#define AST_IMAGE_NO_NODE -1
+#define AST_IMAGE_MAX_SLOTS 3
+
+void ast_image_buffer_init(struct AstImageBuffer *buffer)
+{
+    buffer->data = NULL;
+    buffer->size = 0;
+    buffer->cap = 0;
+}
+
+void ast_image_buffer_deinit(struct AstImageBuffer *buffer)
+{
+    mem_free(buffer->data);
+}
+
+void ast_image_put(struct AstImageBuffer *buffer, void *data, int size)
+{
+    if (buffer->size + size > buffer->cap) {
+        buffer->cap = (buffer->size + size) * 2;
+        buffer->data = mem_realloc(buffer->data, buffer->cap);
+    }
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+}
+
+bool ast_image_get(char **cursor, char *end, void *data, int size)
+{
+    if (end - *cursor < size) {
+        return false;
+    }
+    memcpy(data, *cursor, size);
+    *cursor += size;
+    return true;
+}
+
+/* Node lookup.
+ * ============
+ */
+
+static unsigned ast_image_hash(struct AstNode *node, int cap)
+{
+    uintptr_t value = (uintptr_t)node;
+    return (unsigned)((value >> 4) * 2654435761u) & (cap - 1);
+}
+
+static void ast_image_nodes_rehash(struct AstImageNodes *nodes, int cap)
+{
+    int i;
+    mem_free(nodes->table);
+    nodes->table = mem_malloc(cap * sizeof(*nodes->table));
+    nodes->table_cap = cap;
+    for (i = 0; i < cap; ++i) {
+        nodes->table[i] = AST_IMAGE_NO_NODE;
+    }
+    for (i = 0; i < nodes->array.size; ++i) {
+        unsigned slot = ast_image_hash(nodes->array.data[i], cap);
+        while (nodes->table[slot] != AST_IMAGE_NO_NODE) {
+            slot = (slot + 1) & (cap - 1);
+        }
+        nodes->table[slot] = i;
+    }
+}
+
+static void ast_image_nodes_add(struct AstImageNodes *nodes, struct AstNode *node)
+{
+    ARRAY_APPEND(nodes->array, node);
+    if (nodes->array.size * 2 > nodes->table_cap) {
+        ast_image_nodes_rehash(nodes, nodes->table_cap * 2);
+    } else {
+        unsigned slot = ast_image_hash(node, nodes->table_cap);
+        while (nodes->table[slot] != AST_IMAGE_NO_NODE) {
+            slot = (slot + 1) & (nodes->table_cap - 1);
+        }
+        nodes->table[slot] = nodes->array.size - 1;
+    }
+}
+
+void ast_image_nodes_init(struct AstImageNodes *nodes)
+{
+    nodes->array.data = NULL;
+    nodes->array.size = 0;
+    nodes->array.cap = 0;
+    nodes->table = NULL;
+    ast_image_nodes_rehash(nodes, 64);
+}
+
+void ast_image_nodes_deinit(struct AstImageNodes *nodes)
+{
+    ARRAY_FREE(nodes->array);
+    mem_free(nodes->table);
+}
+
+int ast_image_nodes_find(struct AstImageNodes *nodes, struct AstNode *node)
+{
+    unsigned slot;
+    int index;
+
+    if (!node) {
+        return AST_IMAGE_NO_NODE;
+    }
+
+    slot = ast_image_hash(node, nodes->table_cap);
+    while ((index = nodes->table[slot]) != AST_IMAGE_NO_NODE) {
+        if (nodes->array.data[index] == node) {
+            return index;
+        }
+        slot = (slot + 1) & (nodes->table_cap - 1);
+    }
+
+    return AST_IMAGE_NO_NODE;
+}
+
+/* Node fields.
+ * ============
+ */
+
+/** Stores the addresses of the node's fields pointing to other nodes. */
+static int ast_image_slots(struct AstNode *node, struct AstNode ***slots)
+{
+    struct AstSpecial *special = &node->data.special;
+
+    switch (node->type) {
+    case AST_SYMBOL:
+    case AST_LITERAL_ATOMIC:
+        return 0;
+
+    case AST_FUNCTION_CALL:
+        slots[0] = &node->data.func_call.func;
+        slots[1] = &node->data.func_call.actual_args;
+        return 2;
+
+    case AST_LITERAL_COMPOUND:
+        slots[0] = &node->data.literal_compound.exprs;
+        return 1;
+
+    case AST_SPECIAL:
+        break;
+    }
+
+    switch (special->type) {
+    case AST_SPEC_DO:
+        slots[0] = &special->data.doo.exprs;
+        return 1;
+
+    case AST_SPEC_MATCH:
+        slots[0] = &special->data.match.expr;
+        slots[1] = &special->data.match.keys;
+        slots[2] = &special->data.match.values;
+        return 3;
+
+    case AST_SPEC_IF:
+        slots[0] = &special->data.iff.test;
+        slots[1] = &special->data.iff.true_expr;
+        slots[2] = &special->data.iff.false_expr;
+        return 3;
+
+    case AST_SPEC_WHILE:
+        slots[0] = &special->data.whilee.test;
+        slots[1] = &special->data.whilee.expr;
+        return 2;
+
+    case AST_SPEC_FUNC_DEF:
+        slots[0] = &special->data.func_def.formal_args;
+        slots[1] = &special->data.func_def.expr;
+        return 2;
+
+    case AST_SPEC_BOOL_AND:
+        slots[0] = &special->data.bool_and.exprs;
+        return 1;
+
+    case AST_SPEC_BOOL_OR:
+        slots[0] = &special->data.bool_or.exprs;
+        return 1;
+
+    case AST_SPEC_SET_OF:
+        slots[0] = &special->data.set_of.types;
+        return 1;
+
+    case AST_SPEC_RANGE_OF:
+        slots[0] = &special->data.range_of.bound_lo;
+        slots[1] = &special->data.range_of.bound_hi;
+        return 2;
+
+    case AST_SPEC_ARRAY_OF:
+        slots[0] = &special->data.array_of.type;
+        return 1;
+
+    case AST_SPEC_TUPLE_OF:
+        slots[0] = &special->data.tuple_of.types;
+        return 1;
+
+    case AST_SPEC_POINTER_TO:
+        slots[0] = &special->data.pointer_to.type;
+        return 1;
+
+    case AST_SPEC_FUNCTION_TYPE:
+        slots[0] = &special->data.function_type.types;
+        return 1;
+
+    case AST_SPEC_TYPE_PRODUCT:
+        slots[0] = &special->data.type_product.args;
+        return 1;
+
+    case AST_SPEC_TYPE_UNION:
+        slots[0] = &special->data.type_union.args;
+        return 1;
+
+    case AST_SPEC_BIND:
+        slots[0] = &special->data.bind.pattern;
+        slots[1] = &special->data.bind.expr;
+        return 2;
+
+    case AST_SPEC_PTR:
+        slots[0] = &special->data.pointer.expr;
+        return 1;
+
+    case AST_SPEC_PEEK:
+        slots[0] = &special->data.peek.expr;
+        return 1;
+
+    case AST_SPEC_POKE:
+        slots[0] = &special->data.poke.pointer;
+        slots[1] = &special->data.poke.value;
+        return 2;
+
+    case AST_SPEC_BEGIN:
+        slots[0] = &special->data.begin.collection;
+        return 1;
+
+    case AST_SPEC_END:
+        slots[0] = &special->data.end.collection;
+        return 1;
+
+    case AST_SPEC_INC:
+        slots[0] = &special->data.inc.pointer;
+        return 1;
+
+    case AST_SPEC_SUCC:
+        slots[0] = &special->data.succ.pointer;
+        return 1;
+
+    case AST_SPEC_PIPELINE:
+        slots[0] = &special->data.pipeline.expr;
+        return 1;
+
+    case AST_SPEC_PAR:
+        slots[0] = &special->data.par.exprs;
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Writing.
+ * ========
+ */
+
+static void ast_image_put_int(struct AstImageBuffer *buffer, int32_t value)
+{
+    ast_image_put(buffer, &value, sizeof(value));
+}
+
+static void ast_image_put_string(struct AstImageBuffer *buffer, char *string)
+{
+    int32_t len = strlen(string);
+    ast_image_put_int(buffer, len);
+    ast_image_put(buffer, string, len);
+}
+
+static void ast_image_put_atomic(
+        struct AstImageBuffer *buffer,
+        struct AstLiteralAtomic *atomic)
+{
+    int64_t integer;
+
+    switch (atomic->type) {
+    case AST_LIT_ATOM_UNIT:
+        break;
+
+    case AST_LIT_ATOM_BOOL:
+        ast_image_put_int(buffer, atomic->data.boolean);
+        break;
+
+    case AST_LIT_ATOM_CHAR:
+        ast_image_put(buffer, &atomic->data.character, sizeof(char));
+        break;
+
+    case AST_LIT_ATOM_INT:
+        integer = atomic->data.integer;
+        ast_image_put(buffer, &integer, sizeof(integer));
+        break;
+
+    case AST_LIT_ATOM_REAL:
+        ast_image_put(buffer, &atomic->data.real, sizeof(double));
+        break;
+
+    case AST_LIT_ATOM_STRING:
+        ast_image_put_string(buffer, atomic->data.string);
+        break;
+
+    case AST_LIT_ATOM_DATATYPE:
+        ast_image_put_int(buffer, atomic->data.datatype);
+        break;
+    }
+}
+
+static void ast_image_put_node(
+        struct AstImageBuffer *buffer,
+        struct AstNode *node,
+        struct AstImageNodes *nodes)
+{
+    struct AstNode **slots[AST_IMAGE_MAX_SLOTS];
+    int i, slot_count = ast_image_slots(node, slots);
+
+    ast_image_put_int(buffer, node->type);
+
+    switch (node->type) {
+    case AST_SYMBOL:
+        ast_image_put_string(buffer, node->data.symbol.symbol);
+        break;
+
+    case AST_SPECIAL:
+        ast_image_put_int(buffer, node->data.special.type);
+        break;
+
+    case AST_FUNCTION_CALL:
+        break;
+
+    case AST_LITERAL_COMPOUND:
+        ast_image_put_int(buffer, node->data.literal_compound.type);
+        break;
+
+    case AST_LITERAL_ATOMIC:
+        ast_image_put_int(buffer, node->data.literal_atomic.type);
+        ast_image_put_atomic(buffer, &node->data.literal_atomic);
+        break;
+    }
+
+    for (i = 0; i < slot_count; ++i) {
+        ast_image_put_int(buffer, ast_image_nodes_find(nodes, *slots[i]));
+    }
+    ast_image_put_int(buffer, ast_image_nodes_find(nodes, node->next));
+}
+
+void ast_image_write(
+        struct AstImageBuffer *buffer,
+        struct AstNode **roots,
+        int root_count,
+        struct AstImageNodes *nodes)
+{
+    int i;
+    struct { struct AstNode **data; int size, cap; } pending = { NULL, 0, 0 };
+
+    /* Number all the reachable nodes first, so that the records may refer
+     * to the nodes written after them. */
+    for (i = 0; i < root_count; ++i) {
+        ARRAY_APPEND(pending, roots[i]);
+    }
+
+    while (pending.size) {
+        struct AstNode *node = pending.data[--pending.size];
+        struct AstNode **slots[AST_IMAGE_MAX_SLOTS];
+        int slot_count;
+
+        if (!node || ast_image_nodes_find(nodes, node) != AST_IMAGE_NO_NODE) {
+            continue;
+        }
+
+        ast_image_nodes_add(nodes, node);
+        slot_count = ast_image_slots(node, slots);
+        ARRAY_APPEND(pending, node->next);
+        for (i = 0; i < slot_count; ++i) {
+            ARRAY_APPEND(pending, *slots[i]);
+        }
+    }
+
+    ARRAY_FREE(pending);
+
+    ast_image_put_int(buffer, nodes->array.size);
+    for (i = 0; i < nodes->array.size; ++i) {
+        ast_image_put_node(buffer, nodes->array.data[i], nodes);
+    }
+}
+
+/* Reading.
+ * ========
+ */
+
+static bool ast_image_get_int(char **cursor, char *end, int32_t *value)
+{
+    return ast_image_get(cursor, end, value, sizeof(*value));
+}
+
+static bool ast_image_get_string(char **cursor, char *end, char **string)
+{
+    int32_t len;
+    if (!ast_image_get_int(cursor, end, &len) || len < 0 || end - *cursor < len) {
+        return false;
+    }
+    *string = mem_malloc(len + 1);
+    memcpy(*string, *cursor, len);
+    (*string)[len] = '\0';
+    *cursor += len;
+    return true;
+}
+
+static bool ast_image_get_node_ref(
+        char **cursor,
+        char *end,
+        struct AstImageNodes *nodes,
+        struct AstNode **node)
+{
+    int32_t index;
+    if (!ast_image_get_int(cursor, end, &index) ||
+        index < AST_IMAGE_NO_NODE || index >= nodes->array.size) {
+        return false;
+    }
+    *node = index == AST_IMAGE_NO_NODE ? NULL : nodes->array.data[index];
+    return true;
+}
+
+static bool ast_image_get_atomic(
+        char **cursor,
+        char *end,
+        struct AstLiteralAtomic *atomic)
+{
+    int32_t value;
+    int64_t integer;
+
+    switch (atomic->type) {
+    case AST_LIT_ATOM_UNIT:
+        return true;
+
+    case AST_LIT_ATOM_BOOL:
+        if (!ast_image_get_int(cursor, end, &value)) {
+            return false;
+        }
+        atomic->data.boolean = value;
+        return true;
+
+    case AST_LIT_ATOM_CHAR:
+        return ast_image_get(cursor, end, &atomic->data.character, sizeof(char));
+
+    case AST_LIT_ATOM_INT:
+        if (!ast_image_get(cursor, end, &integer, sizeof(integer))) {
+            return false;
+        }
+        atomic->data.integer = integer;
+        return true;
+
+    case AST_LIT_ATOM_REAL:
+        return ast_image_get(cursor, end, &atomic->data.real, sizeof(double));
+
+    case AST_LIT_ATOM_STRING:
+        return ast_image_get_string(cursor, end, &atomic->data.string);
+
+    case AST_LIT_ATOM_DATATYPE:
+        if (!ast_image_get_int(cursor, end, &value)) {
+            return false;
+        }
+        atomic->data.datatype = value;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Reads a node record. The node type is set to an atomic unit until the
+ * record is complete, so that a partially read node owns no memory.
+ */
+static bool ast_image_get_node(
+        char **cursor,
+        char *end,
+        struct AstNode *node,
+        struct AstImageNodes *nodes)
+{
+    int32_t type, subtype;
+    struct AstNode **slots[AST_IMAGE_MAX_SLOTS];
+    int i, slot_count;
+    char *string;
+
+    if (!ast_image_get_int(cursor, end, &type)) {
+        return false;
+    }
+
+    switch (type) {
+    case AST_SYMBOL:
+        if (!ast_image_get_string(cursor, end, &string)) {
+            return false;
+        }
+        node->data.symbol.symbol = string;
+        break;
+
+    case AST_SPECIAL:
+        if (!ast_image_get_int(cursor, end, &subtype) ||
+            subtype < AST_SPEC_DO || subtype > AST_SPEC_PAR) {
+            return false;
+        }
+        node->data.special.type = subtype;
+        break;
+
+    case AST_FUNCTION_CALL:
+        break;
+
+    case AST_LITERAL_COMPOUND:
+        if (!ast_image_get_int(cursor, end, &subtype) ||
+            (subtype != AST_LIT_CPD_ARRAY && subtype != AST_LIT_CPD_TUPLE)) {
+            return false;
+        }
+        node->data.literal_compound.type = subtype;
+        break;
+
+    case AST_LITERAL_ATOMIC:
+        if (!ast_image_get_int(cursor, end, &subtype) ||
+            subtype < AST_LIT_ATOM_UNIT || subtype > AST_LIT_ATOM_DATATYPE) {
+            return false;
+        }
+        node->data.literal_atomic.type = subtype;
+        if (!ast_image_get_atomic(cursor, end, &node->data.literal_atomic)) {
+            node->data.literal_atomic.type = AST_LIT_ATOM_UNIT;
+            return false;
+        }
+        break;
+
+    default:
+        return false;
+    }
+
+    node->type = type;
+    slot_count = ast_image_slots(node, slots);
+    for (i = 0; i < slot_count; ++i) {
+        if (!ast_image_get_node_ref(cursor, end, nodes, slots[i])) {
+            return false;
+        }
+    }
+
+    return ast_image_get_node_ref(cursor, end, nodes, &node->next);
+}
+
+void ast_image_nodes_free(struct AstImageNodes *nodes)
+{
+    int i;
+
+    for (i = 0; i < nodes->array.size; ++i) {
+        struct AstNode *node = nodes->array.data[i];
+        if (node->type == AST_SYMBOL) {
+            mem_free(node->data.symbol.symbol);
+        } else if (node->type == AST_LITERAL_ATOMIC &&
+                   node->data.literal_atomic.type == AST_LIT_ATOM_STRING) {
+            mem_free(node->data.literal_atomic.data.string);
+        }
+        mem_free(node);
+    }
+
+    nodes->array.size = 0;
+    ast_image_nodes_rehash(nodes, nodes->table_cap);
+}
+
+bool ast_image_read(char **cursor, char *end, struct AstImageNodes *nodes)
+{
+    int32_t count, i;
+
+    if (!ast_image_get_int(cursor, end, &count) ||
+        count < 0 ||
+        end - *cursor < count) {
+        return false;
+    }
+
+    for (i = 0; i < count; ++i) {
+        struct AstNode *node = mem_malloc(sizeof(*node));
+        node->type = AST_LITERAL_ATOMIC;
+        node->data.literal_atomic.type = AST_LIT_ATOM_UNIT;
+        node->next = NULL;
+        ast_image_nodes_add(nodes, node);
+    }
+
+    for (i = 0; i < count; ++i) {
+        if (!ast_image_get_node(cursor, end, nodes->array.data[i], nodes)) {
+            break;
+        }
+    }
+
+    if (i < count) {
+        ast_image_nodes_free(nodes);
+        return false;
+    }
+
+    return true;
+}
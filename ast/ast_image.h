@@ -0,0 +1,61 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#ifndef AST_IMAGE_H
+#define AST_IMAGE_H
+
+#include <stdbool.h>
+
+#include "ast.h"
+
+/*
+ * The binary image of an AST is a flat array of node records, in which the
+ * pointers to the other nodes are replaced with their indices. Since the
+ * nodes link their children through the next pointers across the fields,
+ * the whole graph is stored rather than a tree of lists.
+ */
+
+struct AstImageBuffer {
+    char *data;
+    int size, cap;
+};
+
+/** The nodes of an image by index, with a reverse lookup. */
+struct AstImageNodes {
+    struct { struct AstNode **data; int size, cap; } array;
+    int *table;
+    int table_cap;
+};
+
+void ast_image_buffer_init(struct AstImageBuffer *buffer);
+void ast_image_buffer_deinit(struct AstImageBuffer *buffer);
+void ast_image_put(struct AstImageBuffer *buffer, void *data, int size);
+
+/** Reads bytes at the cursor, returns false if there are not enough. */
+bool ast_image_get(char **cursor, char *end, void *data, int size);
+
+void ast_image_nodes_init(struct AstImageNodes *nodes);
+void ast_image_nodes_deinit(struct AstImageNodes *nodes);
+
+/** Returns the index of the node in the image or -1 if it is not there. */
+int ast_image_nodes_find(struct AstImageNodes *nodes, struct AstNode *node);
+
+/** Writes the image of all the nodes reachable from the roots. */
+void ast_image_write(
+        struct AstImageBuffer *buffer,
+        struct AstNode **roots,
+        int root_count,
+        struct AstImageNodes *nodes);
+
+/**
+ * Releases the nodes one by one, regardless of the links between them. Only
+ * meant for the nodes that have been read but not handed over yet.
+ */
+void ast_image_nodes_free(struct AstImageNodes *nodes);
+
+/**
+ * Rebuilds the nodes from the image at the cursor. Returns false if the image
+ * is malformed, in which case no nodes are left allocated.
+ */
+bool ast_image_read(char **cursor, char *end, struct AstImageNodes *nodes);
+
+#endif
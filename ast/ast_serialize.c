@@ -274,6 +274,12 @@ static char *ast_serialize_special(struct AstSpecial *special)
 
     case AST_SPEC_SUCC:
         return ast_serialize_special_common("succ", special->data.succ.pointer);
+
+    case AST_SPEC_PIPELINE:
+        return ast_serialize_special_common("pipeline", special->data.pipeline.expr);
+
+    case AST_SPEC_PAR:
+        return ast_serialize_special_common("par", special->data.par.exprs);
     }
 
     /* 2. The result is returned passing the ownership. */
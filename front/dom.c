@@ -37,6 +37,8 @@ static char *reserved[] = {
     "end",
     "inc",
     "succ",
+    "pipeline",
+    "par",
     "func",
     "void",
     "unit",
@@ -53,6 +53,8 @@ enum Reserved {
     DOM_RES_END,
     DOM_RES_INC,
     DOM_RES_SUCC,
+    DOM_RES_PIPELINE,
+    DOM_RES_PAR,
     DOM_RES_FUNC,
     DOM_RES_VOID,
     DOM_RES_UNIT,
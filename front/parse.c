@@ -861,7 +861,9 @@ static struct AstNode *parse_special(
         (!err_state() && (result = parse_unary(dom, DOM_RES_BEGIN, ast_make_spec_begin, state))) ||
         (!err_state() && (result = parse_unary(dom, DOM_RES_END, ast_make_spec_end, state))) ||
         (!err_state() && (result = parse_unary(dom, DOM_RES_INC, ast_make_spec_inc, state))) ||
-        (!err_state() && (result = parse_unary(dom, DOM_RES_SUCC, ast_make_spec_succ, state)))) {
+        (!err_state() && (result = parse_unary(dom, DOM_RES_SUCC, ast_make_spec_succ, state))) ||
+        (!err_state() && (result = parse_unary(dom, DOM_RES_PIPELINE, ast_make_spec_pipeline, state))) ||
+        (!err_state() && (result = parse_min_nary(dom, 1, DOM_RES_PAR, ast_make_spec_par, state)))) {
         return result;
 
     } else {
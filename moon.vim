@@ -7,13 +7,14 @@ if exists("b:current_syntax")
     finish
 endif
 
-syn keyword basicKeywords do and or if while switch try func bind ref begin end peek poke inc succ
+syn keyword basicKeywords do and or if while switch try func bind ref begin end peek poke inc succ pipeline par
 syn keyword biFunctions sqrt floor ceil round
 syn keyword biFunctions eq lt
 syn keyword biFunctions and or xor not
 syn keyword biFunctions push_front push_back cat length at slice
+syn keyword biFunctions pmap spawn yield make_chan chan_send chan_recv is_channel
 syn keyword biFunctions print format to_string parse parse_bool parse_char parse_int parse_real
-syn keyword biFunctions rand_ui rand_ur rand_ber rand_exp rand_gauss, rand_distr
+syn keyword biFunctions rand_ui rand_ur rand_ber rand_exp rand_gauss, rand_distr rand_ui_array rand_ur_array rand_ber_array rand_exp_array rand_gauss_array rand_seed rand_stream make_sampler rand_sample rand_samples
 syn keyword biFunctions is_bool is_int is_real is_char is_array is_tuple is_reference is_function
 syn keyword stdFunctions f_and f_or f_not
 syn keyword stdFunctions eq_cmp ne_cmp le_cmp gt_cmp ge_cmp ne gt ge le
@@ -9,6 +9,7 @@
 
 struct Runtime;
 
+typedef void (*bif_nullary_func)(struct Runtime *rt);
 typedef void (*bif_unary_func)(struct Runtime *rt, VAL_LOC_T x_loc);
 typedef void (*bif_binary_func)(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc);
 typedef void (*bif_ternary_func)(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc, VAL_LOC_T z_loc);
@@ -41,6 +42,60 @@ void bif_length(struct Runtime* rt, VAL_LOC_T x_loc);
 void bif_at(struct Runtime* rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc);
 void bif_slice(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc, VAL_LOC_T z_loc);
 
+/* Sorting */
+void bif_sort(struct Runtime *rt, VAL_LOC_T x_loc);
+void bif_sort_cmp(struct Runtime *rt, VAL_LOC_T cmp_loc, VAL_LOC_T x_loc);
+void bif_stable_sort(struct Runtime *rt, VAL_LOC_T cmp_loc, VAL_LOC_T x_loc);
+
+/* Functional */
+void bif_map(struct Runtime *rt, VAL_LOC_T f_loc, VAL_LOC_T x_loc);
+void bif_filter(struct Runtime *rt, VAL_LOC_T f_loc, VAL_LOC_T x_loc);
+void bif_foldl(struct Runtime *rt, VAL_LOC_T f_loc, VAL_LOC_T z_loc, VAL_LOC_T x_loc);
+void bif_foldr(struct Runtime *rt, VAL_LOC_T f_loc, VAL_LOC_T z_loc, VAL_LOC_T x_loc);
+void bif_zip(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc);
+void bif_zip_with(struct Runtime *rt, VAL_LOC_T f_loc, VAL_LOC_T x_loc, VAL_LOC_T y_loc);
+void bif_all_of(struct Runtime *rt, VAL_LOC_T f_loc, VAL_LOC_T first_loc, VAL_LOC_T last_loc);
+void bif_any_of(struct Runtime *rt, VAL_LOC_T f_loc, VAL_LOC_T first_loc, VAL_LOC_T last_loc);
+
+/* Parallel */
+void bif_pmap(struct Runtime *rt, VAL_LOC_T f_loc, VAL_LOC_T x_loc);
+
+/* Fiber */
+void bif_spawn(struct Runtime *rt, VAL_LOC_T f_loc);
+void bif_yield(struct Runtime *rt);
+void bif_make_chan(struct Runtime *rt, VAL_LOC_T n_loc);
+void bif_chan_send(struct Runtime *rt, VAL_LOC_T c_loc, VAL_LOC_T x_loc);
+void bif_chan_recv(struct Runtime *rt, VAL_LOC_T c_loc);
+
+/* Sequence */
+void bif_lazy(struct Runtime *rt, VAL_LOC_T x_loc);
+void bif_lazy_range(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc);
+void bif_lazy_gen(struct Runtime *rt, VAL_LOC_T f_loc, VAL_LOC_T x_loc);
+void bif_take(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc);
+void bif_collect(struct Runtime *rt, VAL_LOC_T x_loc);
+
+/* Dictionary */
+void bif_dict(struct Runtime *rt, VAL_LOC_T x_loc);
+void bif_dict_len(struct Runtime *rt, VAL_LOC_T x_loc);
+void bif_dict_keys(struct Runtime *rt, VAL_LOC_T x_loc);
+void bif_dict_has(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T k_loc);
+void bif_dict_get(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T k_loc);
+void bif_dict_put(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T k_loc, VAL_LOC_T v_loc);
+void bif_dict_remove(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T k_loc);
+
+/* Vector */
+void bif_vec_add(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc);
+void bif_vec_sub(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc);
+void bif_vec_mul(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc);
+void bif_vec_div(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc);
+void bif_vec_eq(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc);
+void bif_vec_lt(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc);
+void bif_vec_sum(struct Runtime *rt, VAL_LOC_T x_loc);
+void bif_vec_min(struct Runtime *rt, VAL_LOC_T x_loc);
+void bif_vec_max(struct Runtime *rt, VAL_LOC_T x_loc);
+void bif_vec_dot(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc);
+void bif_vec_scan(struct Runtime *rt, VAL_LOC_T x_loc);
+
 /* Random */
 void bif_rand_ui(struct Runtime *rt, VAL_LOC_T lo_loc, VAL_LOC_T hi_loc);
 void bif_rand_ur(struct Runtime *rt, VAL_LOC_T lo_loc, VAL_LOC_T hi_loc);
@@ -48,6 +103,16 @@ void bif_rand_ber(struct Runtime *rt, VAL_LOC_T p_loc);
 void bif_rand_exp(struct Runtime *rt, VAL_LOC_T l_loc);
 void bif_rand_gauss(struct Runtime *rt, VAL_LOC_T u_loc, VAL_LOC_T s_loc);
 void bif_rand_distr(struct Runtime *rt, VAL_LOC_T d_loc);
+void bif_rand_ui_array(struct Runtime *rt, VAL_LOC_T lo_loc, VAL_LOC_T hi_loc, VAL_LOC_T n_loc);
+void bif_rand_ur_array(struct Runtime *rt, VAL_LOC_T lo_loc, VAL_LOC_T hi_loc, VAL_LOC_T n_loc);
+void bif_rand_ber_array(struct Runtime *rt, VAL_LOC_T p_loc, VAL_LOC_T n_loc);
+void bif_rand_exp_array(struct Runtime *rt, VAL_LOC_T l_loc, VAL_LOC_T n_loc);
+void bif_rand_gauss_array(struct Runtime *rt, VAL_LOC_T u_loc, VAL_LOC_T s_loc, VAL_LOC_T n_loc);
+void bif_rand_seed(struct Runtime *rt, VAL_LOC_T s_loc);
+void bif_rand_stream(struct Runtime *rt, VAL_LOC_T s_loc, VAL_LOC_T n_loc);
+void bif_make_sampler(struct Runtime *rt, VAL_LOC_T d_loc);
+void bif_rand_sample(struct Runtime *rt, VAL_LOC_T s_loc);
+void bif_rand_samples(struct Runtime *rt, VAL_LOC_T s_loc, VAL_LOC_T n_loc);
 
 /* Text */
 void bif_print(struct Runtime *rt, VAL_LOC_T str_loc);
@@ -68,5 +133,9 @@ void bif_is_array(struct Runtime *rt, VAL_LOC_T x_loc);
 void bif_is_tuple(struct Runtime *rt, VAL_LOC_T x_loc);
 void bif_is_function(struct Runtime *rt, VAL_LOC_T x_loc);
 void bif_is_pointer(struct Runtime *rt, VAL_LOC_T x_loc);
+void bif_is_dict(struct Runtime *rt, VAL_LOC_T x_loc);
+void bif_is_seq(struct Runtime *rt, VAL_LOC_T x_loc);
+void bif_is_sampler(struct Runtime *rt, VAL_LOC_T x_loc);
+void bif_is_channel(struct Runtime *rt, VAL_LOC_T x_loc);
 
 #endif
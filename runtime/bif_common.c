@@ -93,3 +93,13 @@ enum BifBinaryMatch bif_match_bin(
     return BBM_MISMATCH;
 }
 
+
+bool bif_temp_owned(struct Runtime *rt, VAL_LOC_T loc)
+{
+    return rt->bif_call && rt->bif_call->temp_begin == loc;
+}
+
+void bif_temp_consume(struct Runtime *rt)
+{
+    rt->bif_call->temp_consumed = true;
+}
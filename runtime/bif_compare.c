@@ -10,7 +10,14 @@
 
 void bif_eq(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc)
 {
-    rt_val_push_bool(&rt->stack, rt_val_eq_bin(rt, x_loc, y_loc));
+    /* The dictionaries' layout depends on their history, not only on the
+     * contents, therefore they must be compared entry by entry, wherever
+     * they are nested. */
+    if (rt_val_has_dict(rt, x_loc) || rt_val_has_dict(rt, y_loc)) {
+        rt_val_push_bool(&rt->stack, rt_val_eq_rec(rt, x_loc, y_loc));
+    } else {
+        rt_val_push_bool(&rt->stack, rt_val_eq_bin(rt, x_loc, y_loc));
+    }
 }
 
 void bif_lt(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc)
@@ -1,5 +1,8 @@
 /* Copyright (C) 2014-2016 Krzysztof Stachowiak */
 
+#include <stdint.h>
+#include <string.h>
+
 #include "log.h"
 #include "eval.h"
 #include "collection.h"
@@ -25,6 +28,16 @@ static void bif_cpd_error_mismatch(char *func)
     err_push("BIF", "Arguments of _%s_ must be of matching types", func);
 }
 
+/** Checks whether a compound of the given data size may be formed. */
+static bool bif_cpd_check_size(int size, char *func)
+{
+    if (size > UINT16_MAX) {
+        err_push("BIF", "Result of _%s_ too large to form a compound", func);
+        return false;
+    }
+    return true;
+}
+
 void bif_push_front(struct Runtime* rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc)
 {
     int len, i;
@@ -38,6 +51,10 @@ void bif_push_front(struct Runtime* rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc)
         return;
     }
 
+    if (!bif_cpd_check_size(x_size + y_size + VAL_HEAD_BYTES, "push-front")) {
+        return;
+    }
+
     len = rt_val_cpd_len(rt, x_loc);
     x_elem_loc = rt_val_cpd_first_loc(x_loc);
 
@@ -62,9 +79,28 @@ void bif_push_front(struct Runtime* rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc)
     rt_val_push_cpd_final(&rt->stack, size_loc, x_size + y_size + VAL_HEAD_BYTES);
 }
 
+/**
+ * Checks whether the compound value is a temporary of the current call
+ * directly followed by the pushed value, which in turn ends at the stack top.
+ * In such case the compound may be extended to cover the pushed value
+ * without copying anything. Only the compounds built within the arguments,
+ * like in (push_back (push_back x 1) 2), qualify; the value of a symbol is
+ * copied upon evaluation, so accumulating through a function argument still
+ * copies the whole compound once per push.
+ */
+static bool bif_cpd_can_extend_in_place(
+        struct Runtime *rt,
+        VAL_LOC_T x_loc,
+        VAL_LOC_T y_loc)
+{
+    return bif_temp_owned(rt, x_loc) &&
+        rt_val_next_loc(rt, x_loc) == y_loc &&
+        rt_val_next_loc(rt, y_loc) == rt->stack.top;
+}
+
 void bif_push_back(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc)
 {
-    int len, i;
+    int len;
     VAL_LOC_T size_loc, x_elem_loc;
     enum ValueType x_type = rt_val_peek_type(&rt->stack, x_loc);
     VAL_SIZE_T x_size = rt_val_peek_size(&rt->stack, x_loc);
@@ -75,25 +111,37 @@ void bif_push_back(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc)
         return;
     }
 
+    if (!bif_cpd_check_size(x_size + y_size + VAL_HEAD_BYTES, "push-back")) {
+        return;
+    }
+
     x_elem_loc = rt_val_cpd_first_loc(x_loc);
     len = rt_val_cpd_len(rt, x_loc);
 
+    if (x_type == VAL_ARRAY && len > 0 && !rt_val_pair_homo(rt, x_elem_loc, y_loc)) {
+        bif_cpd_error_arg(1, "push-back",
+            "must be homogenous with the rest of the array");
+        return;
+    }
+
+    /* The pushed value already follows the compound, just take it in. */
+    if (bif_cpd_can_extend_in_place(rt, x_loc, y_loc)) {
+        rt_val_push_cpd_final(
+            &rt->stack,
+            x_loc + VAL_HEAD_TYPE_BYTES,
+            x_size + y_size + VAL_HEAD_BYTES);
+        bif_temp_consume(rt);
+        return;
+    }
+
     if (x_type == VAL_ARRAY) {
-        if (len > 0 && !rt_val_pair_homo(rt, x_elem_loc, y_loc)) {
-            bif_cpd_error_arg(1, "push-back",
-                "must be homogenous with the rest of the array");
-            return;
-        } else {
-            rt_val_push_array_init(&rt->stack, &size_loc);
-        }
+        rt_val_push_array_init(&rt->stack, &size_loc);
     } else {
         rt_val_push_tuple_init(&rt->stack, &size_loc);
     }
 
-    for (i = 0; i < len; ++i) {
-        rt_val_push_copy(&rt->stack, x_elem_loc);
-        x_elem_loc = rt_val_next_loc(rt, x_elem_loc);
-    }
+    /* The elements are contiguous, they are copied in one block. */
+    stack_push_copy(&rt->stack, x_elem_loc, x_size);
     rt_val_push_copy(&rt->stack, y_loc);
 
     rt_val_push_cpd_final(&rt->stack, size_loc, x_size + y_size + VAL_HEAD_BYTES);
@@ -121,6 +169,10 @@ void bif_cat(struct Runtime* rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc)
         return;
     }
 
+    if (!bif_cpd_check_size(x_size + y_size, "cat")) {
+        return;
+    }
+
     x_len = rt_val_cpd_len(rt, x_loc);
     y_len = rt_val_cpd_len(rt, y_loc);
     x_elem_loc = rt_val_cpd_first_loc(x_loc);
@@ -202,9 +254,8 @@ void bif_slice(
         VAL_LOC_T y_loc,
         VAL_LOC_T z_loc)
 {
-    VAL_INT_T first, last;
-    VAL_LOC_T size_loc, loc, end;
-    VAL_SIZE_T index = 0, size = 0;
+    VAL_INT_T first, last, index = 0;
+    VAL_LOC_T size_loc, loc, end, range_begin, range_end;
     enum ValueType x_type = rt_val_peek_type(&rt->stack, x_loc);
 
     /* Assert input. */
@@ -227,33 +278,53 @@ void bif_slice(
         bif_cpd_error_range("slice delimiters must be non-negative.");
         return;
     }
-
-    if (x_type == VAL_ARRAY) {
-        rt_val_push_array_init(&rt->stack, &size_loc);
-    } else {
-        rt_val_push_tuple_init(&rt->stack, &size_loc);
+    if (first > last) {
+        bif_cpd_error_range("slice end must be greater or equal slice begin.");
+        return;
     }
 
+    /* Find the contiguous range of the selected elements. */
     loc = rt_val_cpd_first_loc(x_loc);
     end = loc + rt_val_peek_size(&rt->stack, x_loc);
+    range_begin = range_end = end;
     while (loc != end) {
-        if (index >= first && index < last) {
-            rt_val_push_copy(&rt->stack, loc);
-            size += rt_val_peek_size(&rt->stack, loc) + VAL_HEAD_BYTES;
+        if (index == first) {
+            range_begin = loc;
+        }
+        if (index == last) {
+            range_end = loc;
         }
         loc = rt_val_next_loc(rt, loc);
         ++index;
     }
 
-    if (first > last) {
-        bif_cpd_error_range("slice end must be greater or equal slice begin.");
-        return;
-    }
     if (last > index) {
         bif_cpd_error_range("slice end must be within array bounds.");
         return;
     }
 
-    rt_val_push_cpd_final(&rt->stack, size_loc, size);
-}
+    /* A temporary compound may be trimmed to the range without a copy. */
+    if (bif_temp_owned(rt, x_loc)) {
+        VAL_LOC_T data_begin = rt_val_cpd_first_loc(x_loc);
+        memmove(
+            rt->stack.buffer + data_begin,
+            rt->stack.buffer + range_begin,
+            range_end - range_begin);
+        rt_val_push_cpd_final(
+            &rt->stack,
+            x_loc + VAL_HEAD_TYPE_BYTES,
+            range_end - range_begin);
+        rt->stack.top = data_begin + (range_end - range_begin);
+        bif_temp_consume(rt);
+        return;
+    }
 
+    if (x_type == VAL_ARRAY) {
+        rt_val_push_array_init(&rt->stack, &size_loc);
+    } else {
+        rt_val_push_tuple_init(&rt->stack, &size_loc);
+    }
+
+    stack_push_copy(&rt->stack, range_begin, range_end - range_begin);
+    rt_val_push_cpd_final(&rt->stack, size_loc, range_end - range_begin);
+}
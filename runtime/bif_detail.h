@@ -32,4 +32,34 @@ enum BifBinaryMatch bif_match_bin(
     VAL_REAL_T *rx, VAL_REAL_T *ry,
     VAL_CHAR_T *cx, VAL_CHAR_T *cy);
 
+/**
+ * Checks whether the value at the given location is the first temporary of
+ * the current BIF call, i.e. a value that nobody else refers to and which
+ * may therefore be turned into the result in place.
+ */
+bool bif_temp_owned(struct Runtime *rt, VAL_LOC_T loc);
+
+/**
+ * Declares that the temporaries of the current BIF call have been turned into
+ * the result value, which now spans from their beginning to the stack top.
+ */
+void bif_temp_consume(struct Runtime *rt);
+
+/** Pushes a lazy sequence of the given kind with copies of the parameters. */
+void bif_push_seq(
+    struct Runtime *rt,
+    enum ValueSeqKind kind,
+    VAL_LOC_T *param_locs,
+    int param_count);
+
+/**
+ * Pushes all the elements of a sequence or of a compound as a compound of
+ * the given type. An array is checked for homogenity.
+ */
+bool bif_push_seq_elements(
+    struct Runtime *rt,
+    VAL_LOC_T seq_loc,
+    enum ValueType type,
+    char *func);
+
 #endif
@@ -0,0 +1,257 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#include "bif.h"
+#include "bif_detail.h"
+#include "error.h"
+#include "rt_val.h"
+#include "runtime.h"
+#include "stack.h"
+
+static void bif_dict_error_arg(int arg, char *func, char *condition)
+{
+    err_push("BIF", "Argument %d of _%s_ %s", arg, func, condition);
+}
+
+static void bif_dict_error_size(char *func)
+{
+    err_push("BIF", "Dictionary too large to be stored in _%s_", func);
+}
+
+static bool bif_dict_check_args(
+        struct Runtime *rt,
+        VAL_LOC_T x_loc,
+        VAL_LOC_T k_loc,
+        char *func)
+{
+    if (rt_val_peek_type(&rt->stack, x_loc) != VAL_DICT) {
+        bif_dict_error_arg(1, func, "must be a dictionary");
+        return false;
+    }
+
+    if (k_loc != -1 && !rt_val_is_hashable(rt, k_loc)) {
+        bif_dict_error_arg(2, func, "must be hashable");
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Checks whether the dictionary is a temporary of the current call directly
+ * followed by the inserted key and value, which end at the stack top, and
+ * whether its index has room for one more entry. In such case the key and
+ * the value may become the new entry without being copied.
+ */
+static bool bif_dict_can_extend_in_place(
+        struct Runtime *rt,
+        VAL_LOC_T x_loc,
+        VAL_LOC_T k_loc,
+        VAL_LOC_T v_loc)
+{
+    int len = rt_val_dict_len(&rt->stack, x_loc);
+    return bif_temp_owned(rt, x_loc) &&
+        rt_val_next_loc(rt, x_loc) == k_loc &&
+        rt_val_next_loc(rt, k_loc) == v_loc &&
+        rt_val_next_loc(rt, v_loc) == rt->stack.top &&
+        2 * (len + 1) <= rt_val_dict_cap(&rt->stack, x_loc);
+}
+
+void bif_dict(struct Runtime *rt, VAL_LOC_T x_loc)
+{
+    int i, len;
+    VAL_LOC_T dict_loc, elem_loc, key_loc;
+    enum ValueType x_type = rt_val_peek_type(&rt->stack, x_loc);
+
+    if (x_type != VAL_ARRAY && x_type != VAL_TUPLE) {
+        bif_dict_error_arg(1, "dict", "must be compound");
+        return;
+    }
+
+    len = rt_val_cpd_len(rt, x_loc);
+    elem_loc = rt_val_cpd_first_loc(x_loc);
+
+    rt_val_push_dict_init(
+        &rt->stack,
+        rt_val_dict_capacity_for(len),
+        &dict_loc);
+
+    for (i = 0; i < len; ++i) {
+        if (rt_val_peek_type(&rt->stack, elem_loc) != VAL_TUPLE ||
+            rt_val_cpd_len(rt, elem_loc) != 2) {
+            bif_dict_error_arg(1, "dict", "must only contain pairs");
+            return;
+        }
+
+        key_loc = rt_val_cpd_first_loc(elem_loc);
+        if (!rt_val_is_hashable(rt, key_loc)) {
+            bif_dict_error_arg(1, "dict", "must only contain hashable keys");
+            return;
+        }
+
+        if (rt_val_dict_find(&rt->stack, dict_loc, key_loc) != -1) {
+            bif_dict_error_arg(1, "dict", "must only contain unique keys");
+            return;
+        }
+
+        if (!rt_val_push_dict_entry(
+                &rt->stack,
+                dict_loc,
+                key_loc,
+                rt_val_next_loc(rt, key_loc))) {
+            bif_dict_error_size("dict");
+            return;
+        }
+
+        elem_loc = rt_val_next_loc(rt, elem_loc);
+    }
+}
+
+void bif_dict_len(struct Runtime *rt, VAL_LOC_T x_loc)
+{
+    if (!bif_dict_check_args(rt, x_loc, -1, "dict_len")) {
+        return;
+    }
+
+    rt_val_push_int(&rt->stack, rt_val_dict_len(&rt->stack, x_loc));
+}
+
+void bif_dict_keys(struct Runtime *rt, VAL_LOC_T x_loc)
+{
+    int i, len;
+    VAL_LOC_T size_loc, data_begin, key_loc, first_key_loc;
+
+    if (!bif_dict_check_args(rt, x_loc, -1, "dict_keys")) {
+        return;
+    }
+
+    len = rt_val_dict_len(&rt->stack, x_loc);
+    key_loc = first_key_loc = rt_val_dict_first_loc(&rt->stack, x_loc);
+
+    for (i = 0; i < len; ++i) {
+        if (!rt_val_pair_homo(rt, first_key_loc, key_loc)) {
+            err_push("BIF", "Keys of _dict_keys_ argument must be homogenous");
+            return;
+        }
+        key_loc = rt_val_next_loc(rt, rt_val_next_loc(rt, key_loc));
+    }
+
+    rt_val_push_array_init(&rt->stack, &size_loc);
+    data_begin = rt->stack.top;
+
+    key_loc = first_key_loc;
+    for (i = 0; i < len; ++i) {
+        rt_val_push_copy(&rt->stack, key_loc);
+        key_loc = rt_val_next_loc(rt, rt_val_next_loc(rt, key_loc));
+    }
+
+    rt_val_push_cpd_final(&rt->stack, size_loc, rt->stack.top - data_begin);
+}
+
+void bif_dict_has(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T k_loc)
+{
+    if (!bif_dict_check_args(rt, x_loc, k_loc, "dict_has")) {
+        return;
+    }
+
+    rt_val_push_bool(
+        &rt->stack,
+        rt_val_dict_find(&rt->stack, x_loc, k_loc) != -1);
+}
+
+void bif_dict_get(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T k_loc)
+{
+    VAL_LOC_T found;
+
+    if (!bif_dict_check_args(rt, x_loc, k_loc, "dict_get")) {
+        return;
+    }
+
+    found = rt_val_dict_find(&rt->stack, x_loc, k_loc);
+    if (found == -1) {
+        err_push("BIF", "Key not found in _dict_get_");
+        return;
+    }
+
+    rt_val_push_copy(&rt->stack, rt_val_next_loc(rt, found));
+}
+
+void bif_dict_put(
+        struct Runtime *rt,
+        VAL_LOC_T x_loc,
+        VAL_LOC_T k_loc,
+        VAL_LOC_T v_loc)
+{
+    int i, len;
+    VAL_LOC_T found, dict_loc, key_loc, value_loc;
+
+    if (!bif_dict_check_args(rt, x_loc, k_loc, "dict_put")) {
+        return;
+    }
+
+    found = rt_val_dict_find(&rt->stack, x_loc, k_loc);
+    len = rt_val_dict_len(&rt->stack, x_loc);
+
+    /* The new entry already follows the dictionary, just take it in. */
+    if (found == -1 && bif_dict_can_extend_in_place(rt, x_loc, k_loc, v_loc)) {
+        if (!rt_val_dict_adopt_entry(&rt->stack, x_loc, k_loc)) {
+            bif_dict_error_size("dict_put");
+            return;
+        }
+        bif_temp_consume(rt);
+        return;
+    }
+
+    rt_val_push_dict_init(
+        &rt->stack,
+        rt_val_dict_capacity_for(found == -1 ? len + 1 : len),
+        &dict_loc);
+
+    key_loc = rt_val_dict_first_loc(&rt->stack, x_loc);
+    for (i = 0; i < len; ++i) {
+        value_loc = rt_val_next_loc(rt, key_loc);
+        if (!rt_val_push_dict_entry(
+                &rt->stack,
+                dict_loc,
+                key_loc,
+                key_loc == found ? v_loc : value_loc)) {
+            bif_dict_error_size("dict_put");
+            return;
+        }
+        key_loc = rt_val_next_loc(rt, value_loc);
+    }
+
+    if (found == -1 && !rt_val_push_dict_entry(&rt->stack, dict_loc, k_loc, v_loc)) {
+        bif_dict_error_size("dict_put");
+    }
+}
+
+void bif_dict_remove(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T k_loc)
+{
+    int i, len;
+    VAL_LOC_T found, dict_loc, key_loc, value_loc;
+
+    if (!bif_dict_check_args(rt, x_loc, k_loc, "dict_remove")) {
+        return;
+    }
+
+    found = rt_val_dict_find(&rt->stack, x_loc, k_loc);
+    if (found == -1) {
+        rt_val_push_copy(&rt->stack, x_loc);
+        return;
+    }
+
+    len = rt_val_dict_len(&rt->stack, x_loc);
+    rt_val_push_dict_init(
+        &rt->stack,
+        rt_val_dict_capacity_for(len - 1),
+        &dict_loc);
+
+    key_loc = rt_val_dict_first_loc(&rt->stack, x_loc);
+    for (i = 0; i < len; ++i) {
+        value_loc = rt_val_next_loc(rt, key_loc);
+        if (key_loc != found) {
+            rt_val_push_dict_entry(&rt->stack, dict_loc, key_loc, value_loc);
+        }
+        key_loc = rt_val_next_loc(rt, value_loc);
+    }
+}
@@ -0,0 +1,126 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#include "bif.h"
+#include "bif_detail.h"
+#include "error.h"
+#include "fiber.h"
+#include "rt_val.h"
+#include "runtime.h"
+#include "stack.h"
+
+/*
+ * The fiber BIFs only check their arguments, the scheduling is implemented
+ * in fiber.c. The workers of the parallel calls have no fibers, since they
+ * may not switch to the fibers of the calling runtime.
+ */
+
+static void bif_fiber_error_arg(int arg, char *func, char *condition)
+{
+    err_push("BIF", "Argument %d of _%s_ %s", arg, func, condition);
+}
+
+static bool bif_fiber_check_sched(struct Runtime *rt, char *func)
+{
+    if (!rt->sched) {
+        err_push("BIF", "_%s_ may not be called within _pmap_ or _par_", func);
+        return false;
+    }
+    return true;
+}
+
+static bool bif_fiber_check_chan(struct Runtime *rt, VAL_LOC_T c_loc, char *func)
+{
+    if (!bif_fiber_check_sched(rt, func)) {
+        return false;
+    }
+    if (rt_val_peek_type(&rt->stack, c_loc) != VAL_CHANNEL) {
+        bif_fiber_error_arg(1, func, "must be channel");
+        return false;
+    }
+    return true;
+}
+
+void bif_spawn(struct Runtime *rt, VAL_LOC_T f_loc)
+{
+    struct ValueFuncData func_data;
+
+    if (!bif_fiber_check_sched(rt, "spawn")) {
+        return;
+    }
+
+    if (rt_val_peek_type(&rt->stack, f_loc) != VAL_FUNCTION) {
+        bif_fiber_error_arg(1, "spawn", "must be function");
+        return;
+    }
+
+    func_data = rt_val_function_data(rt, f_loc);
+    if (func_data.arity != func_data.appl_count) {
+        bif_fiber_error_arg(1, "spawn", "must be a function of no arguments");
+        return;
+    }
+
+    fiber_spawn(rt, f_loc, rt->bif_call->sym_map);
+    rt_val_push_unit(&rt->stack);
+}
+
+void bif_yield(struct Runtime *rt)
+{
+    if (!bif_fiber_check_sched(rt, "yield")) {
+        return;
+    }
+
+    if (!fiber_yield(rt)) {
+        err_push("BIF", "Failed yielding to the other fibers");
+        return;
+    }
+
+    rt_val_push_unit(&rt->stack);
+}
+
+void bif_make_chan(struct Runtime *rt, VAL_LOC_T n_loc)
+{
+    if (!bif_fiber_check_sched(rt, "make_chan")) {
+        return;
+    }
+
+    if (rt_val_peek_type(&rt->stack, n_loc) != VAL_INT ||
+        rt_val_peek_int(rt, n_loc) <= 0 ||
+        rt_val_peek_int(rt, n_loc) > UINT16_MAX) {
+        bif_fiber_error_arg(1, "make_chan", "must be an integer between 1 and 65535");
+        return;
+    }
+
+    fiber_chan_make(rt, rt_val_peek_int(rt, n_loc));
+}
+
+void bif_chan_send(struct Runtime *rt, VAL_LOC_T c_loc, VAL_LOC_T x_loc)
+{
+    if (!bif_fiber_check_chan(rt, c_loc, "chan_send")) {
+        return;
+    }
+
+    /* The message is copied byte for byte, a reference anywhere within it
+     * would point into the stack of the sender. */
+    if (rt_val_has_ptr(rt, x_loc)) {
+        bif_fiber_error_arg(2, "chan_send", "must not be or contain a reference");
+        return;
+    }
+
+    if (!fiber_chan_send(rt, c_loc, x_loc)) {
+        err_push("BIF", "Failed sending a value in _chan_send_");
+        return;
+    }
+
+    rt_val_push_unit(&rt->stack);
+}
+
+void bif_chan_recv(struct Runtime *rt, VAL_LOC_T c_loc)
+{
+    if (!bif_fiber_check_chan(rt, c_loc, "chan_recv")) {
+        return;
+    }
+
+    if (!fiber_chan_recv(rt, c_loc)) {
+        err_push("BIF", "Failed receiving a value in _chan_recv_");
+    }
+}
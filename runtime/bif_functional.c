@@ -0,0 +1,543 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "bif.h"
+#include "bif_detail.h"
+#include "error.h"
+#include "eval.h"
+#include "memory.h"
+#include "rt_val.h"
+#include "runtime.h"
+#include "stack.h"
+
+/*
+ * The functional BIFs call back the function values passed to them. The
+ * result of each call lands on the stack top, which is exactly where the
+ * next element of the output compound belongs, therefore the results are
+ * never copied once computed.
+ */
+
+static void bif_func_error_arg(int arg, char *func, char *condition)
+{
+    err_push("BIF", "Argument %d of _%s_ %s", arg, func, condition);
+}
+
+static bool bif_func_is_cpd(struct Runtime *rt, VAL_LOC_T loc)
+{
+    enum ValueType type = rt_val_peek_type(&rt->stack, loc);
+    return type == VAL_ARRAY || type == VAL_TUPLE;
+}
+
+static bool bif_func_is_source(struct Runtime *rt, VAL_LOC_T loc)
+{
+    return bif_func_is_cpd(rt, loc) ||
+        rt_val_peek_type(&rt->stack, loc) == VAL_SEQ;
+}
+
+static void bif_func_push_cpd_init(
+        struct Runtime *rt,
+        enum ValueType type,
+        VAL_LOC_T *size_loc)
+{
+    if (type == VAL_ARRAY) {
+        rt_val_push_array_init(&rt->stack, size_loc);
+    } else {
+        rt_val_push_tuple_init(&rt->stack, size_loc);
+    }
+}
+
+/**
+ * Pushes a lazy sequence in place of the result if any of the sources is a
+ * sequence. Returns false if the arguments must be processed eagerly.
+ */
+static bool bif_func_push_lazy(
+        struct Runtime *rt,
+        enum ValueSeqKind kind,
+        VAL_LOC_T *param_locs,
+        int param_count,
+        char *func)
+{
+    int i, first_source = kind == VAL_SEQ_ZIP ? 0 : 1;
+    bool lazy = false;
+
+    for (i = first_source; i < param_count; ++i) {
+        if (rt_val_peek_type(&rt->stack, param_locs[i]) == VAL_SEQ) {
+            lazy = true;
+        }
+    }
+
+    if (!lazy) {
+        return false;
+    }
+
+    if (first_source == 1 &&
+        rt_val_peek_type(&rt->stack, param_locs[0]) != VAL_FUNCTION) {
+        bif_func_error_arg(1, func, "must be function");
+        return true;
+    }
+
+    for (i = first_source; i < param_count; ++i) {
+        if (!bif_func_is_source(rt, param_locs[i])) {
+            bif_func_error_arg(i + 1, func, "must be compound or sequence");
+            return true;
+        }
+    }
+
+    bif_push_seq(rt, kind, param_locs, param_count);
+    return true;
+}
+
+static bool bif_func_call_init(
+        struct Runtime *rt,
+        struct EvalCall *call,
+        VAL_LOC_T f_loc,
+        int arg_count,
+        char *func)
+{
+    if (!eval_call_init(
+            call, rt,
+            rt->bif_call->sym_map,
+            rt->bif_call->alm,
+            f_loc, arg_count)) {
+        err_push("BIF", "Argument 1 of _%s_ must be a function of %d argument(s)",
+            func, arg_count);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Calls the function and checks for errors. The result is left on the
+ * stack top.
+ */
+static bool bif_func_call(
+        struct EvalCall *call,
+        VAL_LOC_T *arg_locs,
+        VAL_LOC_T *result_loc,
+        char *func)
+{
+    *result_loc = eval_call(call, arg_locs);
+    if (err_state()) {
+        err_push("BIF", "Function call failed in _%s_", func);
+        return false;
+    }
+    return true;
+}
+
+/** Calls a predicate, the stack is cleaned up after the call. */
+static bool bif_func_call_pred(
+        struct EvalCall *call,
+        VAL_LOC_T *arg_locs,
+        bool *result,
+        char *func)
+{
+    struct Runtime *rt = call->rt;
+    VAL_LOC_T top = rt->stack.top, result_loc;
+
+    if (!bif_func_call(call, arg_locs, &result_loc, func)) {
+        return false;
+    }
+
+    if (rt_val_peek_type(&rt->stack, result_loc) != VAL_BOOL) {
+        err_push("BIF", "Predicate passed to _%s_ must return a boolean value", func);
+        return false;
+    }
+
+    *result = rt_val_peek_bool(rt, result_loc);
+    rt->stack.top = top;
+    return true;
+}
+
+/** Checks that a new element of an array matches the first one. */
+static bool bif_func_check_homo(
+        struct Runtime *rt,
+        VAL_LOC_T first_loc,
+        VAL_LOC_T elem_loc,
+        char *func)
+{
+    if (first_loc != elem_loc && !rt_val_pair_homo(rt, first_loc, elem_loc)) {
+        err_push("BIF", "Results of _%s_ must be homogenous to form an array", func);
+        return false;
+    }
+    return true;
+}
+
+/** Checks that the elements pushed so far still fit in a compound. */
+static bool bif_func_check_size(
+        struct Runtime *rt,
+        VAL_LOC_T data_begin,
+        char *func)
+{
+    if (rt->stack.top - data_begin > UINT16_MAX) {
+        err_push("BIF", "Results of _%s_ too large to form a compound", func);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Folds a value just returned by a call into the accumulator slot, so that
+ * the stack does not grow with each iteration.
+ */
+static void bif_func_store_acc(
+        struct Runtime *rt,
+        VAL_LOC_T acc_loc,
+        VAL_LOC_T result_loc)
+{
+    VAL_LOC_T size = rt->stack.top - result_loc;
+    memmove(rt->stack.buffer + acc_loc, rt->stack.buffer + result_loc, size);
+    rt->stack.top = acc_loc + size;
+}
+
+void bif_map(struct Runtime *rt, VAL_LOC_T f_loc, VAL_LOC_T x_loc)
+{
+    int i, len;
+    VAL_LOC_T size_loc, data_begin, elem_loc, result_loc;
+    enum ValueType x_type = rt_val_peek_type(&rt->stack, x_loc);
+    VAL_LOC_T param_locs[] = { f_loc, x_loc };
+    struct EvalCall call;
+
+    if (bif_func_push_lazy(rt, VAL_SEQ_MAP, param_locs, 2, "map")) {
+        return;
+    }
+
+    if (!bif_func_is_cpd(rt, x_loc)) {
+        bif_func_error_arg(2, "map", "must be compound or sequence");
+        return;
+    }
+
+    if (!bif_func_call_init(rt, &call, f_loc, 1, "map")) {
+        return;
+    }
+
+    len = rt_val_cpd_len(rt, x_loc);
+    elem_loc = rt_val_cpd_first_loc(x_loc);
+
+    bif_func_push_cpd_init(rt, x_type, &size_loc);
+    data_begin = rt->stack.top;
+
+    for (i = 0; i < len; ++i) {
+        if (!bif_func_call(&call, &elem_loc, &result_loc, "map") ||
+            !bif_func_check_size(rt, data_begin, "map") ||
+            (x_type == VAL_ARRAY &&
+             !bif_func_check_homo(rt, data_begin, result_loc, "map"))) {
+            goto cleanup;
+        }
+        elem_loc = rt_val_next_loc(rt, elem_loc);
+    }
+
+    rt_val_push_cpd_final(&rt->stack, size_loc, rt->stack.top - data_begin);
+
+cleanup:
+    eval_call_deinit(&call);
+}
+
+void bif_filter(struct Runtime *rt, VAL_LOC_T f_loc, VAL_LOC_T x_loc)
+{
+    int i, len;
+    bool keep;
+    VAL_LOC_T size_loc, data_begin, elem_loc;
+    VAL_LOC_T param_locs[] = { f_loc, x_loc };
+    struct EvalCall call;
+
+    if (bif_func_push_lazy(rt, VAL_SEQ_FILTER, param_locs, 2, "filter")) {
+        return;
+    }
+
+    if (!bif_func_is_cpd(rt, x_loc)) {
+        bif_func_error_arg(2, "filter", "must be compound or sequence");
+        return;
+    }
+
+    if (!bif_func_call_init(rt, &call, f_loc, 1, "filter")) {
+        return;
+    }
+
+    len = rt_val_cpd_len(rt, x_loc);
+    elem_loc = rt_val_cpd_first_loc(x_loc);
+
+    bif_func_push_cpd_init(rt, rt_val_peek_type(&rt->stack, x_loc), &size_loc);
+    data_begin = rt->stack.top;
+
+    for (i = 0; i < len; ++i) {
+        if (!bif_func_call_pred(&call, &elem_loc, &keep, "filter")) {
+            goto cleanup;
+        }
+        if (keep) {
+            rt_val_push_copy(&rt->stack, elem_loc);
+        }
+        elem_loc = rt_val_next_loc(rt, elem_loc);
+    }
+
+    rt_val_push_cpd_final(&rt->stack, size_loc, rt->stack.top - data_begin);
+
+cleanup:
+    eval_call_deinit(&call);
+}
+
+void bif_foldl(struct Runtime *rt, VAL_LOC_T f_loc, VAL_LOC_T z_loc, VAL_LOC_T x_loc)
+{
+    VAL_LOC_T acc_loc, elem_loc, result_loc, arg_locs[2];
+    struct EvalCall call;
+    struct EvalSeq seq;
+
+    if (!bif_func_is_source(rt, x_loc)) {
+        bif_func_error_arg(3, "foldl", "must be compound or sequence");
+        return;
+    }
+
+    if (!bif_func_call_init(rt, &call, f_loc, 2, "foldl")) {
+        return;
+    }
+
+    if (!eval_seq_init(
+            &seq, rt,
+            rt->bif_call->sym_map,
+            rt->bif_call->alm,
+            x_loc)) {
+        eval_call_deinit(&call);
+        return;
+    }
+
+    acc_loc = rt->stack.top;
+    rt_val_push_copy(&rt->stack, z_loc);
+
+    /* The elements of a sequence are generated one at a time, above the
+     * accumulator, and discarded once folded into it. */
+    while (eval_seq_next(&seq, &elem_loc)) {
+        arg_locs[0] = acc_loc;
+        arg_locs[1] = elem_loc;
+        if (!bif_func_call(&call, arg_locs, &result_loc, "foldl")) {
+            goto cleanup;
+        }
+        bif_func_store_acc(rt, acc_loc, result_loc);
+    }
+
+    if (err_state()) {
+        err_push("BIF", "Failed iterating over a sequence in _foldl_");
+    }
+
+cleanup:
+    eval_seq_deinit(&seq);
+    eval_call_deinit(&call);
+}
+
+void bif_foldr(struct Runtime *rt, VAL_LOC_T f_loc, VAL_LOC_T z_loc, VAL_LOC_T x_loc)
+{
+    int i, len;
+    VAL_LOC_T acc_loc, elem_loc, result_loc, arg_locs[2], *elem_locs;
+    VAL_LOC_T result_begin = rt->stack.top;
+    struct EvalCall call;
+
+    if (!bif_func_is_source(rt, x_loc)) {
+        bif_func_error_arg(3, "foldr", "must be compound or sequence");
+        return;
+    }
+
+    /* Folding from the right requires all the elements at once, a sequence
+     * is therefore collected first and the result moved over it at last. */
+    if (rt_val_peek_type(&rt->stack, x_loc) == VAL_SEQ) {
+        if (!bif_push_seq_elements(rt, x_loc, VAL_TUPLE, "foldr")) {
+            return;
+        }
+        x_loc = result_begin;
+    }
+
+    if (!bif_func_call_init(rt, &call, f_loc, 2, "foldr")) {
+        return;
+    }
+
+    len = rt_val_cpd_len(rt, x_loc);
+    elem_locs = mem_malloc((len + 1) * sizeof(*elem_locs));
+    elem_loc = rt_val_cpd_first_loc(x_loc);
+    for (i = 0; i < len; ++i) {
+        elem_locs[i] = elem_loc;
+        elem_loc = rt_val_next_loc(rt, elem_loc);
+    }
+
+    acc_loc = rt->stack.top;
+    rt_val_push_copy(&rt->stack, z_loc);
+
+    for (i = len - 1; i >= 0; --i) {
+        arg_locs[0] = elem_locs[i];
+        arg_locs[1] = acc_loc;
+        if (!bif_func_call(&call, arg_locs, &result_loc, "foldr")) {
+            goto cleanup;
+        }
+        bif_func_store_acc(rt, acc_loc, result_loc);
+    }
+
+    if (acc_loc != result_begin) {
+        bif_func_store_acc(rt, result_begin, acc_loc);
+    }
+
+cleanup:
+    mem_free(elem_locs);
+    eval_call_deinit(&call);
+}
+
+void bif_zip(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc)
+{
+    int i, len, x_len, y_len;
+    VAL_LOC_T size_loc, data_begin, x_elem_loc, y_elem_loc;
+    VAL_LOC_T pair_size_loc, pair_loc;
+    VAL_LOC_T param_locs[] = { x_loc, y_loc };
+
+    if (bif_func_push_lazy(rt, VAL_SEQ_ZIP, param_locs, 2, "zip")) {
+        return;
+    }
+
+    if (!bif_func_is_cpd(rt, x_loc)) {
+        bif_func_error_arg(1, "zip", "must be compound or sequence");
+        return;
+    }
+
+    if (!bif_func_is_cpd(rt, y_loc)) {
+        bif_func_error_arg(2, "zip", "must be compound or sequence");
+        return;
+    }
+
+    x_len = rt_val_cpd_len(rt, x_loc);
+    y_len = rt_val_cpd_len(rt, y_loc);
+    len = x_len < y_len ? x_len : y_len;
+    x_elem_loc = rt_val_cpd_first_loc(x_loc);
+    y_elem_loc = rt_val_cpd_first_loc(y_loc);
+
+    rt_val_push_array_init(&rt->stack, &size_loc);
+    data_begin = rt->stack.top;
+
+    for (i = 0; i < len; ++i) {
+        pair_loc = rt->stack.top;
+        rt_val_push_tuple_init(&rt->stack, &pair_size_loc);
+        rt_val_push_copy(&rt->stack, x_elem_loc);
+        rt_val_push_copy(&rt->stack, y_elem_loc);
+        rt_val_push_cpd_final(
+            &rt->stack,
+            pair_size_loc,
+            rt->stack.top - pair_loc - VAL_HEAD_BYTES);
+
+        if (!bif_func_check_size(rt, data_begin, "zip") ||
+            !bif_func_check_homo(rt, data_begin, pair_loc, "zip")) {
+            return;
+        }
+
+        x_elem_loc = rt_val_next_loc(rt, x_elem_loc);
+        y_elem_loc = rt_val_next_loc(rt, y_elem_loc);
+    }
+
+    rt_val_push_cpd_final(&rt->stack, size_loc, rt->stack.top - data_begin);
+}
+
+void bif_zip_with(struct Runtime *rt, VAL_LOC_T f_loc, VAL_LOC_T x_loc, VAL_LOC_T y_loc)
+{
+    int i, len, x_len, y_len;
+    VAL_LOC_T size_loc, data_begin, result_loc, arg_locs[2];
+    enum ValueType x_type = rt_val_peek_type(&rt->stack, x_loc);
+    VAL_LOC_T param_locs[] = { f_loc, x_loc, y_loc };
+    struct EvalCall call;
+
+    if (bif_func_push_lazy(rt, VAL_SEQ_ZIP_WITH, param_locs, 3, "zip_with")) {
+        return;
+    }
+
+    if (!bif_func_is_cpd(rt, x_loc)) {
+        bif_func_error_arg(2, "zip_with", "must be compound or sequence");
+        return;
+    }
+
+    if (!bif_func_is_cpd(rt, y_loc)) {
+        bif_func_error_arg(3, "zip_with", "must be compound or sequence");
+        return;
+    }
+
+    if (!bif_func_call_init(rt, &call, f_loc, 2, "zip_with")) {
+        return;
+    }
+
+    x_len = rt_val_cpd_len(rt, x_loc);
+    y_len = rt_val_cpd_len(rt, y_loc);
+    len = x_len < y_len ? x_len : y_len;
+    arg_locs[0] = rt_val_cpd_first_loc(x_loc);
+    arg_locs[1] = rt_val_cpd_first_loc(y_loc);
+
+    bif_func_push_cpd_init(rt, x_type, &size_loc);
+    data_begin = rt->stack.top;
+
+    for (i = 0; i < len; ++i) {
+        if (!bif_func_call(&call, arg_locs, &result_loc, "zip_with") ||
+            !bif_func_check_size(rt, data_begin, "zip_with") ||
+            (x_type == VAL_ARRAY &&
+             !bif_func_check_homo(rt, data_begin, result_loc, "zip_with"))) {
+            goto cleanup;
+        }
+        arg_locs[0] = rt_val_next_loc(rt, arg_locs[0]);
+        arg_locs[1] = rt_val_next_loc(rt, arg_locs[1]);
+    }
+
+    rt_val_push_cpd_final(&rt->stack, size_loc, rt->stack.top - data_begin);
+
+cleanup:
+    eval_call_deinit(&call);
+}
+
+/**
+ * Checks whether any of the elements in the range given by the two pointers
+ * yields the expected predicate result.
+ */
+static void bif_func_find_pred(
+        struct Runtime *rt,
+        VAL_LOC_T f_loc,
+        VAL_LOC_T first_loc,
+        VAL_LOC_T last_loc,
+        bool expected,
+        char *func)
+{
+    bool result, found = false;
+    VAL_LOC_T elem_loc, end_loc;
+    struct EvalCall call;
+
+    if (rt_val_peek_type(&rt->stack, first_loc) != VAL_PTR) {
+        bif_func_error_arg(2, func, "must be a reference");
+        return;
+    }
+
+    if (rt_val_peek_type(&rt->stack, last_loc) != VAL_PTR) {
+        bif_func_error_arg(3, func, "must be a reference");
+        return;
+    }
+
+    if (!bif_func_call_init(rt, &call, f_loc, 1, func)) {
+        return;
+    }
+
+    elem_loc = rt_val_peek_ptr(rt, first_loc);
+    end_loc = rt_val_peek_ptr(rt, last_loc);
+
+    while (elem_loc != end_loc) {
+        if (!bif_func_call_pred(&call, &elem_loc, &result, func)) {
+            goto cleanup;
+        }
+        if (result == expected) {
+            found = true;
+            break;
+        }
+        elem_loc = rt_val_next_loc(rt, elem_loc);
+    }
+
+    rt_val_push_bool(&rt->stack, expected ? found : !found);
+
+cleanup:
+    eval_call_deinit(&call);
+}
+
+void bif_all_of(struct Runtime *rt, VAL_LOC_T f_loc, VAL_LOC_T first_loc, VAL_LOC_T last_loc)
+{
+    bif_func_find_pred(rt, f_loc, first_loc, last_loc, false, "all_of");
+}
+
+void bif_any_of(struct Runtime *rt, VAL_LOC_T f_loc, VAL_LOC_T first_loc, VAL_LOC_T last_loc)
+{
+    bif_func_find_pred(rt, f_loc, first_loc, last_loc, true, "any_of");
+}
@@ -0,0 +1,211 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "bif.h"
+#include "bif_detail.h"
+#include "error.h"
+#include "eval.h"
+#include "memory.h"
+#include "rt_val.h"
+#include "runtime.h"
+#include "stack.h"
+
+/*
+ * The parallel map splits the compound into one chunk per thread. Each chunk
+ * is mapped by a worker runtime holding a copy of the stack of the calling
+ * one, so that the function, its captures and the elements are found at the
+ * same locations, while the scopes of the call site are shared read only.
+ * The results of the chunks are then gathered in order on the calling stack.
+ */
+
+struct PmapChunk {
+    struct Runtime *rt;
+    struct SymMap *sym_map;
+    struct AstLocMap *alm;
+    VAL_LOC_T f_loc;
+    VAL_LOC_T first_loc;
+    int len;
+    bool homo;
+    uint64_t seed;
+
+    struct Runtime *worker;
+    VAL_LOC_T data_begin;
+    struct ErrFrame *errors;
+};
+
+static void bif_par_error_arg(int arg, char *func, char *condition)
+{
+    err_push("BIF", "Argument %d of _%s_ %s", arg, func, condition);
+}
+
+/** Maps the chunk, pushing the results onto the stack of the given runtime. */
+static bool bif_pmap_eval(struct Runtime *rt, struct PmapChunk *chunk)
+{
+    int i;
+    bool result = false;
+    VAL_LOC_T elem_loc = chunk->first_loc, result_loc;
+    VAL_LOC_T data_begin = rt->stack.top;
+    struct EvalCall call;
+
+    if (!eval_call_init(&call, rt, chunk->sym_map, chunk->alm, chunk->f_loc, 1)) {
+        err_push("BIF", "Argument 1 of _pmap_ must be a function of 1 argument(s)");
+        return false;
+    }
+
+    for (i = 0; i < chunk->len; ++i) {
+        result_loc = eval_call(&call, &elem_loc);
+        if (err_state()) {
+            err_push("BIF", "Function call failed in _pmap_");
+            goto cleanup;
+        }
+        if (chunk->homo &&
+            result_loc != data_begin &&
+            !rt_val_pair_homo(rt, data_begin, result_loc)) {
+            err_push("BIF", "Results of _pmap_ must be homogenous to form an array");
+            goto cleanup;
+        }
+        elem_loc = rt_val_next_loc(rt, elem_loc);
+    }
+
+    result = true;
+
+cleanup:
+    eval_call_deinit(&call);
+    return result;
+}
+
+static void bif_pmap_task(void *data, int index)
+{
+    struct PmapChunk *chunk = (struct PmapChunk*)data + index;
+
+    chunk->worker = rt_make_worker(chunk->rt, chunk->seed, index);
+    chunk->data_begin = chunk->worker->stack.top;
+    if (!bif_pmap_eval(chunk->worker, chunk)) {
+        chunk->errors = err_detach();
+    }
+}
+
+/**
+ * Gathers the results of the chunks, releasing their workers, whose steps
+ * are charged to the calling runtime.
+ */
+static void bif_pmap_gather(
+        struct Runtime *rt,
+        struct PmapChunk *chunks,
+        int chunk_count,
+        VAL_LOC_T data_begin)
+{
+    int i;
+    VAL_LOC_T chunk_loc, size;
+
+    /* The first failure is reported, the chunks that follow it do not
+     * matter, just like in a sequential map. */
+    for (i = 0; i < chunk_count; ++i) {
+        if (err_state()) {
+            err_discard(chunks[i].errors);
+        } else {
+            err_attach(chunks[i].errors);
+        }
+    }
+
+    for (i = 0; i < chunk_count && !err_state(); ++i) {
+        struct Stack *stack = &chunks[i].worker->stack;
+        size = stack->top - chunks[i].data_begin;
+        chunk_loc = rt->stack.top;
+        stack_push(&rt->stack, size, stack->buffer + chunks[i].data_begin);
+
+        if (rt->stack.top - data_begin > UINT16_MAX) {
+            err_push("BIF", "Results of _pmap_ too large to form a compound");
+        } else if (chunks[0].homo &&
+                   size > 0 &&
+                   !rt_val_pair_homo(rt, data_begin, chunk_loc)) {
+            err_push("BIF", "Results of _pmap_ must be homogenous to form an array");
+        }
+    }
+
+    for (i = 0; i < chunk_count; ++i) {
+        rt_budget_charge(rt, chunks[i].worker);
+        rt_free(chunks[i].worker);
+    }
+
+    if (!err_state()) {
+        rt_budget_check(rt);
+    }
+}
+
+void bif_pmap(struct Runtime *rt, VAL_LOC_T f_loc, VAL_LOC_T x_loc)
+{
+    int i, j, len, chunk_count;
+    enum ValueType x_type = rt_val_peek_type(&rt->stack, x_loc);
+    VAL_LOC_T size_loc, data_begin, elem_loc;
+    struct ValueFuncData func_data;
+    uint64_t seed;
+    struct PmapChunk *chunks;
+
+    if (rt_val_peek_type(&rt->stack, f_loc) != VAL_FUNCTION) {
+        bif_par_error_arg(1, "pmap", "must be function");
+        return;
+    }
+
+    /* Checked once here rather than by each of the workers. */
+    func_data = rt_val_function_data(rt, f_loc);
+    if (func_data.arity - func_data.appl_count != 1) {
+        bif_par_error_arg(1, "pmap", "must be a function of 1 argument");
+        return;
+    }
+
+    if (x_type != VAL_ARRAY && x_type != VAL_TUPLE) {
+        bif_par_error_arg(2, "pmap", "must be compound");
+        return;
+    }
+
+    len = rt_val_cpd_len(rt, x_loc);
+    chunk_count = rt->pool_size + 1;
+    if (chunk_count > len) {
+        chunk_count = len;
+    }
+
+    /* The workers draw from independent streams of a fresh seed. */
+    seed = cpprand_bits(&rt->rand);
+    chunks = mem_malloc((chunk_count + 1) * sizeof(*chunks));
+    elem_loc = rt_val_cpd_first_loc(x_loc);
+    for (i = 0; i < chunk_count; ++i) {
+        chunks[i].rt = rt;
+        chunks[i].sym_map = rt->bif_call->sym_map;
+        chunks[i].alm = rt->bif_call->alm;
+        chunks[i].f_loc = f_loc;
+        chunks[i].first_loc = elem_loc;
+        chunks[i].len = len / chunk_count + (i < len % chunk_count);
+        chunks[i].homo = x_type == VAL_ARRAY;
+        chunks[i].seed = seed;
+        chunks[i].worker = NULL;
+        chunks[i].errors = NULL;
+        if (i + 1 < chunk_count) {
+            for (j = 0; j < chunks[i].len; ++j) {
+                elem_loc = rt_val_next_loc(rt, elem_loc);
+            }
+        }
+    }
+
+    if (x_type == VAL_ARRAY) {
+        rt_val_push_array_init(&rt->stack, &size_loc);
+    } else {
+        rt_val_push_tuple_init(&rt->stack, &size_loc);
+    }
+    data_begin = rt->stack.top;
+
+    /* Even a single chunk is mapped on a copy of the stack, so that the
+     * result does not depend on the number of threads. */
+    rt_run_tasks(rt, bif_pmap_task, chunks, chunk_count);
+    bif_pmap_gather(rt, chunks, chunk_count, data_begin);
+    if (err_state()) {
+        goto cleanup;
+    }
+
+    rt_val_push_cpd_final(&rt->stack, size_loc, rt->stack.top - data_begin);
+
+cleanup:
+    mem_free(chunks);
+}
@@ -1,9 +1,13 @@
 /* Copyright (C) 2014-2016 Krzysztof Stachowiak */
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "error.h"
 #include "eval.h"
 #include "rt_val.h"
 #include "cpprand.h"
+#include "runtime.h"
 
 static void bif_rand_error_arg(int arg, char *func, char *condition)
 {
@@ -30,7 +34,7 @@ void bif_rand_ui(struct Runtime *rt, VAL_LOC_T lo_loc, VAL_LOC_T hi_loc)
     lo = rt_val_peek_int(rt, lo_loc);
     hi = rt_val_peek_int(rt, hi_loc);
 
-    rt_val_push_int(&rt->stack, cpprand_ui(lo, hi));
+    rt_val_push_int(&rt->stack, cpprand_ui(&rt->rand, lo, hi));
 }
 
 void bif_rand_ur(struct Runtime *rt, VAL_LOC_T lo_loc, VAL_LOC_T hi_loc)
@@ -53,7 +57,7 @@ void bif_rand_ur(struct Runtime *rt, VAL_LOC_T lo_loc, VAL_LOC_T hi_loc)
     lo = rt_val_peek_real(rt, lo_loc);
     hi = rt_val_peek_real(rt, hi_loc);
 
-    rt_val_push_real(&rt->stack, cpprand_ur(lo, hi));
+    rt_val_push_real(&rt->stack, cpprand_ur(&rt->rand, lo, hi));
 }
 
 void bif_rand_ber(struct Runtime *rt, VAL_LOC_T p_loc)
@@ -65,7 +69,7 @@ void bif_rand_ber(struct Runtime *rt, VAL_LOC_T p_loc)
         return;
     }
     p = rt_val_peek_real(rt, p_loc);
-    rt_val_push_bool(&rt->stack, cpprand_ber(p));
+    rt_val_push_bool(&rt->stack, cpprand_ber(&rt->rand, p));
 }
 
 void bif_rand_exp(struct Runtime *rt, VAL_LOC_T l_loc)
@@ -77,7 +81,7 @@ void bif_rand_exp(struct Runtime *rt, VAL_LOC_T l_loc)
         return;
     }
     l = rt_val_peek_real(rt, l_loc);
-    rt_val_push_real(&rt->stack, cpprand_exp(l));
+    rt_val_push_real(&rt->stack, cpprand_exp(&rt->rand, l));
 }
 
 void bif_rand_gauss(struct Runtime *rt, VAL_LOC_T u_loc, VAL_LOC_T s_loc)
@@ -100,44 +104,424 @@ void bif_rand_gauss(struct Runtime *rt, VAL_LOC_T u_loc, VAL_LOC_T s_loc)
     u = rt_val_peek_real(rt, u_loc);
     s = rt_val_peek_real(rt, s_loc);
 
-    rt_val_push_real(&rt->stack, cpprand_gauss(u, s));
+    rt_val_push_real(&rt->stack, cpprand_gauss(&rt->rand, u, s));
 }
 
-void bif_rand_distr(struct Runtime *rt, VAL_LOC_T d_loc)
+/**
+ * Checks the requested number of values to be drawn into an array, which
+ * must fit in the maximum size of a value.
+ */
+static bool bif_rand_peek_count(
+        struct Runtime *rt,
+        VAL_LOC_T n_loc,
+        int arg,
+        char *func,
+        VAL_SIZE_T elem_bytes,
+        VAL_INT_T *n)
+{
+    if (rt_val_peek_type(&rt->stack, n_loc) != VAL_INT ||
+        (*n = rt_val_peek_int(rt, n_loc)) < 0) {
+        bif_rand_error_arg(arg, func, "must be a non-negative integer");
+        return false;
+    }
+
+    if (*n > (VAL_INT_T)(UINT16_MAX / (VAL_HEAD_BYTES + elem_bytes))) {
+        bif_rand_error_arg(arg, func, "is too many values to store in an array");
+        return false;
+    }
+
+    return true;
+}
+
+static void bif_rand_push_ints(struct Runtime *rt, VAL_INT_T *values, VAL_INT_T n)
+{
+    VAL_INT_T i;
+    VAL_LOC_T size_loc;
+    rt_val_push_array_init(&rt->stack, &size_loc);
+    for (i = 0; i < n; ++i) {
+        rt_val_push_int(&rt->stack, values[i]);
+    }
+    rt_val_push_cpd_final(&rt->stack, size_loc, n * (VAL_HEAD_BYTES + VAL_INT_BYTES));
+}
+
+static void bif_rand_push_reals(struct Runtime *rt, VAL_REAL_T *values, VAL_INT_T n)
+{
+    VAL_INT_T i;
+    VAL_LOC_T size_loc;
+    rt_val_push_array_init(&rt->stack, &size_loc);
+    for (i = 0; i < n; ++i) {
+        rt_val_push_real(&rt->stack, values[i]);
+    }
+    rt_val_push_cpd_final(&rt->stack, size_loc, n * (VAL_HEAD_BYTES + VAL_REAL_BYTES));
+}
+
+static void bif_rand_push_bools(struct Runtime *rt, VAL_BOOL_T *values, VAL_INT_T n)
+{
+    VAL_INT_T i;
+    VAL_LOC_T size_loc;
+    rt_val_push_array_init(&rt->stack, &size_loc);
+    for (i = 0; i < n; ++i) {
+        rt_val_push_bool(&rt->stack, values[i]);
+    }
+    rt_val_push_cpd_final(&rt->stack, size_loc, n * (VAL_HEAD_BYTES + VAL_BOOL_BYTES));
+}
+
+void bif_rand_ui_array(
+        struct Runtime *rt,
+        VAL_LOC_T lo_loc,
+        VAL_LOC_T hi_loc,
+        VAL_LOC_T n_loc)
+{
+    VAL_INT_T n, *values;
+
+    if (rt_val_peek_type(&rt->stack, lo_loc) != VAL_INT) {
+        bif_rand_error_arg(1, "rand_ui_array", "must be an integer");
+        return;
+    }
+
+    if (rt_val_peek_type(&rt->stack, hi_loc) != VAL_INT) {
+        bif_rand_error_arg(2, "rand_ui_array", "must be an integer");
+        return;
+    }
+
+    if (!bif_rand_peek_count(rt, n_loc, 3, "rand_ui_array", VAL_INT_BYTES, &n)) {
+        return;
+    }
+
+    values = mem_malloc(n * sizeof(*values));
+    cpprand_fill_ui(
+        &rt->rand,
+        rt_val_peek_int(rt, lo_loc),
+        rt_val_peek_int(rt, hi_loc),
+        values, n);
+    bif_rand_push_ints(rt, values, n);
+    mem_free(values);
+}
+
+void bif_rand_ur_array(
+        struct Runtime *rt,
+        VAL_LOC_T lo_loc,
+        VAL_LOC_T hi_loc,
+        VAL_LOC_T n_loc)
+{
+    VAL_INT_T n;
+    VAL_REAL_T *values;
+
+    if (rt_val_peek_type(&rt->stack, lo_loc) != VAL_REAL) {
+        bif_rand_error_arg(1, "rand_ur_array", "must be a real value");
+        return;
+    }
+
+    if (rt_val_peek_type(&rt->stack, hi_loc) != VAL_REAL) {
+        bif_rand_error_arg(2, "rand_ur_array", "must be a real value");
+        return;
+    }
+
+    if (!bif_rand_peek_count(rt, n_loc, 3, "rand_ur_array", VAL_REAL_BYTES, &n)) {
+        return;
+    }
+
+    values = mem_malloc(n * sizeof(*values));
+    cpprand_fill_ur(
+        &rt->rand,
+        rt_val_peek_real(rt, lo_loc),
+        rt_val_peek_real(rt, hi_loc),
+        values, n);
+    bif_rand_push_reals(rt, values, n);
+    mem_free(values);
+}
+
+void bif_rand_ber_array(struct Runtime *rt, VAL_LOC_T p_loc, VAL_LOC_T n_loc)
+{
+    VAL_INT_T n;
+    VAL_BOOL_T *values;
+
+    if (rt_val_peek_type(&rt->stack, p_loc) != VAL_REAL) {
+        bif_rand_error_arg(1, "rand_ber_array", "must be a real value");
+        return;
+    }
+
+    if (!bif_rand_peek_count(rt, n_loc, 2, "rand_ber_array", VAL_BOOL_BYTES, &n)) {
+        return;
+    }
+
+    values = mem_malloc(n * sizeof(*values));
+    cpprand_fill_ber(&rt->rand, rt_val_peek_real(rt, p_loc), values, n);
+    bif_rand_push_bools(rt, values, n);
+    mem_free(values);
+}
+
+void bif_rand_exp_array(struct Runtime *rt, VAL_LOC_T l_loc, VAL_LOC_T n_loc)
+{
+    VAL_INT_T n;
+    VAL_REAL_T *values;
+
+    if (rt_val_peek_type(&rt->stack, l_loc) != VAL_REAL) {
+        bif_rand_error_arg(1, "rand_exp_array", "must be a real value");
+        return;
+    }
+
+    if (!bif_rand_peek_count(rt, n_loc, 2, "rand_exp_array", VAL_REAL_BYTES, &n)) {
+        return;
+    }
+
+    values = mem_malloc(n * sizeof(*values));
+    cpprand_fill_exp(&rt->rand, rt_val_peek_real(rt, l_loc), values, n);
+    bif_rand_push_reals(rt, values, n);
+    mem_free(values);
+}
+
+void bif_rand_gauss_array(
+        struct Runtime *rt,
+        VAL_LOC_T u_loc,
+        VAL_LOC_T s_loc,
+        VAL_LOC_T n_loc)
+{
+    VAL_INT_T n;
+    VAL_REAL_T *values;
+
+    if (rt_val_peek_type(&rt->stack, u_loc) != VAL_REAL) {
+        bif_rand_error_arg(1, "rand_gauss_array", "must be a real value");
+        return;
+    }
+
+    if (rt_val_peek_type(&rt->stack, s_loc) != VAL_REAL) {
+        bif_rand_error_arg(2, "rand_gauss_array", "must be a real value");
+        return;
+    }
+
+    if (!bif_rand_peek_count(rt, n_loc, 3, "rand_gauss_array", VAL_REAL_BYTES, &n)) {
+        return;
+    }
+
+    values = mem_malloc(n * sizeof(*values));
+    cpprand_fill_gauss(
+        &rt->rand,
+        rt_val_peek_real(rt, u_loc),
+        rt_val_peek_real(rt, s_loc),
+        values, n);
+    bif_rand_push_reals(rt, values, n);
+    mem_free(values);
+}
+
+/**
+ * Reads the density array argument into a buffer, which the caller must
+ * release. Returns NULL if the argument is invalid.
+ */
+static VAL_REAL_T *bif_rand_peek_density(
+        struct Runtime *rt,
+        VAL_LOC_T d_loc,
+        char *func,
+        VAL_SIZE_T *len)
 {
     enum ValueType d_type = rt_val_peek_type(&rt->stack, d_loc);
     enum ValueType first_type;
-    VAL_SIZE_T len, i;
+    VAL_SIZE_T i;
     VAL_LOC_T loc;
     VAL_REAL_T *density;
-    VAL_INT_T result;
 
     if (d_type != VAL_ARRAY) {
-        bif_rand_error_arg(1, "rand_distr", "must be an array");
-        return;
+        bif_rand_error_arg(1, func, "must be an array");
+        return NULL;
     }
 
-    len = rt_val_cpd_len(rt, d_loc);
-    if (len == 0) {
-        bif_rand_error_arg(1, "rand_distr", "must not be empty");
-        return;
+    *len = rt_val_cpd_len(rt, d_loc);
+    if (*len == 0) {
+        bif_rand_error_arg(1, func, "must not be empty");
+        return NULL;
     }
 
     loc = rt_val_cpd_first_loc(d_loc);
     first_type = rt_val_peek_type(&rt->stack, loc);
     if (first_type != VAL_REAL) {
-        bif_rand_error_arg(1, "rand_distr", "must containt real values");
-        return;
+        bif_rand_error_arg(1, func, "must containt real values");
+        return NULL;
     }
 
-    density = mem_malloc(len * sizeof(*density));
-    for (i = 0; i < len; ++i) {
+    density = mem_malloc(*len * sizeof(*density));
+    for (i = 0; i < *len; ++i) {
         density[i] = rt_val_peek_real(rt, loc);
         loc = rt_val_next_loc(rt, loc);
     }
-    result = cpprand_distr(density, len);
+
+    return density;
+}
+
+void bif_rand_distr(struct Runtime *rt, VAL_LOC_T d_loc)
+{
+    VAL_SIZE_T len;
+    VAL_REAL_T *density;
+    VAL_INT_T result;
+
+    if (!(density = bif_rand_peek_density(rt, d_loc, "rand_distr", &len))) {
+        return;
+    }
+
+    result = cpprand_distr(&rt->rand, density, len);
     mem_free(density);
 
     rt_val_push_int(&rt->stack, result);
 }
 
+void bif_rand_seed(struct Runtime *rt, VAL_LOC_T s_loc)
+{
+    if (rt_val_peek_type(&rt->stack, s_loc) != VAL_INT) {
+        bif_rand_error_arg(1, "rand_seed", "must be an integer");
+        return;
+    }
+    rt_seed(rt, rt_val_peek_int(rt, s_loc), 0);
+    rt_val_push_unit(&rt->stack);
+}
+
+void bif_rand_stream(struct Runtime *rt, VAL_LOC_T s_loc, VAL_LOC_T n_loc)
+{
+    if (rt_val_peek_type(&rt->stack, s_loc) != VAL_INT) {
+        bif_rand_error_arg(1, "rand_stream", "must be an integer");
+        return;
+    }
+
+    if (rt_val_peek_type(&rt->stack, n_loc) != VAL_INT) {
+        bif_rand_error_arg(2, "rand_stream", "must be an integer");
+        return;
+    }
+
+    rt_seed(rt, rt_val_peek_int(rt, s_loc), rt_val_peek_int(rt, n_loc));
+    rt_val_push_unit(&rt->stack);
+}
+
+/**
+ * Builds the alias table of the density with Vose's method. Each outcome is
+ * given a column of height 1 filled with its own scaled weight and topped up
+ * with one of the outcomes exceeding the average weight.
+ */
+static void bif_rand_build_alias(
+        VAL_REAL_T *density,
+        VAL_SIZE_T len,
+        VAL_REAL_T sum,
+        VAL_REAL_T *probs,
+        VAL_INT_T *aliases)
+{
+    VAL_SIZE_T i, small_count = 0, large_count = 0;
+    VAL_SIZE_T *small = mem_malloc(len * sizeof(*small));
+    VAL_SIZE_T *large = mem_malloc(len * sizeof(*large));
+
+    for (i = 0; i < len; ++i) {
+        probs[i] = density[i] * len / sum;
+        aliases[i] = i;
+        if (probs[i] < 1.0) {
+            small[small_count++] = i;
+        } else {
+            large[large_count++] = i;
+        }
+    }
+
+    while (small_count && large_count) {
+        VAL_SIZE_T l = small[--small_count];
+        VAL_SIZE_T g = large[--large_count];
+        aliases[l] = g;
+        probs[g] += probs[l] - 1.0;
+        if (probs[g] < 1.0) {
+            small[small_count++] = g;
+        } else {
+            large[large_count++] = g;
+        }
+    }
+
+    /* The leftovers only miss the full height due to the rounding errors. */
+    while (small_count) {
+        probs[small[--small_count]] = 1.0;
+    }
+    while (large_count) {
+        probs[large[--large_count]] = 1.0;
+    }
+
+    mem_free(small);
+    mem_free(large);
+}
+
+void bif_make_sampler(struct Runtime *rt, VAL_LOC_T d_loc)
+{
+    VAL_SIZE_T len, i;
+    VAL_REAL_T *density, *probs, sum = 0.0;
+    VAL_INT_T *aliases;
+
+    if (!(density = bif_rand_peek_density(rt, d_loc, "make_sampler", &len))) {
+        return;
+    }
+
+    if (len > UINT16_MAX / VAL_SAMPLER_ENTRY_BYTES) {
+        bif_rand_error_arg(1, "make_sampler", "has too many elements");
+        mem_free(density);
+        return;
+    }
+
+    for (i = 0; i < len; ++i) {
+        if (density[i] < 0.0) {
+            bif_rand_error_arg(1, "make_sampler", "must not contain negative values");
+            mem_free(density);
+            return;
+        }
+        sum += density[i];
+    }
+
+    if (sum <= 0.0) {
+        bif_rand_error_arg(1, "make_sampler", "must have a positive sum");
+        mem_free(density);
+        return;
+    }
+
+    probs = mem_malloc(len * sizeof(*probs));
+    aliases = mem_malloc(len * sizeof(*aliases));
+    bif_rand_build_alias(density, len, sum, probs, aliases);
+    rt_val_push_sampler(&rt->stack, probs, aliases, len);
+    mem_free(density);
+    mem_free(probs);
+    mem_free(aliases);
+}
+
+/** Draws an outcome in constant time: a column and a point within it. */
+static VAL_INT_T bif_rand_sampler_draw(
+        struct Runtime *rt,
+        VAL_LOC_T s_loc,
+        VAL_SIZE_T len)
+{
+    VAL_INT_T index = cpprand_ui(&rt->rand, 0, len - 1), alias;
+    VAL_REAL_T prob;
+    rt_val_peek_sampler_entry(rt, s_loc, index, &prob, &alias);
+    return cpprand_ur(&rt->rand, 0.0, 1.0) < prob ? index : alias;
+}
+
+void bif_rand_sample(struct Runtime *rt, VAL_LOC_T s_loc)
+{
+    if (rt_val_peek_type(&rt->stack, s_loc) != VAL_SAMPLER) {
+        bif_rand_error_arg(1, "rand_sample", "must be a sampler");
+        return;
+    }
+
+    rt_val_push_int(
+        &rt->stack,
+        bif_rand_sampler_draw(rt, s_loc, rt_val_sampler_len(rt, s_loc)));
+}
+
+void bif_rand_samples(struct Runtime *rt, VAL_LOC_T s_loc, VAL_LOC_T n_loc)
+{
+    VAL_SIZE_T len;
+    VAL_INT_T n, i, *values;
+
+    if (rt_val_peek_type(&rt->stack, s_loc) != VAL_SAMPLER) {
+        bif_rand_error_arg(1, "rand_samples", "must be a sampler");
+        return;
+    }
+
+    if (!bif_rand_peek_count(rt, n_loc, 2, "rand_samples", VAL_INT_BYTES, &n)) {
+        return;
+    }
+
+    len = rt_val_sampler_len(rt, s_loc);
+    values = mem_malloc(n * sizeof(*values));
+    for (i = 0; i < n; ++i) {
+        values[i] = bif_rand_sampler_draw(rt, s_loc, len);
+    }
+    bif_rand_push_ints(rt, values, n);
+    mem_free(values);
+}
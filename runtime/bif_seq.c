@@ -0,0 +1,179 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#include <stdint.h>
+
+#include "bif.h"
+#include "bif_detail.h"
+#include "error.h"
+#include "eval.h"
+#include "rt_val.h"
+#include "runtime.h"
+#include "stack.h"
+
+/*
+ * The lazy sequence BIFs only push the description of a sequence, the
+ * elements are generated by the consumers, one at a time, see eval_seq.c.
+ */
+
+static void bif_seq_error_arg(int arg, char *func, char *condition)
+{
+    err_push("BIF", "Argument %d of _%s_ %s", arg, func, condition);
+}
+
+static bool bif_seq_is_source(struct Runtime *rt, VAL_LOC_T loc)
+{
+    enum ValueType type = rt_val_peek_type(&rt->stack, loc);
+    return type == VAL_ARRAY || type == VAL_TUPLE || type == VAL_SEQ;
+}
+
+void bif_push_seq(
+        struct Runtime *rt,
+        enum ValueSeqKind kind,
+        VAL_LOC_T *param_locs,
+        int param_count)
+{
+    int i;
+    VAL_LOC_T size_loc, data_begin;
+
+    rt_val_push_seq_init(&rt->stack, kind, &size_loc);
+    data_begin = size_loc + VAL_HEAD_SIZE_BYTES;
+    for (i = 0; i < param_count; ++i) {
+        rt_val_push_copy(&rt->stack, param_locs[i]);
+    }
+    rt_val_push_seq_final(&rt->stack, size_loc, rt->stack.top - data_begin);
+}
+
+bool bif_push_seq_elements(
+        struct Runtime *rt,
+        VAL_LOC_T seq_loc,
+        enum ValueType type,
+        char *func)
+{
+    bool result = true;
+    VAL_LOC_T size_loc, data_begin, elem_loc, dst_loc;
+    struct EvalSeq seq;
+
+    if (!eval_seq_init(
+            &seq, rt,
+            rt->bif_call->sym_map,
+            rt->bif_call->alm,
+            seq_loc)) {
+        err_push("BIF", "Failed iterating over a sequence in _%s_", func);
+        return false;
+    }
+
+    if (type == VAL_ARRAY) {
+        rt_val_push_array_init(&rt->stack, &size_loc);
+    } else {
+        rt_val_push_tuple_init(&rt->stack, &size_loc);
+    }
+    data_begin = rt->stack.top;
+
+    for (;;) {
+        dst_loc = rt->stack.top;
+        if (!eval_seq_next(&seq, &elem_loc)) {
+            break;
+        }
+
+        eval_seq_keep(&seq, dst_loc, elem_loc);
+
+        if (rt->stack.top - data_begin > UINT16_MAX) {
+            err_push("BIF", "Sequence too long to be stored in _%s_", func);
+            result = false;
+            goto cleanup;
+        }
+
+        if (type == VAL_ARRAY && !rt_val_pair_homo(rt, data_begin, dst_loc)) {
+            err_push("BIF", "Elements of a sequence must be homogenous to form an array in _%s_", func);
+            result = false;
+            goto cleanup;
+        }
+    }
+
+    if (err_state()) {
+        err_push("BIF", "Failed iterating over a sequence in _%s_", func);
+        result = false;
+        goto cleanup;
+    }
+
+    rt_val_push_cpd_final(&rt->stack, size_loc, rt->stack.top - data_begin);
+
+cleanup:
+    eval_seq_deinit(&seq);
+    return result;
+}
+
+void bif_lazy(struct Runtime *rt, VAL_LOC_T x_loc)
+{
+    enum ValueType type = rt_val_peek_type(&rt->stack, x_loc);
+
+    if (type == VAL_SEQ) {
+        rt_val_push_copy(&rt->stack, x_loc);
+    } else if (type == VAL_ARRAY || type == VAL_TUPLE) {
+        bif_push_seq(rt, VAL_SEQ_CPD, &x_loc, 1);
+    } else {
+        bif_seq_error_arg(1, "lazy", "must be compound or sequence");
+    }
+}
+
+void bif_lazy_range(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc)
+{
+    VAL_LOC_T param_locs[] = { x_loc, y_loc };
+
+    if (rt_val_peek_type(&rt->stack, x_loc) != VAL_INT) {
+        bif_seq_error_arg(1, "lazy_range", "must be integer");
+        return;
+    }
+
+    if (rt_val_peek_type(&rt->stack, y_loc) != VAL_INT) {
+        bif_seq_error_arg(2, "lazy_range", "must be integer");
+        return;
+    }
+
+    bif_push_seq(rt, VAL_SEQ_RANGE, param_locs, 2);
+}
+
+void bif_lazy_gen(struct Runtime *rt, VAL_LOC_T f_loc, VAL_LOC_T x_loc)
+{
+    VAL_LOC_T param_locs[] = { f_loc, x_loc };
+
+    if (rt_val_peek_type(&rt->stack, f_loc) != VAL_FUNCTION) {
+        bif_seq_error_arg(1, "lazy_gen", "must be function");
+        return;
+    }
+
+    if (rt_val_peek_type(&rt->stack, x_loc) != VAL_INT) {
+        bif_seq_error_arg(2, "lazy_gen", "must be integer");
+        return;
+    }
+
+    bif_push_seq(rt, VAL_SEQ_GEN, param_locs, 2);
+}
+
+void bif_take(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc)
+{
+    VAL_LOC_T param_locs[] = { x_loc, y_loc };
+
+    if (rt_val_peek_type(&rt->stack, x_loc) != VAL_INT ||
+        rt_val_peek_int(rt, x_loc) < 0) {
+        bif_seq_error_arg(1, "take", "must be a non-negative integer");
+        return;
+    }
+
+    if (!bif_seq_is_source(rt, y_loc)) {
+        bif_seq_error_arg(2, "take", "must be compound or sequence");
+        return;
+    }
+
+    bif_push_seq(rt, VAL_SEQ_TAKE, param_locs, 2);
+}
+
+void bif_collect(struct Runtime *rt, VAL_LOC_T x_loc)
+{
+    if (!bif_seq_is_source(rt, x_loc)) {
+        bif_seq_error_arg(1, "collect", "must be compound or sequence");
+        return;
+    }
+
+    bif_push_seq_elements(rt, x_loc, VAL_ARRAY, "collect");
+}
@@ -0,0 +1,606 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#include <string.h>
+
+#include "bif.h"
+#include "bif_detail.h"
+#include "error.h"
+#include "eval.h"
+#include "memory.h"
+#include "rt_val.h"
+#include "runtime.h"
+#include "stack.h"
+
+/*
+ * The sorting BIFs sort the locations of the compound's elements and only
+ * then push the result, copying each element exactly once. The primitive
+ * values compared with the less than operator are unboxed up front, in all
+ * other cases the comparator function is called back for each comparison.
+ */
+
+#define SORT_INSERTION_THRESHOLD 16
+#define SORT_MIN_MERGE 64
+
+enum SortKind {
+    SORT_INT,
+    SORT_REAL,
+    SORT_CALL
+};
+
+struct SortItem {
+    VAL_LOC_T loc;
+    union {
+        VAL_INT_T integer;
+        VAL_REAL_T real;
+    } key;
+};
+
+struct SortCmp {
+    struct Runtime *rt;
+    enum SortKind kind;
+    struct EvalCall call;
+    bool failed;
+};
+
+struct SortRun {
+    int begin, len;
+};
+
+static void bif_sort_error_arg(int arg, char *func, char *condition)
+{
+    err_push("BIF", "Argument %d of _%s_ %s", arg, func, condition);
+}
+
+static bool sort_less(struct SortCmp *cmp, struct SortItem *x, struct SortItem *y)
+{
+    VAL_LOC_T arg_locs[2], result_loc, top;
+    struct Runtime *rt;
+    bool result;
+
+    switch (cmp->kind) {
+    case SORT_INT:
+        return x->key.integer < y->key.integer;
+
+    case SORT_REAL:
+        return x->key.real < y->key.real;
+
+    case SORT_CALL:
+        break;
+    }
+
+    if (cmp->failed) {
+        return false;
+    }
+
+    rt = cmp->rt;
+    top = rt->stack.top;
+    arg_locs[0] = x->loc;
+    arg_locs[1] = y->loc;
+    result_loc = eval_call(&cmp->call, arg_locs);
+
+    if (err_state()) {
+        cmp->failed = true;
+        result = false;
+    } else if (rt_val_peek_type(&rt->stack, result_loc) != VAL_BOOL) {
+        err_push("BIF", "Sorting comparator must return a boolean value");
+        cmp->failed = true;
+        result = false;
+    } else {
+        result = rt_val_peek_bool(rt, result_loc);
+    }
+
+    rt->stack.top = top;
+    return result;
+}
+
+static void sort_swap(struct SortItem *x, struct SortItem *y)
+{
+    struct SortItem temp = *x;
+    *x = *y;
+    *y = temp;
+}
+
+/* Introsort.
+ * ==========
+ */
+
+static void sort_insertion(
+        struct SortItem *items,
+        int begin,
+        int end,
+        struct SortCmp *cmp)
+{
+    int i, j;
+    for (i = begin + 1; i < end; ++i) {
+        struct SortItem item = items[i];
+        for (j = i; j > begin && sort_less(cmp, &item, items + j - 1); --j) {
+            items[j] = items[j - 1];
+        }
+        items[j] = item;
+    }
+}
+
+static void sort_sift_down(
+        struct SortItem *items,
+        int root,
+        int len,
+        struct SortCmp *cmp)
+{
+    int child;
+    while ((child = 2 * root + 1) < len) {
+        if (child + 1 < len && sort_less(cmp, items + child, items + child + 1)) {
+            ++child;
+        }
+        if (!sort_less(cmp, items + root, items + child)) {
+            return;
+        }
+        sort_swap(items + root, items + child);
+        root = child;
+    }
+}
+
+static void sort_heap(struct SortItem *items, int len, struct SortCmp *cmp)
+{
+    int i;
+    for (i = len / 2 - 1; i >= 0; --i) {
+        sort_sift_down(items, i, len, cmp);
+    }
+    for (i = len - 1; i > 0; --i) {
+        sort_swap(items, items + i);
+        sort_sift_down(items, 0, i, cmp);
+    }
+}
+
+/** Moves the median of the first, middle and last item to the front. */
+static void sort_median_to_front(
+        struct SortItem *items,
+        int begin,
+        int end,
+        struct SortCmp *cmp)
+{
+    struct SortItem *a = items + begin;
+    struct SortItem *b = items + begin + (end - begin) / 2;
+    struct SortItem *c = items + end - 1;
+
+    if (sort_less(cmp, b, a)) {
+        sort_swap(a, b);
+    }
+    if (sort_less(cmp, c, b)) {
+        sort_swap(b, c);
+        if (sort_less(cmp, b, a)) {
+            sort_swap(a, b);
+        }
+    }
+    sort_swap(a, b);
+}
+
+/**
+ * Partitions the range around its first item and returns the pivot's final
+ * position. The bound checks keep it safe even for inconsistent comparators.
+ */
+static int sort_partition(
+        struct SortItem *items,
+        int begin,
+        int end,
+        struct SortCmp *cmp)
+{
+    int i = begin + 1, j = end - 1;
+    struct SortItem *pivot = items + begin;
+
+    for (;;) {
+        while (i <= j && sort_less(cmp, items + i, pivot)) {
+            ++i;
+        }
+        while (i <= j && sort_less(cmp, pivot, items + j)) {
+            --j;
+        }
+        if (i >= j) {
+            break;
+        }
+        sort_swap(items + i++, items + j--);
+    }
+
+    sort_swap(items + begin, items + j);
+    return j;
+}
+
+static void sort_intro(
+        struct SortItem *items,
+        int begin,
+        int end,
+        int depth,
+        struct SortCmp *cmp)
+{
+    while (end - begin > SORT_INSERTION_THRESHOLD) {
+        int middle;
+
+        if (depth-- == 0) {
+            sort_heap(items + begin, end - begin, cmp);
+            return;
+        }
+
+        sort_median_to_front(items, begin, end, cmp);
+        middle = sort_partition(items, begin, end, cmp);
+
+        /* Recurse into the smaller part, iterate over the larger one. */
+        if (middle - begin < end - middle) {
+            sort_intro(items, begin, middle, depth, cmp);
+            begin = middle + 1;
+        } else {
+            sort_intro(items, middle + 1, end, depth, cmp);
+            end = middle;
+        }
+    }
+
+    sort_insertion(items, begin, end, cmp);
+}
+
+static void sort_unstable(struct SortItem *items, int len, struct SortCmp *cmp)
+{
+    int depth = 0, i;
+    for (i = len; i > 1; i /= 2) {
+        depth += 2;
+    }
+    sort_intro(items, 0, len, depth, cmp);
+}
+
+/* Timsort.
+ * ========
+ * A simplified variant: natural runs are detected and extended to a minimal
+ * length with binary insertion, then merged while keeping the run lengths
+ * balanced, without the galloping mode.
+ */
+
+static int sort_min_run(int len)
+{
+    int remainder = 0;
+    while (len >= SORT_MIN_MERGE) {
+        remainder |= len & 1;
+        len >>= 1;
+    }
+    return len + remainder;
+}
+
+static void sort_binary_insertion(
+        struct SortItem *items,
+        int begin,
+        int sorted_end,
+        int end,
+        struct SortCmp *cmp)
+{
+    int i;
+    for (i = sorted_end; i < end; ++i) {
+        struct SortItem item = items[i];
+        int lo = begin, hi = i;
+
+        /* Insert after the equal items to keep the sort stable. */
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (sort_less(cmp, &item, items + mid)) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+
+        memmove(items + lo + 1, items + lo, (i - lo) * sizeof(*items));
+        items[lo] = item;
+    }
+}
+
+/** Finds the run starting at the given item and makes it ascending. */
+static int sort_count_run(
+        struct SortItem *items,
+        int begin,
+        int end,
+        struct SortCmp *cmp)
+{
+    int run_end = begin + 1;
+
+    if (run_end == end) {
+        return 1;
+    }
+
+    if (sort_less(cmp, items + run_end, items + begin)) {
+        /* Only strictly descending runs are reversed to keep stability. */
+        int lo = begin, hi;
+        while (++run_end < end &&
+               sort_less(cmp, items + run_end, items + run_end - 1));
+        for (hi = run_end - 1; lo < hi; ++lo, --hi) {
+            sort_swap(items + lo, items + hi);
+        }
+    } else {
+        while (++run_end < end &&
+               !sort_less(cmp, items + run_end, items + run_end - 1));
+    }
+
+    return run_end - begin;
+}
+
+static void sort_merge(
+        struct SortItem *items,
+        struct SortItem *buffer,
+        struct SortRun *x,
+        struct SortRun *y,
+        struct SortCmp *cmp)
+{
+    struct SortItem *dst = items + x->begin;
+    struct SortItem *left = buffer, *left_end = buffer + x->len;
+    struct SortItem *right = items + y->begin, *right_end = right + y->len;
+
+    memcpy(buffer, items + x->begin, x->len * sizeof(*items));
+
+    while (left != left_end && right != right_end) {
+        if (sort_less(cmp, right, left)) {
+            *dst++ = *right++;
+        } else {
+            *dst++ = *left++;
+        }
+    }
+
+    memcpy(dst, left, (left_end - left) * sizeof(*items));
+    x->len += y->len;
+}
+
+static void sort_merge_at(
+        struct SortItem *items,
+        struct SortItem *buffer,
+        struct SortRun *runs,
+        int *run_count,
+        int at,
+        struct SortCmp *cmp)
+{
+    sort_merge(items, buffer, runs + at, runs + at + 1, cmp);
+    memmove(
+        runs + at + 1,
+        runs + at + 2,
+        (*run_count - at - 2) * sizeof(*runs));
+    --(*run_count);
+}
+
+static void sort_merge_collapse(
+        struct SortItem *items,
+        struct SortItem *buffer,
+        struct SortRun *runs,
+        int *run_count,
+        struct SortCmp *cmp)
+{
+    while (*run_count > 1) {
+        int n = *run_count - 2;
+        if ((n > 0 && runs[n - 1].len <= runs[n].len + runs[n + 1].len) ||
+            (n > 1 && runs[n - 2].len <= runs[n - 1].len + runs[n].len)) {
+            if (runs[n - 1].len < runs[n + 1].len) {
+                --n;
+            }
+        } else if (runs[n].len > runs[n + 1].len) {
+            break;
+        }
+        sort_merge_at(items, buffer, runs, run_count, n, cmp);
+    }
+}
+
+static void sort_stable(struct SortItem *items, int len, struct SortCmp *cmp)
+{
+    int begin = 0, run_count = 0;
+    int min_run = sort_min_run(len);
+    struct SortItem *buffer = mem_malloc((len + 1) * sizeof(*buffer));
+    struct SortRun *runs = mem_malloc((len + 1) * sizeof(*runs));
+
+    while (begin < len) {
+        int run_len = sort_count_run(items, begin, len, cmp);
+
+        if (run_len < min_run) {
+            int forced_len = len - begin < min_run ? len - begin : min_run;
+            sort_binary_insertion(
+                items, begin,
+                begin + run_len,
+                begin + forced_len,
+                cmp);
+            run_len = forced_len;
+        }
+
+        runs[run_count].begin = begin;
+        runs[run_count].len = run_len;
+        ++run_count;
+
+        sort_merge_collapse(items, buffer, runs, &run_count, cmp);
+        begin += run_len;
+    }
+
+    while (run_count > 1) {
+        int n = run_count - 2;
+        if (n > 0 && runs[n - 1].len < runs[n + 1].len) {
+            --n;
+        }
+        sort_merge_at(items, buffer, runs, &run_count, n, cmp);
+    }
+
+    mem_free(runs);
+    mem_free(buffer);
+}
+
+/* The BIFs.
+ * =========
+ */
+
+/**
+ * Unboxes the keys if all the elements are primitive values comparable with
+ * the less than operator.
+ */
+static bool sort_try_unbox(
+        struct Runtime *rt,
+        struct SortItem *items,
+        int len,
+        enum SortKind *kind)
+{
+    int i;
+    bool has_int = false, has_real = false, has_other = false;
+
+    for (i = 0; i < len; ++i) {
+        switch (rt_val_peek_type(&rt->stack, items[i].loc)) {
+        case VAL_INT:
+            has_int = true;
+            break;
+
+        case VAL_REAL:
+            has_real = true;
+            break;
+
+        case VAL_BOOL:
+        case VAL_CHAR:
+            has_other = true;
+            break;
+
+        default:
+            return false;
+        }
+    }
+
+    if (has_other) {
+        enum ValueType type = rt_val_peek_type(&rt->stack, items[0].loc);
+        if (has_int || has_real) {
+            return false;
+        }
+        for (i = 0; i < len; ++i) {
+            if (rt_val_peek_type(&rt->stack, items[i].loc) != type) {
+                return false;
+            }
+            items[i].key.integer = type == VAL_BOOL
+                ? !!rt_val_peek_bool(rt, items[i].loc)
+                : rt_val_peek_char(rt, items[i].loc);
+        }
+        *kind = SORT_INT;
+
+    } else if (has_real) {
+        for (i = 0; i < len; ++i) {
+            items[i].key.real =
+                rt_val_peek_type(&rt->stack, items[i].loc) == VAL_REAL
+                    ? rt_val_peek_real(rt, items[i].loc)
+                    : (VAL_REAL_T)rt_val_peek_int(rt, items[i].loc);
+        }
+        *kind = SORT_REAL;
+
+    } else {
+        for (i = 0; i < len; ++i) {
+            items[i].key.integer = rt_val_peek_int(rt, items[i].loc);
+        }
+        *kind = SORT_INT;
+    }
+
+    return true;
+}
+
+/** Checks whether the function value is just the less than BIF. */
+static bool sort_is_plain_lt(struct Runtime *rt, VAL_LOC_T cmp_loc)
+{
+    struct ValueFuncData func_data;
+
+    if (rt_val_peek_type(&rt->stack, cmp_loc) != VAL_FUNCTION) {
+        return false;
+    }
+
+    func_data = rt_val_function_data(rt, cmp_loc);
+    return func_data.func_type == VAL_FUNC_BIF &&
+        func_data.impl == (void*)bif_lt &&
+        func_data.appl_count == 0;
+}
+
+/**
+ * Sorts the compound at x_loc and pushes the result. If cmp_loc is -1 the
+ * elements are compared with the less than operator.
+ */
+static void bif_sort_impl(
+        struct Runtime *rt,
+        VAL_LOC_T cmp_loc,
+        VAL_LOC_T x_loc,
+        bool stable,
+        char *func)
+{
+    int i, len, x_arg = cmp_loc == -1 ? 1 : 2;
+    VAL_LOC_T size_loc, data_begin, elem_loc;
+    enum ValueType x_type = rt_val_peek_type(&rt->stack, x_loc);
+    struct SortItem *items;
+    struct SortCmp cmp;
+
+    if (x_type != VAL_ARRAY && x_type != VAL_TUPLE) {
+        bif_sort_error_arg(x_arg, func, "must be compound");
+        return;
+    }
+
+    len = rt_val_cpd_len(rt, x_loc);
+    items = mem_malloc((len + 1) * sizeof(*items));
+    elem_loc = rt_val_cpd_first_loc(x_loc);
+    for (i = 0; i < len; ++i) {
+        items[i].loc = elem_loc;
+        elem_loc = rt_val_next_loc(rt, elem_loc);
+    }
+
+    cmp.rt = rt;
+    cmp.failed = false;
+
+    if (cmp_loc == -1 || sort_is_plain_lt(rt, cmp_loc)) {
+        if (!sort_try_unbox(rt, items, len, &cmp.kind)) {
+            bif_sort_error_arg(x_arg, func,
+                "must consist of primitive values of matching types");
+            goto cleanup;
+        }
+
+    } else {
+        cmp.kind = SORT_CALL;
+        if (!eval_call_init(
+                &cmp.call,
+                rt,
+                rt->bif_call->sym_map,
+                rt->bif_call->alm,
+                cmp_loc,
+                2)) {
+            bif_sort_error_arg(1, func, "must be a binary function");
+            goto cleanup;
+        }
+    }
+
+    if (stable) {
+        sort_stable(items, len, &cmp);
+    } else {
+        sort_unstable(items, len, &cmp);
+    }
+
+    if (cmp.kind == SORT_CALL) {
+        eval_call_deinit(&cmp.call);
+    }
+
+    if (cmp.failed) {
+        err_push("BIF", "Comparator call failed in _%s_", func);
+        goto cleanup;
+    }
+
+    if (x_type == VAL_ARRAY) {
+        rt_val_push_array_init(&rt->stack, &size_loc);
+    } else {
+        rt_val_push_tuple_init(&rt->stack, &size_loc);
+    }
+
+    data_begin = rt->stack.top;
+    for (i = 0; i < len; ++i) {
+        rt_val_push_copy(&rt->stack, items[i].loc);
+    }
+    rt_val_push_cpd_final(&rt->stack, size_loc, rt->stack.top - data_begin);
+
+cleanup:
+    mem_free(items);
+}
+
+void bif_sort(struct Runtime *rt, VAL_LOC_T x_loc)
+{
+    bif_sort_impl(rt, -1, x_loc, false, "sort");
+}
+
+void bif_sort_cmp(struct Runtime *rt, VAL_LOC_T cmp_loc, VAL_LOC_T x_loc)
+{
+    bif_sort_impl(rt, cmp_loc, x_loc, false, "sort_cmp");
+}
+
+void bif_stable_sort(struct Runtime *rt, VAL_LOC_T cmp_loc, VAL_LOC_T x_loc)
+{
+    bif_sort_impl(rt, cmp_loc, x_loc, true, "stable_sort");
+}
@@ -59,3 +59,31 @@ void bif_is_pointer(struct Runtime *rt, VAL_LOC_T x_loc)
         rt_val_peek_type(&rt->stack, x_loc) == VAL_PTR);
 }
 
+void bif_is_dict(struct Runtime *rt, VAL_LOC_T x_loc)
+{
+    rt_val_push_bool(
+        &rt->stack,
+        rt_val_peek_type(&rt->stack, x_loc) == VAL_DICT);
+}
+
+void bif_is_sampler(struct Runtime *rt, VAL_LOC_T x_loc)
+{
+    rt_val_push_bool(
+        &rt->stack,
+        rt_val_peek_type(&rt->stack, x_loc) == VAL_SAMPLER);
+}
+
+void bif_is_channel(struct Runtime *rt, VAL_LOC_T x_loc)
+{
+    rt_val_push_bool(
+        &rt->stack,
+        rt_val_peek_type(&rt->stack, x_loc) == VAL_CHANNEL);
+}
+
+void bif_is_seq(struct Runtime *rt, VAL_LOC_T x_loc)
+{
+    rt_val_push_bool(
+        &rt->stack,
+        rt_val_peek_type(&rt->stack, x_loc) == VAL_SEQ);
+}
+
@@ -0,0 +1,461 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "bif.h"
+#include "bif_detail.h"
+#include "error.h"
+#include "memory.h"
+#include "rt_val.h"
+#include "runtime.h"
+#include "stack.h"
+#include "vec_kernel.h"
+
+/*
+ * The numeric arrays are stored boxed, i.e. each element carries its own
+ * header. However since the arrays are homogenous, the elements of numeric
+ * arrays are laid out with a constant stride, therefore they are cheap to
+ * unbox into a contiguous buffer, process with a vector kernel and box back
+ * into a new array with a single push.
+ */
+
+#define VEC_INT_STRIDE (VAL_HEAD_BYTES + VAL_INT_BYTES)
+#define VEC_REAL_STRIDE (VAL_HEAD_BYTES + VAL_REAL_BYTES)
+#define VEC_BOOL_STRIDE (VAL_HEAD_BYTES + VAL_BOOL_BYTES)
+
+/** Unboxed argument of a vector BIF. */
+struct VecArg {
+    enum ValueType type;
+    bool is_array;
+    int len;
+    VAL_INT_T *ints;
+    VAL_REAL_T *reals;
+};
+
+static void bif_vec_error_arg(int arg, char *func, char *condition)
+{
+    err_push("BIF", "Argument %d of _%s_ %s", arg, func, condition);
+}
+
+static void bif_vec_error_len(char *func)
+{
+    err_push("BIF", "Array arguments of _%s_ must be of equal length", func);
+}
+
+static void bif_vec_free(struct VecArg *arg)
+{
+    mem_free(arg->ints);
+    mem_free(arg->reals);
+    arg->ints = NULL;
+    arg->reals = NULL;
+}
+
+/**
+ * Unboxes a numeric scalar or a numeric array. An empty array is considered
+ * to be an integer array.
+ */
+static bool bif_vec_unbox(
+        struct Runtime *rt,
+        VAL_LOC_T loc,
+        int arg_index,
+        char *func,
+        struct VecArg *arg)
+{
+    int i;
+    char *src;
+    VAL_SIZE_T size;
+    enum ValueType type = rt_val_peek_type(&rt->stack, loc);
+
+    arg->ints = NULL;
+    arg->reals = NULL;
+
+    if (type == VAL_INT || type == VAL_REAL) {
+        arg->type = type;
+        arg->is_array = false;
+        arg->len = 1;
+        if (type == VAL_INT) {
+            arg->ints = mem_malloc(sizeof(*arg->ints));
+            arg->ints[0] = rt_val_peek_int(rt, loc);
+        } else {
+            arg->reals = mem_malloc(sizeof(*arg->reals));
+            arg->reals[0] = rt_val_peek_real(rt, loc);
+        }
+        return true;
+    }
+
+    if (type != VAL_ARRAY) {
+        bif_vec_error_arg(arg_index, func, "must be numeric or a numeric array");
+        return false;
+    }
+
+    arg->is_array = true;
+    size = rt_val_peek_size(&rt->stack, loc);
+    if (size == 0) {
+        arg->type = VAL_INT;
+        arg->len = 0;
+        return true;
+    }
+
+    arg->type = rt_val_peek_type(&rt->stack, rt_val_cpd_first_loc(loc));
+    src = rt->stack.buffer + rt_val_cpd_first_loc(loc) + VAL_HEAD_BYTES;
+
+    switch (arg->type) {
+    case VAL_INT:
+        arg->len = size / VEC_INT_STRIDE;
+        arg->ints = mem_malloc(arg->len * sizeof(*arg->ints));
+        for (i = 0; i < arg->len; ++i) {
+            memcpy(arg->ints + i, src, VAL_INT_BYTES);
+            src += VEC_INT_STRIDE;
+        }
+        return true;
+
+    case VAL_REAL:
+        arg->len = size / VEC_REAL_STRIDE;
+        arg->reals = mem_malloc(arg->len * sizeof(*arg->reals));
+        for (i = 0; i < arg->len; ++i) {
+            memcpy(arg->reals + i, src, VAL_REAL_BYTES);
+            src += VEC_REAL_STRIDE;
+        }
+        return true;
+
+    default:
+        bif_vec_error_arg(arg_index, func, "must be numeric or a numeric array");
+        return false;
+    }
+}
+
+/** Converts an unboxed integer argument to a real one. */
+static void bif_vec_promote(struct VecArg *arg)
+{
+    int i;
+
+    if (arg->type == VAL_REAL) {
+        return;
+    }
+
+    arg->reals = mem_malloc(arg->len * sizeof(*arg->reals));
+    for (i = 0; i < arg->len; ++i) {
+        arg->reals[i] = (VAL_REAL_T)arg->ints[i];
+    }
+    mem_free(arg->ints);
+    arg->ints = NULL;
+    arg->type = VAL_REAL;
+}
+
+/** Repeats the value of a scalar argument to match the given length. */
+static void bif_vec_broadcast(struct VecArg *arg, int len)
+{
+    int i;
+
+    if (arg->is_array) {
+        return;
+    }
+
+    if (arg->type == VAL_INT) {
+        VAL_INT_T value = arg->ints[0];
+        arg->ints = mem_realloc(arg->ints, (len ? len : 1) * sizeof(*arg->ints));
+        for (i = 0; i < len; ++i) {
+            arg->ints[i] = value;
+        }
+    } else {
+        VAL_REAL_T value = arg->reals[0];
+        arg->reals = mem_realloc(arg->reals, (len ? len : 1) * sizeof(*arg->reals));
+        for (i = 0; i < len; ++i) {
+            arg->reals[i] = value;
+        }
+    }
+
+    arg->len = len;
+}
+
+/**
+ * Unboxes the arguments of a binary element-wise BIF and brings them to
+ * a common type and length.
+ */
+static bool bif_vec_unbox_pair(
+        struct Runtime *rt,
+        VAL_LOC_T x_loc,
+        VAL_LOC_T y_loc,
+        char *func,
+        struct VecArg *x,
+        struct VecArg *y)
+{
+    if (!bif_vec_unbox(rt, x_loc, 1, func, x)) {
+        return false;
+    }
+
+    if (!bif_vec_unbox(rt, y_loc, 2, func, y)) {
+        bif_vec_free(x);
+        return false;
+    }
+
+    if (!x->is_array && !y->is_array) {
+        err_push("BIF", "At least one argument of _%s_ must be an array", func);
+        goto error;
+    }
+
+    if (x->is_array && y->is_array && x->len != y->len) {
+        bif_vec_error_len(func);
+        goto error;
+    }
+
+    bif_vec_broadcast(x, y->len);
+    bif_vec_broadcast(y, x->len);
+
+    if (x->type != y->type) {
+        bif_vec_promote(x);
+        bif_vec_promote(y);
+    }
+
+    return true;
+
+error:
+    bif_vec_free(x);
+    bif_vec_free(y);
+    return false;
+}
+
+/** Boxes a buffer of values into an array pushed with a single stack push. */
+static void bif_vec_push_array(
+        struct Runtime *rt,
+        enum ValueType type,
+        void *values,
+        VAL_SIZE_T value_size,
+        int len)
+{
+    int i;
+    VAL_LOC_T size_loc;
+    VAL_HEAD_TYPE_T head_type = (VAL_HEAD_TYPE_T)type;
+    VAL_SIZE_T stride = VAL_HEAD_BYTES + value_size;
+    char *buffer = mem_malloc(len * stride + 1);
+    char *dst = buffer;
+
+    for (i = 0; i < len; ++i) {
+        memcpy(dst, &head_type, VAL_HEAD_TYPE_BYTES);
+        memcpy(dst + VAL_HEAD_TYPE_BYTES, &value_size, VAL_HEAD_SIZE_BYTES);
+        memcpy(dst + VAL_HEAD_BYTES, (char*)values + i * value_size, value_size);
+        dst += stride;
+    }
+
+    rt_val_push_array_init(&rt->stack, &size_loc);
+    stack_push(&rt->stack, len * stride, buffer);
+    rt_val_push_cpd_final(&rt->stack, size_loc, len * stride);
+
+    mem_free(buffer);
+}
+
+static void bif_vec_arythm(
+        struct Runtime *rt,
+        VAL_LOC_T x_loc,
+        VAL_LOC_T y_loc,
+        enum VecOp op,
+        char *func)
+{
+    int i;
+    struct VecArg x, y;
+
+    if (!bif_vec_unbox_pair(rt, x_loc, y_loc, func, &x, &y)) {
+        return;
+    }
+
+    if (x.type == VAL_INT) {
+        if (op == VEC_DIV) {
+            for (i = 0; i < y.len; ++i) {
+                if (y.ints[i] == 0) {
+                    err_push("BIF", "Integer division by zero in _%s_", func);
+                    goto cleanup;
+                }
+            }
+        }
+        vec_int_binary(op, x.ints, y.ints, x.ints, x.len);
+        bif_vec_push_array(rt, VAL_INT, x.ints, VAL_INT_BYTES, x.len);
+    } else {
+        vec_real_binary(op, x.reals, y.reals, x.reals, x.len);
+        bif_vec_push_array(rt, VAL_REAL, x.reals, VAL_REAL_BYTES, x.len);
+    }
+
+cleanup:
+    bif_vec_free(&x);
+    bif_vec_free(&y);
+}
+
+static void bif_vec_compare(
+        struct Runtime *rt,
+        VAL_LOC_T x_loc,
+        VAL_LOC_T y_loc,
+        bool less,
+        char *func)
+{
+    struct VecArg x, y;
+    VAL_BOOL_T *result;
+
+    if (!bif_vec_unbox_pair(rt, x_loc, y_loc, func, &x, &y)) {
+        return;
+    }
+
+    result = mem_malloc(x.len + 1);
+    if (x.type == VAL_INT) {
+        if (less) {
+            vec_int_lt(x.ints, y.ints, result, x.len);
+        } else {
+            vec_int_eq(x.ints, y.ints, result, x.len);
+        }
+    } else {
+        if (less) {
+            vec_real_lt(x.reals, y.reals, result, x.len);
+        } else {
+            vec_real_eq(x.reals, y.reals, result, x.len);
+        }
+    }
+    bif_vec_push_array(rt, VAL_BOOL, result, VAL_BOOL_BYTES, x.len);
+
+    mem_free(result);
+    bif_vec_free(&x);
+    bif_vec_free(&y);
+}
+
+/** Unboxes the argument of a BIF reducing or scanning an array. */
+static bool bif_vec_unbox_array(
+        struct Runtime *rt,
+        VAL_LOC_T x_loc,
+        char *func,
+        bool non_empty,
+        struct VecArg *x)
+{
+    if (!bif_vec_unbox(rt, x_loc, 1, func, x)) {
+        return false;
+    }
+
+    if (!x->is_array) {
+        bif_vec_error_arg(1, func, "must be a numeric array");
+        bif_vec_free(x);
+        return false;
+    }
+
+    if (non_empty && x->len == 0) {
+        bif_vec_error_arg(1, func, "must not be empty");
+        bif_vec_free(x);
+        return false;
+    }
+
+    return true;
+}
+
+void bif_vec_add(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc)
+{
+    bif_vec_arythm(rt, x_loc, y_loc, VEC_ADD, "vec_add");
+}
+
+void bif_vec_sub(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc)
+{
+    bif_vec_arythm(rt, x_loc, y_loc, VEC_SUB, "vec_sub");
+}
+
+void bif_vec_mul(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc)
+{
+    bif_vec_arythm(rt, x_loc, y_loc, VEC_MUL, "vec_mul");
+}
+
+void bif_vec_div(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc)
+{
+    bif_vec_arythm(rt, x_loc, y_loc, VEC_DIV, "vec_div");
+}
+
+void bif_vec_eq(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc)
+{
+    bif_vec_compare(rt, x_loc, y_loc, false, "vec_eq");
+}
+
+void bif_vec_lt(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc)
+{
+    bif_vec_compare(rt, x_loc, y_loc, true, "vec_lt");
+}
+
+void bif_vec_sum(struct Runtime *rt, VAL_LOC_T x_loc)
+{
+    struct VecArg x;
+
+    if (!bif_vec_unbox_array(rt, x_loc, "vec_sum", false, &x)) {
+        return;
+    }
+
+    if (x.type == VAL_INT) {
+        rt_val_push_int(&rt->stack, vec_int_sum(x.ints, x.len));
+    } else {
+        rt_val_push_real(&rt->stack, vec_real_sum(x.reals, x.len));
+    }
+
+    bif_vec_free(&x);
+}
+
+void bif_vec_min(struct Runtime *rt, VAL_LOC_T x_loc)
+{
+    struct VecArg x;
+
+    if (!bif_vec_unbox_array(rt, x_loc, "vec_min", true, &x)) {
+        return;
+    }
+
+    if (x.type == VAL_INT) {
+        rt_val_push_int(&rt->stack, vec_int_min(x.ints, x.len));
+    } else {
+        rt_val_push_real(&rt->stack, vec_real_min(x.reals, x.len));
+    }
+
+    bif_vec_free(&x);
+}
+
+void bif_vec_max(struct Runtime *rt, VAL_LOC_T x_loc)
+{
+    struct VecArg x;
+
+    if (!bif_vec_unbox_array(rt, x_loc, "vec_max", true, &x)) {
+        return;
+    }
+
+    if (x.type == VAL_INT) {
+        rt_val_push_int(&rt->stack, vec_int_max(x.ints, x.len));
+    } else {
+        rt_val_push_real(&rt->stack, vec_real_max(x.reals, x.len));
+    }
+
+    bif_vec_free(&x);
+}
+
+void bif_vec_dot(struct Runtime *rt, VAL_LOC_T x_loc, VAL_LOC_T y_loc)
+{
+    struct VecArg x, y;
+
+    if (!bif_vec_unbox_pair(rt, x_loc, y_loc, "vec_dot", &x, &y)) {
+        return;
+    }
+
+    if (x.type == VAL_INT) {
+        rt_val_push_int(&rt->stack, vec_int_dot(x.ints, y.ints, x.len));
+    } else {
+        rt_val_push_real(&rt->stack, vec_real_dot(x.reals, y.reals, x.len));
+    }
+
+    bif_vec_free(&x);
+    bif_vec_free(&y);
+}
+
+void bif_vec_scan(struct Runtime *rt, VAL_LOC_T x_loc)
+{
+    struct VecArg x;
+
+    if (!bif_vec_unbox_array(rt, x_loc, "vec_scan", false, &x)) {
+        return;
+    }
+
+    if (x.type == VAL_INT) {
+        vec_int_scan(x.ints, x.ints, x.len);
+        bif_vec_push_array(rt, VAL_INT, x.ints, VAL_INT_BYTES, x.len);
+    } else {
+        vec_real_scan(x.reals, x.reals, x.len);
+        bif_vec_push_array(rt, VAL_REAL, x.reals, VAL_REAL_BYTES, x.len);
+    }
+
+    bif_vec_free(&x);
+}
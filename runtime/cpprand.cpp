@@ -6,49 +6,181 @@
 
 #include "rt_val.h"
 
+extern "C" {
+#include "cpprand.h"
+}
+
 namespace {
-    std::random_device device;
-    std::mt19937 generator(device());
+
+    const uint32_t philox_m0 = 0xD2511F53;
+    const uint32_t philox_m1 = 0xCD9E8D57;
+    const uint32_t philox_w0 = 0x9E3779B9;
+    const uint32_t philox_w1 = 0xBB67AE85;
+    const int philox_rounds = 10;
+
+    void mulhilo(uint32_t a, uint32_t b, uint32_t &hi, uint32_t &lo)
+    {
+        uint64_t product = (uint64_t)a * (uint64_t)b;
+        hi = (uint32_t)(product >> 32);
+        lo = (uint32_t)product;
+    }
+
+    void philox_block(const uint32_t *counter, const uint32_t *key, uint32_t *out)
+    {
+        uint32_t c[4] = { counter[0], counter[1], counter[2], counter[3] };
+        uint32_t k[2] = { key[0], key[1] };
+        uint32_t hi0, lo0, hi1, lo1;
+
+        for (int i = 0; i < philox_rounds; ++i) {
+            mulhilo(philox_m0, c[0], hi0, lo0);
+            mulhilo(philox_m1, c[2], hi1, lo1);
+            c[0] = hi1 ^ c[1] ^ k[0];
+            c[1] = lo1;
+            c[2] = hi0 ^ c[3] ^ k[1];
+            c[3] = lo0;
+            k[0] += philox_w0;
+            k[1] += philox_w1;
+        }
+
+        out[0] = c[0];
+        out[1] = c[1];
+        out[2] = c[2];
+        out[3] = c[3];
+    }
+
+    /**
+     * Adapts the C generator state to the UniformRandomBitGenerator concept
+     * so that it may be used with the standard distributions.
+     */
+    class Philox {
+        CppRand *rand;
+
+    public:
+        typedef uint32_t result_type;
+
+        explicit Philox(CppRand *rand) : rand(rand) {}
+
+        static constexpr result_type min() { return 0; }
+        static constexpr result_type max() { return UINT32_MAX; }
+
+        result_type operator()()
+        {
+            if (rand->block_used == 4) {
+                philox_block(rand->counter, rand->key, rand->block);
+                rand->block_used = 0;
+                /* Only the lower half of the counter advances, the upper
+                 * half identifies the stream. */
+                if (++rand->counter[0] == 0) {
+                    ++rand->counter[1];
+                }
+            }
+            return rand->block[rand->block_used++];
+        }
+    };
+
+    template <class Distribution, class T>
+    void fill(CppRand *rand, Distribution distribution, T *out, int count)
+    {
+        Philox generator(rand);
+        for (int i = 0; i < count; ++i) {
+            out[i] = distribution(generator);
+        }
+    }
 }
 
 extern "C" {
 
-VAL_INT_T cpprand_ui(VAL_INT_T lo, VAL_INT_T hi)
+void cpprand_init(struct CppRand *rand)
 {
+    std::random_device device;
+    uint64_t seed = ((uint64_t)device() << 32) | device();
+    cpprand_seed(rand, seed, 0);
+}
+
+void cpprand_seed(struct CppRand *rand, uint64_t seed, uint64_t stream)
+{
+    rand->key[0] = (uint32_t)seed;
+    rand->key[1] = (uint32_t)(seed >> 32);
+    rand->counter[0] = 0;
+    rand->counter[1] = 0;
+    rand->counter[2] = (uint32_t)stream;
+    rand->counter[3] = (uint32_t)(stream >> 32);
+    rand->block_used = 4;
+}
+
+uint64_t cpprand_bits(struct CppRand *rand)
+{
+    Philox generator(rand);
+    uint64_t high = generator();
+    return (high << 32) | generator();
+}
+
+VAL_INT_T cpprand_ui(struct CppRand *rand, VAL_INT_T lo, VAL_INT_T hi)
+{
+    Philox generator(rand);
     std::uniform_int_distribution<VAL_INT_T> distribution(lo, hi);
     return distribution(generator);
 }
 
-VAL_REAL_T cpprand_ur(VAL_REAL_T lo, VAL_REAL_T hi)
+VAL_REAL_T cpprand_ur(struct CppRand *rand, VAL_REAL_T lo, VAL_REAL_T hi)
 {
+    Philox generator(rand);
     std::uniform_real_distribution<VAL_REAL_T> distribution(lo, hi);
     return distribution(generator);
 }
 
-VAL_BOOL_T cpprand_ber(VAL_REAL_T p)
+VAL_BOOL_T cpprand_ber(struct CppRand *rand, VAL_REAL_T p)
 {
+    Philox generator(rand);
     std::bernoulli_distribution distribution(p);
     return distribution(generator);
 }
 
-VAL_REAL_T cpprand_exp(VAL_REAL_T l)
+VAL_REAL_T cpprand_exp(struct CppRand *rand, VAL_REAL_T l)
 {
+    Philox generator(rand);
     std::exponential_distribution<VAL_REAL_T> distribution(l);
     return distribution(generator);
 }
 
-VAL_REAL_T cpprand_gauss(VAL_REAL_T u, VAL_REAL_T s)
+VAL_REAL_T cpprand_gauss(struct CppRand *rand, VAL_REAL_T u, VAL_REAL_T s)
 {
+    Philox generator(rand);
     std::normal_distribution<VAL_REAL_T> distribution(u, s);
     return distribution(generator);
 }
 
-VAL_INT_T cpprand_distr(VAL_REAL_T *dens_values, int dens_count)
+VAL_INT_T cpprand_distr(struct CppRand *rand, VAL_REAL_T *dens_values, int dens_count)
 {
+    Philox generator(rand);
     std::discrete_distribution<VAL_INT_T> distribution(dens_values, dens_values + dens_count);
     return distribution(generator);
 }
 
+void cpprand_fill_ui(struct CppRand *rand, VAL_INT_T lo, VAL_INT_T hi, VAL_INT_T *out, int count)
+{
+    fill(rand, std::uniform_int_distribution<VAL_INT_T>(lo, hi), out, count);
+}
 
+void cpprand_fill_ur(struct CppRand *rand, VAL_REAL_T lo, VAL_REAL_T hi, VAL_REAL_T *out, int count)
+{
+    fill(rand, std::uniform_real_distribution<VAL_REAL_T>(lo, hi), out, count);
 }
 
+void cpprand_fill_ber(struct CppRand *rand, VAL_REAL_T p, VAL_BOOL_T *out, int count)
+{
+    fill(rand, std::bernoulli_distribution(p), out, count);
+}
+
+void cpprand_fill_exp(struct CppRand *rand, VAL_REAL_T l, VAL_REAL_T *out, int count)
+{
+    fill(rand, std::exponential_distribution<VAL_REAL_T>(l), out, count);
+}
+
+void cpprand_fill_gauss(struct CppRand *rand, VAL_REAL_T u, VAL_REAL_T s, VAL_REAL_T *out, int count)
+{
+    fill(rand, std::normal_distribution<VAL_REAL_T>(u, s), out, count);
+}
+
+
+}
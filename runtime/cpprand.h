@@ -3,13 +3,46 @@
 #ifndef CPPRAND_H
 #define CPPRAND_H
 
+#include <stdint.h>
+
 #include "rt_val.h"
 
-VAL_INT_T cpprand_ui(VAL_INT_T lo, VAL_INT_T hi);
-VAL_REAL_T cpprand_ur(VAL_REAL_T lo, VAL_REAL_T hi);
-VAL_BOOL_T cpprand_ber(VAL_REAL_T p);
-VAL_REAL_T cpprand_exp(VAL_REAL_T l);
-VAL_REAL_T cpprand_gauss(VAL_REAL_T u, VAL_REAL_T s);
-VAL_INT_T cpprand_distr(VAL_REAL_T *dens_values, int dens_count);
+/**
+ * State of a Philox4x32-10 counter-based generator. Every block of random
+ * bits is a pure function of the key and the counter, therefore a generator
+ * is fully described by the seed, the stream and the number of blocks drawn.
+ * Distinct streams of the same seed are independent of each other, so that
+ * parallel workers may draw reproducible numbers without sharing any state.
+ */
+struct CppRand {
+    uint32_t key[2];
+    uint32_t counter[4];
+    uint32_t block[4];
+    int block_used;
+};
+
+void cpprand_init(struct CppRand *rand);
+void cpprand_seed(struct CppRand *rand, uint64_t seed, uint64_t stream);
+
+/** Draws 64 raw bits, e.g. to seed other generators. */
+uint64_t cpprand_bits(struct CppRand *rand);
+
+VAL_INT_T cpprand_ui(struct CppRand *rand, VAL_INT_T lo, VAL_INT_T hi);
+VAL_REAL_T cpprand_ur(struct CppRand *rand, VAL_REAL_T lo, VAL_REAL_T hi);
+VAL_BOOL_T cpprand_ber(struct CppRand *rand, VAL_REAL_T p);
+VAL_REAL_T cpprand_exp(struct CppRand *rand, VAL_REAL_T l);
+VAL_REAL_T cpprand_gauss(struct CppRand *rand, VAL_REAL_T u, VAL_REAL_T s);
+VAL_INT_T cpprand_distr(struct CppRand *rand, VAL_REAL_T *dens_values, int dens_count);
+
+/*
+ * The fill functions draw a number of values from a single distribution
+ * object, which saves its setup per value and lets the normal distribution
+ * use both values of each pair it generates.
+ */
+void cpprand_fill_ui(struct CppRand *rand, VAL_INT_T lo, VAL_INT_T hi, VAL_INT_T *out, int count);
+void cpprand_fill_ur(struct CppRand *rand, VAL_REAL_T lo, VAL_REAL_T hi, VAL_REAL_T *out, int count);
+void cpprand_fill_ber(struct CppRand *rand, VAL_REAL_T p, VAL_BOOL_T *out, int count);
+void cpprand_fill_exp(struct CppRand *rand, VAL_REAL_T l, VAL_REAL_T *out, int count);
+void cpprand_fill_gauss(struct CppRand *rand, VAL_REAL_T u, VAL_REAL_T s, VAL_REAL_T *out, int count);
 
 #endif
@@ -55,26 +55,30 @@ VAL_LOC_T eval_dispatch(
         debug_begin_called = true;
     }
 
-    switch (node->type) {
-    case AST_SYMBOL:
-        eval_symbol(node, rt, sym_map, alm);
-        break;
-
-    case AST_SPECIAL:
-        eval_special(node, rt, sym_map, alm);
-        break;
-
-    case AST_FUNCTION_CALL:
-        eval_func_call(node, rt, sym_map, alm);
-        break;
-
-    case AST_LITERAL_COMPOUND:
-        eval_literal_compound(node, rt, sym_map, alm);
-        break;
-
-    case AST_LITERAL_ATOMIC:
-        eval_literal_atomic(node, rt, sym_map, alm);
-        break;
+    /* The budget is only checked in full when the countdown runs out. */
+    if ((--rt->budget.countdown > 0 && rt->stack.top <= rt->budget.stack_max) ||
+        rt_budget_check(rt)) {
+        switch (node->type) {
+        case AST_SYMBOL:
+            eval_symbol(node, rt, sym_map, alm);
+            break;
+
+        case AST_SPECIAL:
+            eval_special(node, rt, sym_map, alm);
+            break;
+
+        case AST_FUNCTION_CALL:
+            eval_func_call(node, rt, sym_map, alm);
+            break;
+
+        case AST_LITERAL_COMPOUND:
+            eval_literal_compound(node, rt, sym_map, alm);
+            break;
+
+        case AST_LITERAL_ATOMIC:
+            eval_literal_atomic(node, rt, sym_map, alm);
+            break;
+        }
     }
 
     if (err_state()) {
@@ -115,6 +119,12 @@ VAL_LOC_T eval(
 
     err_reset();
 
+    /* An interrupt may have arrived while the runtime was idle. */
+    if (!rt_check_interrupt(rt)) {
+        LOG_TRACE("eval END(error)");
+        return -1;
+    }
+
     /* The dispatch is delegated to another procedure as it is called
      * recursively during the evaluation while the current function is only
      * called by the top-level client.
@@ -157,3 +167,23 @@ VAL_LOC_T eval_clif(struct Runtime *rt, void *impl, VAL_SIZE_T arity)
     return result_loc;
 }
 
+VAL_LOC_T eval_async_clif(struct Runtime *rt, void *impl, VAL_SIZE_T arity)
+{
+    VAL_LOC_T size_loc, data_begin, result_loc = rt->stack.top;
+    rt_val_push_func_init(&rt->stack, &size_loc, &data_begin, arity, VAL_FUNC_ASYNC_CLIF, impl);
+    rt_val_push_func_cap_init(&rt->stack, 0);
+    rt_val_push_func_appl_init(&rt->stack, 0);
+    rt_val_push_func_final(&rt->stack, size_loc, data_begin);
+    return result_loc;
+}
+
+VAL_LOC_T eval_direct_clif(struct Runtime *rt, void *impl, VAL_SIZE_T arity)
+{
+    VAL_LOC_T size_loc, data_begin, result_loc = rt->stack.top;
+    rt_val_push_func_init(&rt->stack, &size_loc, &data_begin, arity, VAL_FUNC_DIRECT_CLIF, impl);
+    rt_val_push_func_cap_init(&rt->stack, 0);
+    rt_val_push_func_appl_init(&rt->stack, 0);
+    rt_val_push_func_final(&rt->stack, size_loc, data_begin);
+    return result_loc;
+}
+
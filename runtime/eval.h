@@ -9,6 +9,8 @@
 
 #include <stddef.h>
 
+struct MoonValue;
+
 VAL_LOC_T eval(
     struct AstNode *node,
     struct Runtime *rt,
@@ -18,5 +20,85 @@ VAL_LOC_T eval(
 VAL_LOC_T eval_bif(struct Runtime *rt, void *impl, VAL_SIZE_T arity);
 
 VAL_LOC_T eval_clif(struct Runtime *rt, void *impl, VAL_SIZE_T arity);
+VAL_LOC_T eval_async_clif(struct Runtime *rt, void *impl, VAL_SIZE_T arity);
+VAL_LOC_T eval_direct_clif(struct Runtime *rt, void *impl, VAL_SIZE_T arity);
+
+/**
+ * A call of a function value with arguments that are already on the stack.
+ * It is meant for calling the same function many times, e.g. a comparator
+ * passed to a BIF, therefore the scope of the captures is only established
+ * once, upon the initialization.
+ */
+struct EvalCall {
+    struct Runtime *rt;
+    struct SymMap *sym_map;
+    struct AstLocMap *alm;
+    struct ValueFuncData func_data;
+    struct SymMap captures_sym_map;
+    VAL_LOC_T *arg_locs;
+    int arg_count;
+};
+
+/** Prepares the call of a function expecting exactly arg_count arguments. */
+bool eval_call_init(
+    struct EvalCall *call,
+    struct Runtime *rt,
+    struct SymMap *sym_map,
+    struct AstLocMap *alm,
+    VAL_LOC_T func_loc,
+    int arg_count);
+
+/**
+ * Performs the call, pushing the result onto the stack. The result may only
+ * be used until the stack is cleaned up to the location from before the call.
+ */
+VAL_LOC_T eval_call(struct EvalCall *call, VAL_LOC_T *arg_locs);
+
+void eval_call_deinit(struct EvalCall *call);
+
+/** Pushes a value passed by the client, e.g. the result of a CLIF. */
+void eval_push_client_result(struct Runtime *rt, struct MoonValue *value);
+
+/**
+ * An iterator over the elements of a lazy sequence or of a compound value.
+ * The elements are generated on demand, each one is either located within
+ * the iterated value or pushed onto the stack. Once an element has been
+ * consumed the stack may be cleaned up to the location from before the call
+ * to eval_seq_next that returned it.
+ */
+struct EvalSeq {
+    struct Runtime *rt;
+    enum ValueSeqKind kind;
+    VAL_LOC_T current_loc;
+    VAL_INT_T current;
+    VAL_INT_T remaining;
+    bool has_call;
+    struct EvalCall call;
+    struct EvalSeq *sources[2];
+};
+
+/** Prepares the iteration over a sequence or a compound value. */
+bool eval_seq_init(
+    struct EvalSeq *seq,
+    struct Runtime *rt,
+    struct SymMap *sym_map,
+    struct AstLocMap *alm,
+    VAL_LOC_T loc);
+
+/**
+ * Produces the next element. Returns false when the sequence is exhausted,
+ * leaving the stack intact, or when an element could not be generated, the
+ * error state tells these apart.
+ */
+bool eval_seq_next(struct EvalSeq *seq, VAL_LOC_T *elem_loc);
+
+/**
+ * Places a copy of the element just returned by eval_seq_next at the given
+ * location, which must be the stack top from before that call, and cleans
+ * up the stack above it.
+ */
+void eval_seq_keep(struct EvalSeq *seq, VAL_LOC_T dst_loc, VAL_LOC_T elem_loc);
+
+void eval_seq_deinit(struct EvalSeq *seq);
 
 #endif
@@ -60,6 +60,18 @@ void eval_special_function_type(
     struct SymMap *sym_map,
     struct AstLocMap *alm);
 
+void eval_special_pipeline(
+    struct AstNode *node,
+    struct Runtime *rt,
+    struct SymMap *sym_map,
+    struct AstLocMap *alm);
+
+void eval_special_par(
+    struct AstNode *node,
+    struct Runtime *rt,
+    struct SymMap *sym_map,
+    struct AstLocMap *alm);
+
 void eval_special_type_op(
     struct AstNode *node,
     struct Runtime *rt,
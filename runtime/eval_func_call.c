@@ -1,13 +1,18 @@
 /* Copyright (C) 2014-2016 Krzysztof Stachowiak */
 
+#include <string.h>
+
 #include "ast.h"
 #include "bif.h"
 #include "error.h"
 #include "collection.h"
+#include "eval.h"
 #include "rt_val.h"
 #include "symmap.h"
 #include "eval_detail.h"
+#include "api_call.h"
 #include "api_value.h"
+#include "task.h"
 
 struct LocArray { VAL_LOC_T *data; int size, cap; };
 
@@ -154,6 +159,10 @@ static void efc_evaluate_ast(
 
     struct AstNode *formal_args = fdef->formal_args;
 
+    if (!rt_check_interrupt(rt)) {
+        return;
+    }
+
     /* Initialize local scopes hierarchy. */
     sym_map_init_local(&captures_sym_map, sym_map);
     sym_map_init_local(&args_sym_map, &captures_sym_map);
@@ -212,6 +221,31 @@ cleanup:
     sym_map_deinit(&captures_sym_map);
 }
 
+/** Calls a BIF implementation on the provided argument locations. */
+static void efc_call_bif(
+        struct Runtime *rt,
+        struct ValueFuncData *func_data,
+        VAL_LOC_T *arg_locs)
+{
+    switch (func_data->arity) {
+    case 0:
+        ((bif_nullary_func)func_data->impl)(rt);
+        break;
+
+    case 1:
+        ((bif_unary_func)func_data->impl)(rt, arg_locs[0]);
+        break;
+
+    case 2:
+        ((bif_binary_func)func_data->impl)(rt, arg_locs[0], arg_locs[1]);
+        break;
+
+    case 3:
+        ((bif_ternary_func)func_data->impl)(rt, arg_locs[0], arg_locs[1], arg_locs[2]);
+        break;
+    }
+}
+
 /** Evaluates a BIF. */
 static void efc_evaluate_bif(
         struct Runtime *rt,
@@ -222,6 +256,7 @@ static void efc_evaluate_bif(
 {
     struct LocArray arg_locs = { NULL, 0, 0 };
     VAL_LOC_T temp_begin, temp_end;
+    struct BifCall bif_call, *outer_bif_call = rt->bif_call;
 
     efc_get_already_applied_locs(rt, func_data, &arg_locs);
 
@@ -231,6 +266,12 @@ static void efc_evaluate_bif(
     }
     temp_end = rt->stack.top;
 
+    bif_call.temp_begin = temp_begin;
+    bif_call.temp_consumed = false;
+    bif_call.sym_map = sym_map;
+    bif_call.alm = alm;
+    rt->bif_call = &bif_call;
+
     if (arg_locs.size > BIF_MAX_ARITY) {
         LOG_ERROR("Argument count mismatch.\n");
         exit(1);
@@ -241,23 +282,15 @@ static void efc_evaluate_bif(
     }
 
     /* Evaluate the function implementation. */
-    switch (func_data->arity) {
-    case 1:
-        ((bif_unary_func)func_data->impl)(rt, arg_locs.data[0]);
-        break;
+    efc_call_bif(rt, func_data, arg_locs.data);
 
-    case 2:
-        ((bif_binary_func)func_data->impl)(rt, arg_locs.data[0], arg_locs.data[1]);
-        break;
+    rt->bif_call = outer_bif_call;
 
-    case 3:
-        ((bif_ternary_func)func_data->impl)(rt, arg_locs.data[0], arg_locs.data[1], arg_locs.data[2]);
-        break;
+    /* Collapse the temporaries unless they have become the result. */
+    if (!bif_call.temp_consumed) {
+        stack_collapse(&rt->stack, temp_begin, temp_end);
     }
 
-    /* Collapse the temporaries. */
-    stack_collapse(&rt->stack, temp_begin, temp_end);
-
 cleanup:
     ARRAY_FREE(arg_locs);
 }
@@ -273,7 +306,54 @@ static struct MoonValue *efc_eval_client_args(struct Runtime *rt, VAL_LOC_T *arg
     return result;
 }
 
-static void efc_push_client_result(struct Runtime *rt, struct MoonValue *value)
+static void efc_push_client_dict(struct Runtime *rt, struct MoonValue *entry)
+{
+    int count = 0;
+    VAL_LOC_T dict_loc, key_loc;
+    struct MoonValue *current;
+
+    for (current = entry; current; current = current->next) {
+        ++count;
+    }
+
+    rt_val_push_dict_init(
+        &rt->stack,
+        rt_val_dict_capacity_for(count),
+        &dict_loc);
+
+    for (; entry; entry = entry->next) {
+        struct MoonValue *key = entry->data.compound;
+
+        if (entry->type != MN_TUPLE || !key || !key->next || key->next->next) {
+            err_push("EVAL", "CLIF returned a dictionary entry which is not a pair");
+            return;
+        }
+
+        key_loc = rt->stack.top;
+        eval_push_client_result(rt, key);
+        eval_push_client_result(rt, key->next);
+        if (err_state()) {
+            return;
+        }
+
+        if (!rt_val_is_hashable(rt, key_loc)) {
+            err_push("EVAL", "CLIF returned a dictionary with a non-hashable key");
+            return;
+        }
+
+        if (rt_val_dict_find(&rt->stack, dict_loc, key_loc) != -1) {
+            err_push("EVAL", "CLIF returned a dictionary with a duplicate key");
+            return;
+        }
+
+        if (!rt_val_dict_adopt_entry(&rt->stack, dict_loc, key_loc)) {
+            err_push("EVAL", "CLIF returned a dictionary too large to be stored");
+            return;
+        }
+    }
+}
+
+void eval_push_client_result(struct Runtime *rt, struct MoonValue *value)
 {
     VAL_LOC_T size_loc, data_begin, data_end;
     struct MoonValue *child = value->data.compound;
@@ -306,7 +386,7 @@ static void efc_push_client_result(struct Runtime *rt, struct MoonValue *value)
         rt_val_push_array_init(&rt->stack, &size_loc);
         data_begin = rt->stack.top;
         while (child) {
-            efc_push_client_result(rt, child);
+            eval_push_client_result(rt, child);
             child = child->next;
         }
         data_end = rt->stack.top;
@@ -317,13 +397,17 @@ static void efc_push_client_result(struct Runtime *rt, struct MoonValue *value)
         rt_val_push_tuple_init(&rt->stack, &size_loc);
         data_begin = rt->stack.top;
         while (child) {
-            efc_push_client_result(rt, child);
+            eval_push_client_result(rt, child);
             child = child->next;
         }
         data_end = rt->stack.top;
         rt_val_push_cpd_final(&rt->stack, size_loc, data_end - data_begin);
         break;
 
+    case MN_DICT:
+        efc_push_client_dict(rt, child);
+        break;
+
     case MN_UNIT:
         rt_val_push_unit(&rt->stack);
         break;
@@ -335,6 +419,93 @@ static void efc_push_client_result(struct Runtime *rt, struct MoonValue *value)
     case MN_REFERENCE:
         err_push("EVAL", "CLIF returned a pointer");
         break;
+
+    case MN_SEQUENCE:
+        err_push("EVAL", "CLIF returned a sequence");
+        break;
+
+    case MN_SAMPLER:
+        err_push("EVAL", "CLIF returned a sampler");
+        break;
+
+    case MN_CHANNEL:
+        err_push("EVAL", "CLIF returned a channel");
+        break;
+    }
+}
+
+/** Calls a CLIF handler on the provided argument locations. */
+static void efc_call_clif(
+        struct Runtime *rt,
+        ClifHandler handler,
+        VAL_LOC_T *arg_locs,
+        int arg_count)
+{
+    struct MoonValue *client_args, *client_result;
+
+    client_args = efc_eval_client_args(rt, arg_locs, arg_count);
+    client_result = handler(client_args);
+    mn_api_value_free(client_args);
+
+    if (client_result) {
+        eval_push_client_result(rt, client_result);
+        mn_api_value_free(client_result);
+    }
+}
+
+/**
+ * Calls an asynchronous CLIF handler and suspends the task until the host
+ * resumes it with the result.
+ */
+static void efc_call_async_clif(
+        struct Runtime *rt,
+        AsyncClifHandler handler,
+        VAL_LOC_T *arg_locs,
+        int arg_count)
+{
+    struct MoonTask *task = rt->task;
+    struct MoonValue *client_args, *client_result;
+
+    if (!task) {
+        err_push("EVAL", "Asynchronous CLIF called outside of a task");
+        return;
+    }
+
+    client_args = efc_eval_client_args(rt, arg_locs, arg_count);
+    handler(task, client_args);
+    mn_api_value_free(client_args);
+
+    if (!task_await(task, &client_result)) {
+        return;
+    }
+
+    if (client_result) {
+        eval_push_client_result(rt, client_result);
+        mn_api_value_free(client_result);
+    } else {
+        rt_val_push_unit(&rt->stack);
+    }
+}
+
+/** Calls any kind of CLIF. */
+static void efc_call_any_clif(
+        struct Runtime *rt,
+        struct ValueFuncData *func_data,
+        VAL_LOC_T *arg_locs,
+        int arg_count)
+{
+    switch (func_data->func_type) {
+    case VAL_FUNC_ASYNC_CLIF:
+        efc_call_async_clif(rt, (AsyncClifHandler)func_data->impl, arg_locs, arg_count);
+        break;
+
+    case VAL_FUNC_DIRECT_CLIF:
+        api_call_direct(rt, (DirectClifHandler)func_data->impl, arg_locs, arg_count);
+        break;
+
+    default:
+        efc_call_clif(rt, (ClifHandler)func_data->impl, arg_locs, arg_count);
+        break;
     }
 }
 
@@ -348,8 +519,6 @@ static void efc_evaluate_clif(
 {
     struct LocArray arg_locs = { NULL, 0, 0 };
     VAL_LOC_T temp_begin, temp_end;
-    struct MoonValue *client_args, *client_result;
-    ClifHandler handler = (ClifHandler)func_data->impl;
 
     efc_get_already_applied_locs(rt, func_data, &arg_locs);
 
@@ -359,14 +528,7 @@ static void efc_evaluate_clif(
     }
     temp_end = rt->stack.top;
 
-    client_args = efc_eval_client_args(rt, arg_locs.data, arg_locs.size);
-    client_result = handler(client_args);
-    mn_api_value_free(client_args);
-
-    if (client_result) {
-        efc_push_client_result(rt, client_result);
-        mn_api_value_free(client_result);
-    }
+    efc_call_any_clif(rt, func_data, arg_locs.data, arg_locs.size);
 
     stack_collapse(&rt->stack, temp_begin, temp_end);
 
@@ -425,6 +587,8 @@ void eval_func_call(
             break;
 
         case VAL_FUNC_CLIF:
+        case VAL_FUNC_ASYNC_CLIF:
+        case VAL_FUNC_DIRECT_CLIF:
             efc_evaluate_clif(rt, sym_map, actual_args, &func_data, alm);
             break;
         }
@@ -437,3 +601,131 @@ void eval_func_call(
     stack_collapse(&rt->stack, temp_begin, temp_end);
 }
 
+
+bool eval_call_init(
+        struct EvalCall *call,
+        struct Runtime *rt,
+        struct SymMap *sym_map,
+        struct AstLocMap *alm,
+        VAL_LOC_T func_loc,
+        int arg_count)
+{
+    VAL_SIZE_T i;
+    VAL_LOC_T current_loc;
+    struct ValueFuncData *func_data = &call->func_data;
+
+    if (rt_val_peek_type(&rt->stack, func_loc) != VAL_FUNCTION) {
+        err_push("EVAL", "Attempted calling a non-function value");
+        return false;
+    }
+
+    *func_data = rt_val_function_data(rt, func_loc);
+    if (func_data->appl_count + arg_count != func_data->arity) {
+        err_push(
+            "EVAL",
+            "Function of arity %d called with %d argument(s)",
+            func_data->arity - func_data->appl_count,
+            arg_count);
+        return false;
+    }
+
+    call->rt = rt;
+    call->sym_map = sym_map;
+    call->alm = alm;
+    call->arg_count = arg_count;
+    call->arg_locs = mem_malloc((func_data->arity + 1) * sizeof(*call->arg_locs));
+
+    current_loc = func_data->appl_start;
+    for (i = 0; i < func_data->appl_count; ++i) {
+        call->arg_locs[i] = current_loc;
+        current_loc = rt_val_fun_next_appl_loc(rt, current_loc);
+    }
+
+    sym_map_init_local(&call->captures_sym_map, sym_map);
+    current_loc = func_data->cap_start;
+    for (i = 0; i < func_data->cap_count; ++i) {
+        sym_map_insert(
+            &call->captures_sym_map,
+            rt_val_peek_fun_cap_symbol(rt, current_loc),
+            rt_val_fun_cap_loc(rt, current_loc));
+        current_loc = rt_val_fun_next_cap_loc(rt, current_loc);
+    }
+
+    return true;
+}
+
+static void efc_call_ast(struct EvalCall *call)
+{
+    VAL_SIZE_T i;
+    struct SymMap args_sym_map;
+    struct Runtime *rt = call->rt;
+    struct AstNode *node = (struct AstNode *)call->func_data.impl;
+    struct AstSpecFuncDef *fdef = &node->data.special.data.func_def;
+    struct AstNode *formal_args = fdef->formal_args;
+
+    if (!rt_check_interrupt(rt)) {
+        return;
+    }
+
+    sym_map_init_local(&args_sym_map, &call->captures_sym_map);
+
+    for (i = 0; i < call->func_data.arity; ++i) {
+        eval_special_bind_pattern(
+            formal_args, call->arg_locs[i],
+            rt, &args_sym_map, call->alm);
+        if (err_state()) {
+            err_push("EVAL", "Failed binding function arguments");
+            goto cleanup;
+        }
+        formal_args = formal_args->next;
+    }
+
+    eval_dispatch(fdef->expr, rt, &args_sym_map, call->alm);
+
+cleanup:
+    sym_map_deinit(&args_sym_map);
+}
+
+VAL_LOC_T eval_call(struct EvalCall *call, VAL_LOC_T *arg_locs)
+{
+    struct Runtime *rt = call->rt;
+    struct ValueFuncData *func_data = &call->func_data;
+    struct BifCall bif_call, *outer_bif_call = rt->bif_call;
+    VAL_LOC_T result_loc = rt->stack.top;
+
+    memcpy(
+        call->arg_locs + func_data->appl_count,
+        arg_locs,
+        call->arg_count * sizeof(*arg_locs));
+
+    switch (func_data->func_type) {
+    case VAL_FUNC_AST:
+        efc_call_ast(call);
+        break;
+
+    case VAL_FUNC_BIF:
+        /* None of the arguments is a temporary of this call. */
+        bif_call.temp_begin = -1;
+        bif_call.temp_consumed = false;
+        bif_call.sym_map = call->sym_map;
+        bif_call.alm = call->alm;
+        rt->bif_call = &bif_call;
+        efc_call_bif(rt, func_data, call->arg_locs);
+        rt->bif_call = outer_bif_call;
+        break;
+
+    case VAL_FUNC_CLIF:
+    case VAL_FUNC_ASYNC_CLIF:
+    case VAL_FUNC_DIRECT_CLIF:
+        efc_call_any_clif(rt, func_data, call->arg_locs, func_data->arity);
+        break;
+    }
+
+    return result_loc;
+}
+
+void eval_call_deinit(struct EvalCall *call)
+{
+    sym_map_deinit(&call->captures_sym_map);
+    mem_free(call->arg_locs);
+}
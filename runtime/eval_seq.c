@@ -0,0 +1,282 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#include <string.h>
+
+#include "error.h"
+#include "eval.h"
+#include "memory.h"
+#include "rt_val.h"
+#include "runtime.h"
+#include "stack.h"
+
+static bool eval_seq_init_source(
+        struct EvalSeq *seq,
+        int index,
+        struct SymMap *sym_map,
+        struct AstLocMap *alm,
+        VAL_LOC_T loc)
+{
+    struct EvalSeq *source = mem_malloc(sizeof(*source));
+    if (!eval_seq_init(source, seq->rt, sym_map, alm, loc)) {
+        mem_free(source);
+        return false;
+    }
+    seq->sources[index] = source;
+    return true;
+}
+
+static bool eval_seq_init_call(
+        struct EvalSeq *seq,
+        struct SymMap *sym_map,
+        struct AstLocMap *alm,
+        VAL_LOC_T loc,
+        int arg_count)
+{
+    if (!eval_call_init(&seq->call, seq->rt, sym_map, alm, loc, arg_count)) {
+        return false;
+    }
+    seq->has_call = true;
+    return true;
+}
+
+static bool eval_seq_init_params(
+        struct EvalSeq *seq,
+        struct SymMap *sym_map,
+        struct AstLocMap *alm,
+        VAL_LOC_T loc)
+{
+    struct Runtime *rt = seq->rt;
+    VAL_LOC_T param_loc = rt_val_seq_first_loc(loc);
+    VAL_LOC_T next_loc = rt_val_next_loc(rt, param_loc);
+
+    switch (seq->kind) {
+    case VAL_SEQ_CPD:
+        seq->current_loc = rt_val_cpd_first_loc(param_loc);
+        seq->remaining = rt_val_cpd_len(rt, param_loc);
+        return true;
+
+    case VAL_SEQ_RANGE:
+        seq->current = rt_val_peek_int(rt, param_loc);
+        seq->remaining = rt_val_peek_int(rt, next_loc);
+        return true;
+
+    case VAL_SEQ_GEN:
+        seq->remaining = rt_val_peek_int(rt, next_loc);
+        return eval_seq_init_call(seq, sym_map, alm, param_loc, 0);
+
+    case VAL_SEQ_MAP:
+    case VAL_SEQ_FILTER:
+        return eval_seq_init_call(seq, sym_map, alm, param_loc, 1) &&
+            eval_seq_init_source(seq, 0, sym_map, alm, next_loc);
+
+    case VAL_SEQ_TAKE:
+        seq->remaining = rt_val_peek_int(rt, param_loc);
+        return eval_seq_init_source(seq, 0, sym_map, alm, next_loc);
+
+    case VAL_SEQ_ZIP:
+        return eval_seq_init_source(seq, 0, sym_map, alm, param_loc) &&
+            eval_seq_init_source(seq, 1, sym_map, alm, next_loc);
+
+    case VAL_SEQ_ZIP_WITH:
+        return eval_seq_init_call(seq, sym_map, alm, param_loc, 2) &&
+            eval_seq_init_source(seq, 0, sym_map, alm, next_loc) &&
+            eval_seq_init_source(
+                seq, 1, sym_map, alm,
+                rt_val_next_loc(rt, next_loc));
+    }
+
+    return false;
+}
+
+bool eval_seq_init(
+        struct EvalSeq *seq,
+        struct Runtime *rt,
+        struct SymMap *sym_map,
+        struct AstLocMap *alm,
+        VAL_LOC_T loc)
+{
+    enum ValueType type = rt_val_peek_type(&rt->stack, loc);
+
+    seq->rt = rt;
+    seq->has_call = false;
+    seq->sources[0] = NULL;
+    seq->sources[1] = NULL;
+
+    if (type == VAL_ARRAY || type == VAL_TUPLE) {
+        seq->kind = VAL_SEQ_CPD;
+        seq->current_loc = rt_val_cpd_first_loc(loc);
+        seq->remaining = rt_val_cpd_len(rt, loc);
+        return true;
+    }
+
+    if (type != VAL_SEQ) {
+        err_push("EVAL", "Attempted iterating over a non-sequence value");
+        return false;
+    }
+
+    seq->kind = rt_val_peek_seq_kind(rt, loc);
+    if (!eval_seq_init_params(seq, sym_map, alm, loc)) {
+        err_push("EVAL", "Failed initializing a sequence iteration");
+        eval_seq_deinit(seq);
+        return false;
+    }
+
+    return true;
+}
+
+/** Checks the count of a finite sequence, a negative count never runs out. */
+static bool eval_seq_take_one(struct EvalSeq *seq)
+{
+    if (seq->remaining == 0) {
+        return false;
+    }
+    if (seq->remaining > 0) {
+        --seq->remaining;
+    }
+    return true;
+}
+
+static bool eval_seq_call(
+        struct EvalSeq *seq,
+        VAL_LOC_T *arg_locs,
+        VAL_LOC_T *result_loc)
+{
+    *result_loc = eval_call(&seq->call, arg_locs);
+    if (err_state()) {
+        err_push("EVAL", "Failed generating a sequence element");
+        return false;
+    }
+    return true;
+}
+
+static bool eval_seq_next_filter(struct EvalSeq *seq, VAL_LOC_T *elem_loc)
+{
+    struct Runtime *rt = seq->rt;
+    VAL_LOC_T top, source_loc, result_loc;
+
+    for (;;) {
+        top = rt->stack.top;
+
+        if (!eval_seq_next(seq->sources[0], &source_loc) ||
+            !eval_seq_call(seq, &source_loc, &result_loc)) {
+            return false;
+        }
+
+        if (rt_val_peek_type(&rt->stack, result_loc) != VAL_BOOL) {
+            err_push("EVAL", "Sequence filter must return a boolean value");
+            return false;
+        }
+
+        if (rt_val_peek_bool(rt, result_loc)) {
+            rt->stack.top = result_loc;
+            *elem_loc = source_loc;
+            return true;
+        }
+
+        rt->stack.top = top;
+    }
+}
+
+static bool eval_seq_next_zip(struct EvalSeq *seq, VAL_LOC_T *elem_loc)
+{
+    struct Runtime *rt = seq->rt;
+    VAL_LOC_T size_loc, data_begin, source_locs[2], top = rt->stack.top;
+
+    /* The first source may have pushed an element when the second one runs
+     * out, it must not be left behind. */
+    if (!eval_seq_next(seq->sources[0], source_locs + 0) ||
+        !eval_seq_next(seq->sources[1], source_locs + 1)) {
+        rt->stack.top = top;
+        return false;
+    }
+
+    if (seq->kind == VAL_SEQ_ZIP_WITH) {
+        return eval_seq_call(seq, source_locs, elem_loc);
+    }
+
+    *elem_loc = rt->stack.top;
+    rt_val_push_tuple_init(&rt->stack, &size_loc);
+    data_begin = rt->stack.top;
+    rt_val_push_copy(&rt->stack, source_locs[0]);
+    rt_val_push_copy(&rt->stack, source_locs[1]);
+    rt_val_push_cpd_final(&rt->stack, size_loc, rt->stack.top - data_begin);
+
+    return true;
+}
+
+bool eval_seq_next(struct EvalSeq *seq, VAL_LOC_T *elem_loc)
+{
+    struct Runtime *rt = seq->rt;
+    VAL_LOC_T source_loc;
+
+    switch (seq->kind) {
+    case VAL_SEQ_CPD:
+        if (!eval_seq_take_one(seq)) {
+            return false;
+        }
+        *elem_loc = seq->current_loc;
+        seq->current_loc = rt_val_next_loc(rt, seq->current_loc);
+        return true;
+
+    case VAL_SEQ_RANGE:
+        if (!eval_seq_take_one(seq)) {
+            return false;
+        }
+        *elem_loc = rt->stack.top;
+        rt_val_push_int(&rt->stack, seq->current++);
+        return true;
+
+    case VAL_SEQ_GEN:
+        return eval_seq_take_one(seq) &&
+            eval_seq_call(seq, &source_loc, elem_loc);
+
+    case VAL_SEQ_MAP:
+        return eval_seq_next(seq->sources[0], &source_loc) &&
+            eval_seq_call(seq, &source_loc, elem_loc);
+
+    case VAL_SEQ_FILTER:
+        return eval_seq_next_filter(seq, elem_loc);
+
+    case VAL_SEQ_TAKE:
+        return eval_seq_take_one(seq) &&
+            eval_seq_next(seq->sources[0], elem_loc);
+
+    case VAL_SEQ_ZIP:
+    case VAL_SEQ_ZIP_WITH:
+        return eval_seq_next_zip(seq, elem_loc);
+    }
+
+    return false;
+}
+
+void eval_seq_keep(struct EvalSeq *seq, VAL_LOC_T dst_loc, VAL_LOC_T elem_loc)
+{
+    struct Stack *stack = &seq->rt->stack;
+    VAL_SIZE_T size = rt_val_peek_size(stack, elem_loc) + VAL_HEAD_BYTES;
+
+    if (elem_loc >= dst_loc) {
+        memmove(stack->buffer + dst_loc, stack->buffer + elem_loc, size);
+        stack->top = dst_loc + size;
+    } else {
+        stack->top = dst_loc;
+        rt_val_push_copy(stack, elem_loc);
+    }
+}
+
+void eval_seq_deinit(struct EvalSeq *seq)
+{
+    int i;
+
+    if (seq->has_call) {
+        eval_call_deinit(&seq->call);
+        seq->has_call = false;
+    }
+
+    for (i = 0; i < 2; ++i) {
+        if (seq->sources[i]) {
+            eval_seq_deinit(seq->sources[i]);
+            mem_free(seq->sources[i]);
+            seq->sources[i] = NULL;
+        }
+    }
+}
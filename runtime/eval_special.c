@@ -167,6 +167,10 @@ static void eval_special_while(
         VAL_LOC_T test_loc, temp_begin, temp_end;
         VAL_BOOL_T test_val;
 
+        if (!rt_check_interrupt(rt)) {
+            return;
+        }
+
         temp_begin = rt->stack.top;
         test_loc = eval_dispatch(whilee->test, rt, sym_map, alm);
         temp_end = rt->stack.top;
@@ -648,6 +652,14 @@ void eval_special(
     case AST_SPEC_SUCC:
         eval_special_succ(node, rt, sym_map, alm);
         break;
+
+    case AST_SPEC_PIPELINE:
+        eval_special_pipeline(node, rt, sym_map, alm);
+        break;
+
+    case AST_SPEC_PAR:
+        eval_special_par(node, rt, sym_map, alm);
+        break;
     }
 }
 
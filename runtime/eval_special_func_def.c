@@ -105,6 +105,12 @@ static struct AstNode *efd_get_children(struct AstNode* node)
 
         case AST_SPEC_SUCC:
             return special->data.succ.pointer;
+
+        case AST_SPEC_PIPELINE:
+            return special->data.pipeline.expr;
+
+        case AST_SPEC_PAR:
+            return special->data.par.exprs;
         }
         LOG_ERROR("Unhandled special AST node type.");
         exit(1);
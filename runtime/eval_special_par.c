@@ -0,0 +1,145 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#include <stdint.h>
+
+#include "error.h"
+#include "eval.h"
+#include "eval_detail.h"
+#include "memory.h"
+#include "rt_val.h"
+#include "runtime.h"
+#include "stack.h"
+
+/*
+ * The par special form evaluates independent expressions concurrently and
+ * yields the tuple of their results. Each expression is a task of the pool
+ * evaluated by a worker runtime, which holds a snapshot of the calling
+ * stack, in a local scope of its own, so that neither the bindings nor the
+ * stores made by one task are visible to the others.
+ */
+
+struct ParTask {
+    struct Runtime *rt;
+    struct AstNode *expr;
+    struct SymMap *sym_map;
+    struct AstLocMap *alm;
+    uint64_t seed;
+
+    struct Runtime *worker;
+    VAL_LOC_T result_loc;
+    struct ErrFrame *errors;
+};
+
+/** Evaluates the expression of the task, pushing the result. */
+static bool par_eval(struct Runtime *rt, struct ParTask *task)
+{
+    struct SymMap local_sym_map;
+
+    sym_map_init_local(&local_sym_map, task->sym_map);
+    task->result_loc = eval_dispatch(task->expr, rt, &local_sym_map, task->alm);
+    sym_map_deinit(&local_sym_map);
+
+    if (err_state()) {
+        err_push_src(
+            "EVAL",
+            alm_try_get(task->alm, task->expr),
+            "Failed evaluating _par_ expression");
+        return false;
+    }
+
+    return true;
+}
+
+static void par_task(void *data, int index)
+{
+    struct ParTask *task = (struct ParTask*)data + index;
+
+    task->worker = rt_make_worker(task->rt, task->seed, index);
+    if (!par_eval(task->worker, task)) {
+        task->errors = err_detach();
+    }
+}
+
+/**
+ * Copies the results of the tasks, releasing their workers, whose steps are
+ * charged to the calling runtime.
+ */
+static void par_gather(struct Runtime *rt, struct ParTask *tasks, int count)
+{
+    int i;
+
+    for (i = 0; i < count; ++i) {
+        if (err_state()) {
+            err_discard(tasks[i].errors);
+        } else {
+            err_attach(tasks[i].errors);
+        }
+    }
+
+    for (i = 0; i < count && !err_state(); ++i) {
+        struct Stack *stack = &tasks[i].worker->stack;
+        VAL_LOC_T loc = tasks[i].result_loc;
+        stack_push(
+            &rt->stack,
+            rt_val_peek_size(stack, loc) + VAL_HEAD_BYTES,
+            stack->buffer + loc);
+    }
+
+    for (i = 0; i < count; ++i) {
+        rt_budget_charge(rt, tasks[i].worker);
+        rt_free(tasks[i].worker);
+    }
+
+    if (!err_state()) {
+        rt_budget_check(rt);
+    }
+}
+
+void eval_special_par(
+        struct AstNode *node,
+        struct Runtime *rt,
+        struct SymMap *sym_map,
+        struct AstLocMap *alm)
+{
+    int i, count;
+    uint64_t seed;
+    VAL_LOC_T size_loc, data_begin;
+    struct AstNode *expr = node->data.special.data.par.exprs;
+    struct ParTask *tasks;
+
+    count = ast_list_len(expr);
+    tasks = mem_malloc(count * sizeof(*tasks));
+
+    /* The workers draw from independent streams of a fresh seed. */
+    seed = cpprand_bits(&rt->rand);
+    for (i = 0; i < count; ++i, expr = expr->next) {
+        tasks[i].rt = rt;
+        tasks[i].expr = expr;
+        tasks[i].sym_map = sym_map;
+        tasks[i].alm = alm;
+        tasks[i].seed = seed;
+        tasks[i].worker = NULL;
+        tasks[i].errors = NULL;
+    }
+
+    rt_val_push_tuple_init(&rt->stack, &size_loc);
+    data_begin = rt->stack.top;
+
+    /* The snapshots are taken even if there is no pool to share the work
+     * with, so that the result does not depend on the number of threads. */
+    rt_run_tasks(rt, par_task, tasks, count);
+    par_gather(rt, tasks, count);
+    if (err_state()) {
+        goto cleanup;
+    }
+
+    if (rt->stack.top - data_begin > UINT16_MAX) {
+        err_push_src("EVAL", alm_try_get(alm, node), "Results of _par_ too large to form a tuple");
+        goto cleanup;
+    }
+
+    rt_val_push_cpd_final(&rt->stack, size_loc, rt->stack.top - data_begin);
+
+cleanup:
+    mem_free(tasks);
+}
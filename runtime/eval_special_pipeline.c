@@ -0,0 +1,244 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#include <stdbool.h>
+
+#include "bif.h"
+#include "error.h"
+#include "eval.h"
+#include "eval_detail.h"
+#include "rt_val.h"
+#include "stack.h"
+
+/*
+ * The pipeline special form evaluates a chain of the collection processing
+ * BIFs in a single pass. The innermost source is wrapped in a lazy sequence
+ * so that each stage only extends the sequence's description; the elements
+ * are generated once, by the outermost stage or by the final collection.
+ */
+
+struct PipelineStage {
+    char *name;
+    void *impl;
+    int arity;
+    int sources[2];
+    int source_count;
+    bool terminal;
+};
+
+static struct PipelineStage pipeline_stages[] = {
+    { "map", (void*)bif_map, 2, { 1 }, 1, false },
+    { "filter", (void*)bif_filter, 2, { 1 }, 1, false },
+    { "take", (void*)bif_take, 2, { 1 }, 1, false },
+    { "zip", (void*)bif_zip, 2, { 0, 1 }, 2, false },
+    { "zip_with", (void*)bif_zip_with, 3, { 1, 2 }, 2, false },
+    { "foldl", (void*)bif_foldl, 3, { 2 }, 1, true },
+    { "foldr", (void*)bif_foldr, 3, { 2 }, 1, true },
+    { "collect", (void*)bif_collect, 1, { 0 }, 1, true }
+};
+
+static int pipeline_stages_count = sizeof(pipeline_stages) / sizeof(pipeline_stages[0]);
+
+/**
+ * Checks whether the node is a call of one of the BIFs that may be fused.
+ * The symbol must still refer to the BIF itself, not to any redefinition.
+ */
+static struct PipelineStage *pipeline_find_stage(
+        struct AstNode *node,
+        struct Runtime *rt,
+        struct SymMap *sym_map)
+{
+    int i;
+    struct AstNode *func;
+    struct SymMapNode *smn;
+    struct ValueFuncData func_data;
+
+    if (node->type != AST_FUNCTION_CALL) {
+        return NULL;
+    }
+
+    func = node->data.func_call.func;
+    if (func->type != AST_SYMBOL ||
+        !(smn = sym_map_find(sym_map, func->data.symbol.symbol)) ||
+        rt_val_peek_type(&rt->stack, smn->stack_loc) != VAL_FUNCTION) {
+        return NULL;
+    }
+
+    func_data = rt_val_function_data(rt, smn->stack_loc);
+    if (func_data.func_type != VAL_FUNC_BIF || func_data.appl_count != 0) {
+        return NULL;
+    }
+
+    for (i = 0; i < pipeline_stages_count; ++i) {
+        if (pipeline_stages[i].impl == func_data.impl) {
+            return pipeline_stages + i;
+        }
+    }
+
+    return NULL;
+}
+
+static bool pipeline_is_source(struct PipelineStage *stage, int arg)
+{
+    int i;
+    for (i = 0; i < stage->source_count; ++i) {
+        if (stage->sources[i] == arg) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void eval_pipeline_stage(
+        struct AstNode *node,
+        struct PipelineStage *stage,
+        struct Runtime *rt,
+        struct SymMap *sym_map,
+        struct AstLocMap *alm);
+
+/** Evaluates a source of a stage, pushing a lazy sequence. */
+static void eval_pipeline_source(
+        struct AstNode *node,
+        struct Runtime *rt,
+        struct SymMap *sym_map,
+        struct AstLocMap *alm)
+{
+    VAL_LOC_T temp_begin, temp_end, loc;
+    enum ValueType type;
+    struct PipelineStage *stage = pipeline_find_stage(node, rt, sym_map);
+
+    if (stage && stage->terminal) {
+        err_push_src(
+            "EVAL",
+            alm_try_get(alm, node),
+            "Call to _%s_ cannot be fused inside a _pipeline_",
+            stage->name);
+        return;
+    }
+
+    if (stage) {
+        eval_pipeline_stage(node, stage, rt, sym_map, alm);
+        return;
+    }
+
+    temp_begin = rt->stack.top;
+    loc = eval_dispatch(node, rt, sym_map, alm);
+    temp_end = rt->stack.top;
+    if (err_state()) {
+        return;
+    }
+
+    type = rt_val_peek_type(&rt->stack, loc);
+    if (type == VAL_ARRAY || type == VAL_TUPLE) {
+        bif_lazy(rt, loc);
+        stack_collapse(&rt->stack, temp_begin, temp_end);
+    }
+}
+
+static void eval_pipeline_stage(
+        struct AstNode *node,
+        struct PipelineStage *stage,
+        struct Runtime *rt,
+        struct SymMap *sym_map,
+        struct AstLocMap *alm)
+{
+    int i;
+    VAL_LOC_T temp_begin, temp_end, arg_locs[3];
+    struct AstNode *arg = node->data.func_call.actual_args;
+
+    if (ast_list_len(arg) != stage->arity) {
+        err_push_src(
+            "EVAL",
+            alm_try_get(alm, node),
+            "Call to _%s_ must not be partially applied to be fused in a _pipeline_",
+            stage->name);
+        return;
+    }
+
+    temp_begin = rt->stack.top;
+    for (i = 0; i < stage->arity; ++i) {
+        arg_locs[i] = rt->stack.top;
+        if (pipeline_is_source(stage, i)) {
+            eval_pipeline_source(arg, rt, sym_map, alm);
+        } else {
+            eval_dispatch(arg, rt, sym_map, alm);
+        }
+        if (err_state()) {
+            err_push_src(
+                "EVAL",
+                alm_try_get(alm, arg),
+                "Failed evaluating _%s_ argument in a _pipeline_",
+                stage->name);
+            return;
+        }
+        arg = arg->next;
+    }
+    temp_end = rt->stack.top;
+
+    switch (stage->arity) {
+    case 1:
+        ((bif_unary_func)stage->impl)(rt, arg_locs[0]);
+        break;
+
+    case 2:
+        ((bif_binary_func)stage->impl)(rt, arg_locs[0], arg_locs[1]);
+        break;
+
+    case 3:
+        ((bif_ternary_func)stage->impl)(rt, arg_locs[0], arg_locs[1], arg_locs[2]);
+        break;
+    }
+
+    if (err_state()) {
+        err_push_src(
+            "EVAL",
+            alm_try_get(alm, node),
+            "Failed evaluating _%s_ in a _pipeline_",
+            stage->name);
+        return;
+    }
+
+    stack_collapse(&rt->stack, temp_begin, temp_end);
+}
+
+void eval_special_pipeline(
+        struct AstNode *node,
+        struct Runtime *rt,
+        struct SymMap *sym_map,
+        struct AstLocMap *alm)
+{
+    VAL_LOC_T temp_begin, temp_end;
+    struct AstNode *expr = node->data.special.data.pipeline.expr;
+    struct PipelineStage *stage = pipeline_find_stage(expr, rt, sym_map);
+    struct BifCall bif_call, *outer_bif_call = rt->bif_call;
+
+    if (!stage) {
+        err_push_src(
+            "EVAL",
+            alm_try_get(alm, expr),
+            "Expression in _pipeline_ is not a call to map, filter, take, "
+            "zip, zip_with, foldl, foldr or collect");
+        return;
+    }
+
+    /* The stages are called directly, none of their arguments may be
+     * reused in place. */
+    bif_call.temp_begin = -1;
+    bif_call.temp_consumed = false;
+    bif_call.sym_map = sym_map;
+    bif_call.alm = alm;
+    rt->bif_call = &bif_call;
+
+    temp_begin = rt->stack.top;
+    eval_pipeline_stage(expr, stage, rt, sym_map, alm);
+
+    /* A pipeline that does not end with a fold yields an array. */
+    if (!err_state() && rt_val_peek_type(&rt->stack, temp_begin) == VAL_SEQ) {
+        temp_end = rt->stack.top;
+        bif_collect(rt, temp_begin);
+        if (!err_state()) {
+            stack_collapse(&rt->stack, temp_begin, temp_end);
+        }
+    }
+
+    rt->bif_call = outer_bif_call;
+}
@@ -0,0 +1,399 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#include <stdatomic.h>
+#include <string.h>
+
+#include "collection.h"
+#include "coro.h"
+#include "error.h"
+#include "eval.h"
+#include "fiber.h"
+#include "memory.h"
+#include "runtime.h"
+#include "stack.h"
+
+/*
+ * A fiber evaluates on a copy of the stack of the runtime that has spawned
+ * it, so that the function, its captures and everything it refers to are
+ * found at the same locations, within a flattened snapshot of the scope of
+ * the spawn, which does not depend on the scopes outliving the call.
+ *
+ * The channels are bounded queues of serialized values. The buffers of the
+ * queued messages are kept for reuse, so a steady stream of values does not
+ * allocate at all. A fiber waiting on a channel is skipped by the scheduler
+ * until the channel is ready for it, so only the fibers that can make
+ * progress are switched to.
+ */
+
+struct ChanMessage {
+    char *data;
+    int size;
+    int cap;
+};
+
+struct Channel {
+    struct ChanMessage *ring;
+    int capacity;
+    int head;
+    int count;
+};
+
+struct Fiber {
+    struct Runtime *rt;
+    struct Coro *coro;
+    struct SymMap sym_map;
+    struct AstLocMap alm;
+    VAL_LOC_T f_loc;
+
+    struct Channel *wait_chan;
+    bool wait_send;
+    bool cancelled;
+    struct ErrFrame *errors;
+};
+
+struct FiberSched {
+    VAL_INT_T id;
+    int spawn_count;
+    struct { struct Fiber **data; int cap, size; } fibers;
+    struct { struct Channel **data; int cap, size; } channels;
+};
+
+/* The identifiers tell apart the channels of the distinct runtimes, which
+ * may run on any threads. */
+static atomic_llong fiber_sched_count;
+
+struct FiberSched *fiber_sched_make(void)
+{
+    struct FiberSched *sched = mem_malloc(sizeof(*sched));
+    sched->id = atomic_fetch_add(&fiber_sched_count, 1);
+    sched->spawn_count = 0;
+    sched->fibers.data = NULL;
+    sched->fibers.cap = 0;
+    sched->fibers.size = 0;
+    sched->channels.data = NULL;
+    sched->channels.cap = 0;
+    sched->channels.size = 0;
+    return sched;
+}
+
+static void fiber_free(struct Fiber *fiber)
+{
+    err_discard(fiber->errors);
+    alm_deinit(&fiber->alm);
+    sym_map_deinit(&fiber->sym_map);
+    coro_free(fiber->coro);
+    rt_free(fiber->rt);
+    mem_free(fiber);
+}
+
+static void fiber_chan_free(struct Channel *chan)
+{
+    int i;
+    for (i = 0; i < chan->capacity; ++i) {
+        mem_free(chan->ring[i].data);
+    }
+    mem_free(chan->ring);
+    mem_free(chan);
+}
+
+void fiber_sched_free(struct FiberSched *sched)
+{
+    int i;
+    struct ErrFrame *errors = err_detach();
+
+    /* The fibers are unwound like upon an error, which releases the
+     * resources held by their evaluations. */
+    for (i = 0; i < sched->fibers.size; ++i) {
+        struct Fiber *fiber = sched->fibers.data[i];
+        fiber->cancelled = true;
+        coro_resume(fiber->coro);
+        fiber_free(fiber);
+    }
+    err_reset();
+    err_attach(errors);
+
+    for (i = 0; i < sched->channels.size; ++i) {
+        fiber_chan_free(sched->channels.data[i]);
+    }
+
+    ARRAY_FREE(sched->fibers);
+    ARRAY_FREE(sched->channels);
+    mem_free(sched);
+}
+
+/* Scheduling.
+ * ===========
+ */
+
+static bool fiber_chan_ready(struct Channel *chan, bool send)
+{
+    return send ? chan->count < chan->capacity : chan->count > 0;
+}
+
+static bool fiber_ready(struct Fiber *fiber)
+{
+    return !fiber->wait_chan || fiber_chan_ready(fiber->wait_chan, fiber->wait_send);
+}
+
+static void fiber_main(struct Coro *coro, void *data)
+{
+    struct Fiber *fiber = data;
+    struct EvalCall call;
+    VAL_LOC_T no_args = 0;
+
+    (void)coro;
+
+    if (fiber->cancelled) {
+        return;
+    }
+
+    if (eval_call_init(&call, fiber->rt, &fiber->sym_map, &fiber->alm, fiber->f_loc, 0)) {
+        eval_call(&call, &no_args);
+        eval_call_deinit(&call);
+    }
+
+    if (err_state()) {
+        fiber->errors = err_detach();
+    }
+}
+
+/**
+ * Resumes the fiber on the budget of the main evaluation, which is charged
+ * with the steps taken by the fiber. The main evaluation checks the budget
+ * in full at its next step, since only it may be preempted.
+ */
+static bool fiber_resume(struct Runtime *rt, struct Fiber *fiber)
+{
+    bool result;
+
+    fiber->rt->budget = rt->budget;
+    result = coro_resume(fiber->coro);
+    rt->budget = fiber->rt->budget;
+
+    rt->budget.steps += rt->budget.armed - rt->budget.countdown;
+    rt->budget.countdown = 1;
+    rt->budget.armed = 1;
+
+    return result;
+}
+
+/**
+ * Resumes once each of the fibers that may make progress. A failure of a
+ * fiber interrupts the pass and is reported to the main evaluation.
+ */
+static bool fiber_sched_pass(struct Runtime *rt, bool *progress)
+{
+    int i = 0;
+    struct FiberSched *sched = rt->sched;
+    struct Fiber *fiber;
+    struct ErrFrame *errors;
+
+    *progress = false;
+
+    /* The fibers spawned during the pass are appended and run in it too. */
+    while (i < sched->fibers.size) {
+        fiber = sched->fibers.data[i];
+        if (!fiber_ready(fiber)) {
+            ++i;
+            continue;
+        }
+
+        *progress = true;
+        if (fiber_resume(rt, fiber)) {
+            ++i;
+            continue;
+        }
+
+        /* The finished fiber is removed, keeping the order of the others. */
+        --sched->fibers.size;
+        memmove(
+            sched->fibers.data + i,
+            sched->fibers.data + i + 1,
+            (sched->fibers.size - i) * sizeof(*sched->fibers.data));
+
+        errors = fiber->errors;
+        fiber->errors = NULL;
+        fiber_free(fiber);
+
+        if (errors) {
+            err_attach(errors);
+            err_push("EVAL", "Fiber failed");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/** Suspends the current fiber until the scheduler resumes it. */
+static bool fiber_suspend(struct Fiber *fiber)
+{
+    coro_yield(fiber->coro);
+    if (fiber->cancelled) {
+        err_push("EVAL", "Fiber cancelled");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Waits until the channel is ready. A fiber is suspended, while the main
+ * evaluation runs the fibers until one of them makes the channel ready.
+ */
+static bool fiber_wait(struct Runtime *rt, struct Channel *chan, bool send)
+{
+    bool progress, result = true;
+    struct Fiber *fiber = rt->fiber;
+
+    if (fiber) {
+        fiber->wait_chan = chan;
+        fiber->wait_send = send;
+        while (result && !fiber_chan_ready(chan, send)) {
+            result = fiber_suspend(fiber);
+        }
+        fiber->wait_chan = NULL;
+        return result;
+    }
+
+    while (!fiber_chan_ready(chan, send)) {
+        if (!fiber_sched_pass(rt, &progress)) {
+            return false;
+        }
+        if (!progress) {
+            err_push("EVAL", "Deadlock, all the fibers are waiting on channels");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool fiber_yield(struct Runtime *rt)
+{
+    bool progress;
+
+    if (rt->fiber) {
+        return fiber_suspend(rt->fiber);
+    }
+
+    return fiber_sched_pass(rt, &progress);
+}
+
+/* Spawning.
+ * =========
+ */
+
+static void fiber_snapshot_symbol(char *symbol, struct SymMapNode *node, void *data)
+{
+    struct SymMap *snapshot = data;
+    if (!sym_map_find_shallow(snapshot, symbol)) {
+        sym_map_insert(snapshot, symbol, node->stack_loc);
+    }
+}
+
+void fiber_spawn(struct Runtime *rt, VAL_LOC_T f_loc, struct SymMap *sym_map)
+{
+    struct Fiber *fiber = mem_malloc(sizeof(*fiber));
+
+    /* The inner scopes are visited first, so that they shadow the outer. */
+    sym_map_init_global(&fiber->sym_map);
+    for (; sym_map; sym_map = sym_map->parent) {
+        sym_map_for_each(sym_map, fiber_snapshot_symbol, &fiber->sym_map);
+    }
+
+    fiber->rt = rt_make_worker(rt, cpprand_bits(&rt->rand), 0);
+    fiber->rt->sched = rt->sched;
+    fiber->rt->fiber = fiber;
+    fiber->coro = coro_make(fiber_main, fiber, CORO_STACK_SIZE);
+    alm_init(&fiber->alm);
+    fiber->f_loc = f_loc;
+    fiber->wait_chan = NULL;
+    fiber->wait_send = false;
+    fiber->cancelled = false;
+    fiber->errors = NULL;
+
+    ARRAY_APPEND(rt->sched->fibers, fiber);
+    ++rt->sched->spawn_count;
+}
+
+int fiber_spawn_count(struct FiberSched *sched)
+{
+    return sched->spawn_count;
+}
+
+/* Channels.
+ * =========
+ */
+
+void fiber_chan_make(struct Runtime *rt, int capacity)
+{
+    struct FiberSched *sched = rt->sched;
+    struct Channel *chan = mem_malloc(sizeof(*chan));
+    int i;
+
+    chan->ring = mem_malloc(capacity * sizeof(*chan->ring));
+    chan->capacity = capacity;
+    chan->head = 0;
+    chan->count = 0;
+    for (i = 0; i < capacity; ++i) {
+        chan->ring[i].data = NULL;
+        chan->ring[i].size = 0;
+        chan->ring[i].cap = 0;
+    }
+
+    rt_val_push_channel(&rt->stack, sched->id, sched->channels.size);
+    ARRAY_APPEND(sched->channels, chan);
+}
+
+static struct Channel *fiber_chan_find(struct Runtime *rt, VAL_LOC_T chan_loc)
+{
+    VAL_INT_T sched_id, index;
+
+    rt_val_peek_channel(rt, chan_loc, &sched_id, &index);
+    if (sched_id != rt->sched->id || index < 0 || index >= rt->sched->channels.size) {
+        err_push("EVAL", "Channel does not belong to this context");
+        return NULL;
+    }
+
+    return rt->sched->channels.data[index];
+}
+
+bool fiber_chan_send(struct Runtime *rt, VAL_LOC_T chan_loc, VAL_LOC_T x_loc)
+{
+    struct Channel *chan = fiber_chan_find(rt, chan_loc);
+    struct ChanMessage *message;
+    int size;
+
+    if (!chan || !fiber_wait(rt, chan, true)) {
+        return false;
+    }
+
+    size = VAL_HEAD_BYTES + rt_val_peek_size(&rt->stack, x_loc);
+    message = chan->ring + (chan->head + chan->count) % chan->capacity;
+    if (message->cap < size) {
+        message->data = mem_realloc(message->data, size);
+        message->cap = size;
+    }
+    memcpy(message->data, rt->stack.buffer + x_loc, size);
+    message->size = size;
+    ++chan->count;
+
+    return true;
+}
+
+bool fiber_chan_recv(struct Runtime *rt, VAL_LOC_T chan_loc)
+{
+    struct Channel *chan = fiber_chan_find(rt, chan_loc);
+    struct ChanMessage *message;
+
+    if (!chan || !fiber_wait(rt, chan, false)) {
+        return false;
+    }
+
+    message = chan->ring + chan->head;
+    stack_push(&rt->stack, message->size, message->data);
+    chan->head = (chan->head + 1) % chan->capacity;
+    --chan->count;
+
+    return true;
+}
@@ -0,0 +1,48 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#ifndef FIBER_H
+#define FIBER_H
+
+#include <stdbool.h>
+
+#include "rt_val.h"
+
+struct Runtime;
+struct SymMap;
+
+/**
+ * The fibers of a runtime and the channels they communicate through. The
+ * fibers are coroutines scheduled cooperatively on the thread evaluating the
+ * runtime, each on a worker runtime with a stack of its own. They only run
+ * while the main evaluation yields or waits on a channel, so the scheduler
+ * is driven by the main evaluation alone.
+ */
+struct FiberSched;
+
+struct FiberSched *fiber_sched_make(void);
+
+/** Cancels the suspended fibers, unwinding their evaluations. */
+void fiber_sched_free(struct FiberSched *sched);
+
+/**
+ * Starts a fiber calling the function of no arguments found at the given
+ * location, within a snapshot of the given scope.
+ */
+void fiber_spawn(struct Runtime *rt, VAL_LOC_T f_loc, struct SymMap *sym_map);
+
+/** Returns the number of the fibers spawned so far. */
+int fiber_spawn_count(struct FiberSched *sched);
+
+/** Lets the other fibers run, returns false if one of them has failed. */
+bool fiber_yield(struct Runtime *rt);
+
+/** Pushes a new channel buffering up to capacity values. */
+void fiber_chan_make(struct Runtime *rt, int capacity);
+
+/** Sends a copy of the value, waiting while the channel is full. */
+bool fiber_chan_send(struct Runtime *rt, VAL_LOC_T chan_loc, VAL_LOC_T x_loc);
+
+/** Pushes the oldest value of the channel, waiting while it is empty. */
+bool fiber_chan_recv(struct Runtime *rt, VAL_LOC_T chan_loc);
+
+#endif
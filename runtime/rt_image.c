@@ -0,0 +1,437 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ast_image.h"
+#include "error.h"
+#include "memory.h"
+#include "rt_val.h"
+#include "runtime.h"
+#include "stack.h"
+#include "symmap.h"
+
+/*
+ * The runtime image is laid out as follows:
+ * - the magic string and the build fingerprint,
+ * - the image of the retained ASTs,
+ * - the indices of the heads of the retained AST lists,
+ * - the global symbols with their stack locations,
+ * - the stack contents.
+ *
+ * The stack is stored verbatim, except for the implementations of the
+ * function values. The AST functions store the index of their definition
+ * node in the AST image and the BIFs store their address relative to an
+ * anchor function, which holds across the runs of the same build even if
+ * it is loaded at a different address.
+ */
+
+static char rt_image_magic[8] = { 'M', 'O', 'O', 'N', 'I', 'M', 'G', '1' };
+
+struct RtImageReloc {
+    bool loading;
+    char *buffer;
+    struct AstImageNodes *nodes;
+};
+
+static char *rt_image_anchor(void)
+{
+    return (char*)(void*)rt_make;
+}
+
+static int64_t rt_image_fingerprint(void)
+{
+    return (char*)(void*)rt_image_load - rt_image_anchor();
+}
+
+static bool rt_image_reloc_func(
+        struct Runtime *rt,
+        VAL_LOC_T loc,
+        struct RtImageReloc *reloc)
+{
+    struct ValueFuncData func_data = rt_val_function_data(rt, loc);
+    intptr_t encoded = (intptr_t)func_data.impl;
+    void *decoded;
+
+    switch ((enum ValueFuncType)func_data.func_type) {
+    case VAL_FUNC_AST:
+        if (reloc->loading) {
+            if (encoded < 0 || encoded >= reloc->nodes->array.size) {
+                err_push("IMAGE", "Function definition out of the image");
+                return false;
+            }
+            decoded = reloc->nodes->array.data[encoded];
+        } else {
+            encoded = ast_image_nodes_find(reloc->nodes, func_data.impl);
+            if (encoded < 0) {
+                err_push("IMAGE", "Function defined out of the retained definitions");
+                return false;
+            }
+        }
+        break;
+
+    case VAL_FUNC_BIF:
+        if (reloc->loading) {
+            decoded = rt_image_anchor() + encoded;
+        } else {
+            encoded = (char*)func_data.impl - rt_image_anchor();
+        }
+        break;
+
+    case VAL_FUNC_CLIF:
+    default:
+        err_push("IMAGE", "Client functions cannot be stored in an image");
+        return false;
+    }
+
+    if (reloc->loading) {
+        memcpy(rt->stack.buffer + func_data.impl_loc, &decoded, VAL_HW_PTR_BYTES);
+    } else {
+        memcpy(reloc->buffer + func_data.impl_loc, &encoded, VAL_HW_PTR_BYTES);
+    }
+
+    return true;
+}
+
+static bool rt_image_reloc_range(
+        struct Runtime *rt,
+        VAL_LOC_T begin,
+        VAL_LOC_T end,
+        struct RtImageReloc *reloc);
+
+static bool rt_image_reloc(
+        struct Runtime *rt,
+        VAL_LOC_T loc,
+        struct RtImageReloc *reloc)
+{
+    int i;
+    VAL_LOC_T end = loc + VAL_HEAD_BYTES + rt_val_peek_size(&rt->stack, loc);
+    VAL_LOC_T current;
+    struct ValueFuncData func_data;
+
+    if (end > rt->stack.top) {
+        err_push("IMAGE", "Malformed stack value");
+        return false;
+    }
+
+    switch ((enum ValueType)rt_val_peek_type(&rt->stack, loc)) {
+    case VAL_ARRAY:
+    case VAL_TUPLE:
+        return rt_image_reloc_range(rt, rt_val_cpd_first_loc(loc), end, reloc);
+
+    case VAL_DICT:
+        return rt_image_reloc_range(
+            rt, rt_val_dict_first_loc(&rt->stack, loc), end, reloc);
+
+    case VAL_SEQ:
+        return rt_image_reloc_range(rt, rt_val_seq_first_loc(loc), end, reloc);
+
+    case VAL_FUNCTION:
+        if (!rt_image_reloc_func(rt, loc, reloc)) {
+            return false;
+        }
+        func_data = rt_val_function_data(rt, loc);
+        current = func_data.cap_start;
+        for (i = 0; i < func_data.cap_count; ++i) {
+            if (!rt_image_reloc(rt, rt_val_fun_cap_loc(rt, current), reloc)) {
+                return false;
+            }
+            current = rt_val_fun_next_cap_loc(rt, current);
+        }
+        current = func_data.appl_start;
+        for (i = 0; i < func_data.appl_count; ++i) {
+            if (!rt_image_reloc(rt, current, reloc)) {
+                return false;
+            }
+            current = rt_val_fun_next_appl_loc(rt, current);
+        }
+        return true;
+
+    case VAL_CHANNEL:
+        err_push("IMAGE", "Channels cannot be stored in an image");
+        return false;
+
+    default:
+        return true;
+    }
+}
+
+static bool rt_image_reloc_range(
+        struct Runtime *rt,
+        VAL_LOC_T begin,
+        VAL_LOC_T end,
+        struct RtImageReloc *reloc)
+{
+    while (begin < end) {
+        if (!rt_image_reloc(rt, begin, reloc)) {
+            return false;
+        }
+        begin = rt_val_next_loc(rt, begin);
+    }
+    return true;
+}
+
+/* Dumping.
+ * ========
+ */
+
+static void rt_image_put_symbol(char *symbol, struct SymMapNode *node, void *data)
+{
+    struct AstImageBuffer *buffer = data;
+    int32_t len = strlen(symbol);
+    int64_t loc = node->stack_loc;
+    ast_image_put(buffer, &len, sizeof(len));
+    ast_image_put(buffer, symbol, len);
+    ast_image_put(buffer, &loc, sizeof(loc));
+}
+
+static void rt_image_count_symbol(char *symbol, struct SymMapNode *node, void *data)
+{
+    (void)symbol;
+    (void)node;
+    ++*(int32_t*)data;
+}
+
+bool rt_image_dump(struct Runtime *rt, char *filename)
+{
+    bool result = false;
+    int i, list_count;
+    int32_t count, index;
+    int64_t value;
+    struct AstNode **lists;
+    struct AstImageNodes nodes;
+    struct AstImageBuffer buffer;
+    struct RtImageReloc reloc;
+    FILE *file;
+
+    ast_image_buffer_init(&buffer);
+    ast_image_nodes_init(&nodes);
+
+    ast_image_put(&buffer, rt_image_magic, sizeof(rt_image_magic));
+    value = rt_image_fingerprint();
+    ast_image_put(&buffer, &value, sizeof(value));
+
+    lists = rt_retained_lists(rt, &list_count);
+    ast_image_write(&buffer, lists, list_count, &nodes);
+    count = list_count;
+    ast_image_put(&buffer, &count, sizeof(count));
+    for (i = 0; i < list_count; ++i) {
+        index = ast_image_nodes_find(&nodes, lists[i]);
+        ast_image_put(&buffer, &index, sizeof(index));
+    }
+    mem_free(lists);
+
+    count = 0;
+    sym_map_for_each(&rt->global_sym_map, rt_image_count_symbol, &count);
+    ast_image_put(&buffer, &count, sizeof(count));
+    sym_map_for_each(&rt->global_sym_map, rt_image_put_symbol, &buffer);
+
+    /* The stack is relocated in the buffer, the runtime is left intact. */
+    value = rt->stack.top;
+    ast_image_put(&buffer, &value, sizeof(value));
+    ast_image_put(&buffer, rt->stack.buffer, rt->stack.top);
+    reloc.loading = false;
+    reloc.buffer = buffer.data + buffer.size - rt->stack.top;
+    reloc.nodes = &nodes;
+    if (!rt_image_reloc_range(rt, 1, rt->stack.top, &reloc)) {
+        err_push("IMAGE", "Failed relocating the stack of the runtime");
+        goto cleanup;
+    }
+
+    if (!(file = fopen(filename, "wb"))) {
+        err_push("IMAGE", "Failed opening image file %s", filename);
+        goto cleanup;
+    }
+
+    if (fwrite(buffer.data, 1, buffer.size, file) != (size_t)buffer.size) {
+        err_push("IMAGE", "Failed writing image file %s", filename);
+        fclose(file);
+        goto cleanup;
+    }
+
+    fclose(file);
+    result = true;
+
+cleanup:
+    ast_image_nodes_deinit(&nodes);
+    ast_image_buffer_deinit(&buffer);
+    return result;
+}
+
+/* Loading.
+ * ========
+ */
+
+static char *rt_image_read_file(char *filename, long *size)
+{
+    FILE *file;
+    char *result;
+
+    if (!(file = fopen(filename, "rb"))) {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    result = mem_malloc(*size + 1);
+    if (fread(result, 1, *size, file) != (size_t)*size) {
+        mem_free(result);
+        result = NULL;
+    }
+
+    fclose(file);
+    return result;
+}
+
+static bool rt_image_get_lists(
+        char **cursor,
+        char *end,
+        struct AstImageNodes *nodes,
+        struct AstNode **node_store)
+{
+    int32_t count, index, i;
+    struct AstNode *tail = NULL;
+
+    *node_store = NULL;
+
+    if (!ast_image_get(cursor, end, &count, sizeof(count))) {
+        return false;
+    }
+
+    for (i = 0; i < count; ++i) {
+        if (!ast_image_get(cursor, end, &index, sizeof(index)) ||
+            index < 0 || index >= nodes->array.size) {
+            return false;
+        }
+        if (tail) {
+            tail->next = nodes->array.data[index];
+        } else {
+            *node_store = nodes->array.data[index];
+        }
+        for (tail = nodes->array.data[index]; tail->next; tail = tail->next);
+    }
+
+    return true;
+}
+
+static bool rt_image_get_symbols(
+        char **cursor,
+        char *end,
+        struct Runtime *rt)
+{
+    int32_t count, len, i;
+    int64_t loc;
+    char *symbol;
+
+    if (!ast_image_get(cursor, end, &count, sizeof(count))) {
+        return false;
+    }
+
+    for (i = 0; i < count; ++i) {
+        if (!ast_image_get(cursor, end, &len, sizeof(len)) ||
+            len <= 0 || end - *cursor < len) {
+            return false;
+        }
+        symbol = mem_malloc(len + 1);
+        memcpy(symbol, *cursor, len);
+        symbol[len] = '\0';
+        *cursor += len;
+        if (!ast_image_get(cursor, end, &loc, sizeof(loc))) {
+            mem_free(symbol);
+            return false;
+        }
+        sym_map_insert(&rt->global_sym_map, symbol, loc);
+        mem_free(symbol);
+    }
+
+    return true;
+}
+
+struct Runtime *rt_image_load(char *filename)
+{
+    long size;
+    int64_t value;
+    char *image, *cursor, *end, magic[sizeof(rt_image_magic)];
+    struct AstImageNodes nodes;
+    struct AstNode *node_store;
+    struct Runtime *rt = NULL;
+    struct RtImageReloc reloc;
+
+    if (!(image = rt_image_read_file(filename, &size))) {
+        err_push("IMAGE", "Failed reading image file %s", filename);
+        return NULL;
+    }
+
+    cursor = image;
+    end = image + size;
+    ast_image_nodes_init(&nodes);
+
+    if (!ast_image_get(&cursor, end, magic, sizeof(magic)) ||
+        memcmp(magic, rt_image_magic, sizeof(magic)) != 0) {
+        err_push("IMAGE", "File %s is not a runtime image", filename);
+        goto cleanup;
+    }
+
+    if (!ast_image_get(&cursor, end, &value, sizeof(value)) ||
+        value != rt_image_fingerprint()) {
+        err_push("IMAGE", "Image %s has been created by a different build", filename);
+        goto cleanup;
+    }
+
+    if (!ast_image_read(&cursor, end, &nodes)) {
+        err_push("IMAGE", "Malformed AST in image %s", filename);
+        goto cleanup;
+    }
+
+    if (!rt_image_get_lists(&cursor, end, &nodes, &node_store)) {
+        err_push("IMAGE", "Malformed AST list in image %s", filename);
+        goto free_nodes;
+    }
+
+    /* A fresh runtime is stripped of the BIF definitions, which the image
+     * contains anyway. */
+    rt = rt_make();
+    rt->node_store = node_store;
+    sym_map_deinit(&rt->global_sym_map);
+    sym_map_init_global(&rt->global_sym_map);
+    rt->stack.top = 1;
+
+    if (!rt_image_get_symbols(&cursor, end, rt) || err_state()) {
+        err_push("IMAGE", "Malformed symbols in image %s", filename);
+        goto free_runtime;
+    }
+
+    if (!ast_image_get(&cursor, end, &value, sizeof(value)) ||
+        value < 1 || end - cursor != value) {
+        err_push("IMAGE", "Malformed stack in image %s", filename);
+        goto free_runtime;
+    }
+
+    stack_push(&rt->stack, value - 1, cursor + 1);
+
+    reloc.loading = true;
+    reloc.buffer = NULL;
+    reloc.nodes = &nodes;
+    if (!rt_image_reloc_range(rt, 1, rt->stack.top, &reloc)) {
+        err_push("IMAGE", "Failed relocating the stack from image %s", filename);
+        goto free_runtime;
+    }
+
+    goto cleanup;
+
+free_nodes:
+    ast_image_nodes_free(&nodes);
+    goto cleanup;
+
+free_runtime:
+    rt_free(rt);
+    rt = NULL;
+
+cleanup:
+    ast_image_nodes_deinit(&nodes);
+    mem_free(image);
+    return rt;
+}
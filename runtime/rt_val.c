@@ -21,6 +21,7 @@ VAL_HEAD_SIZE_T unit_size = 0;
 VAL_HEAD_SIZE_T datatype_embellishment_size = sizeof(enum ValueDataTypeEmbellishment);
 VAL_HEAD_SIZE_T datatype_size = sizeof(enum ValueDataType);
 VAL_HEAD_SIZE_T datatype_total_size = sizeof(enum ValueDataTypeEmbellishment) + sizeof(enum ValueDataType);
+VAL_HEAD_SIZE_T seq_kind_size = sizeof(enum ValueSeqKind);
 
 enum ValueDataTypeEmbellishment emb_just = VAL_EMB_JUST;
 
@@ -60,6 +61,95 @@ bool rt_val_pair_homo(struct Runtime *rt, VAL_LOC_T x, VAL_LOC_T y)
     }
 }
 
+bool rt_val_has_dict(struct Runtime *rt, VAL_LOC_T loc)
+{
+    VAL_LOC_T current;
+    int len;
+
+    switch (rt_val_peek_type(&rt->stack, loc)) {
+    case VAL_DICT:
+        return true;
+
+    case VAL_ARRAY:
+    case VAL_TUPLE:
+        len = rt_val_cpd_len(rt, loc);
+        current = rt_val_cpd_first_loc(loc);
+        break;
+
+    case VAL_DATATYPE:
+        len = rt_val_datatype_len(rt, loc);
+        current = rt_val_datatype_first_loc(loc);
+        break;
+
+    default:
+        return false;
+    }
+
+    while (len) {
+        if (rt_val_has_dict(rt, current)) {
+            return true;
+        }
+        current = rt_val_next_loc(rt, current);
+        --len;
+    }
+
+    return false;
+}
+
+static bool rt_val_range_has_ptr(struct Runtime *rt, VAL_LOC_T begin, VAL_LOC_T end)
+{
+    while (begin < end) {
+        if (rt_val_has_ptr(rt, begin)) {
+            return true;
+        }
+        begin = rt_val_next_loc(rt, begin);
+    }
+    return false;
+}
+
+bool rt_val_has_ptr(struct Runtime *rt, VAL_LOC_T loc)
+{
+    VAL_LOC_T end = rt_val_next_loc(rt, loc), current;
+    struct ValueFuncData func_data;
+    int i;
+
+    switch (rt_val_peek_type(&rt->stack, loc)) {
+    case VAL_PTR:
+        return true;
+
+    case VAL_ARRAY:
+    case VAL_TUPLE:
+        return rt_val_range_has_ptr(rt, rt_val_cpd_first_loc(loc), end);
+
+    case VAL_DICT:
+        return rt_val_range_has_ptr(rt, rt_val_dict_first_loc(&rt->stack, loc), end);
+
+    case VAL_SEQ:
+        return rt_val_range_has_ptr(rt, rt_val_seq_first_loc(loc), end);
+
+    case VAL_FUNCTION:
+        func_data = rt_val_function_data(rt, loc);
+        current = func_data.cap_start;
+        for (i = 0; i < func_data.cap_count; ++i) {
+            if (rt_val_has_ptr(rt, rt_val_fun_cap_loc(rt, current))) {
+                return true;
+            }
+            current = rt_val_fun_next_cap_loc(rt, current);
+        }
+        current = func_data.appl_start;
+        for (i = 0; i < func_data.appl_count; ++i) {
+            if (rt_val_has_ptr(rt, current)) {
+                return true;
+            }
+            current = rt_val_fun_next_appl_loc(rt, current);
+        }
+        return false;
+
+    default:
+        return false;
+    }
+}
+
 bool rt_val_eq_rec(struct Runtime *rt, VAL_LOC_T x, VAL_LOC_T y)
 {
     enum ValueType xtype, ytype;
@@ -133,6 +223,34 @@ bool rt_val_eq_rec(struct Runtime *rt, VAL_LOC_T x, VAL_LOC_T y)
             if (!rt_val_eq_rec(rt, x, y)) {
                 return false;
             }
+            x = rt_val_next_loc(rt, x);
+            y = rt_val_next_loc(rt, y);
+            --xlen;
+        }
+        return true;
+
+    case VAL_SEQ:
+    case VAL_SAMPLER:
+    case VAL_CHANNEL:
+        return rt_val_eq_bin(rt, x, y);
+
+    case VAL_DICT:
+        xlen = rt_val_dict_len(&rt->stack, x);
+        ylen = rt_val_dict_len(&rt->stack, y);
+        if (xlen != ylen) {
+            return false;
+        }
+        x = rt_val_dict_first_loc(&rt->stack, x);
+        while (xlen) {
+            VAL_LOC_T y_key = rt_val_dict_find(&rt->stack, y, x);
+            if (y_key == -1) {
+                return false;
+            }
+            x = rt_val_next_loc(rt, x);
+            if (!rt_val_eq_rec(rt, x, rt_val_next_loc(rt, y_key))) {
+                return false;
+            }
+            x = rt_val_next_loc(rt, x);
             --xlen;
         }
         return true;
@@ -34,6 +34,9 @@
 
 #define VAL_HW_PTR_BYTES sizeof(void*)
 
+#define VAL_SAMPLER_ENTRY_BYTES (VAL_REAL_BYTES + VAL_INT_BYTES)
+#define VAL_CHANNEL_BYTES (2 * VAL_INT_BYTES)
+
 /* Allocate variables of significant values to copy from. */
 extern VAL_HEAD_SIZE_T zero;
 extern VAL_HEAD_SIZE_T bool_size;
@@ -45,8 +48,7 @@ extern VAL_HEAD_SIZE_T unit_size;
 extern VAL_HEAD_SIZE_T datatype_embellishment_size;
 extern VAL_HEAD_SIZE_T datatype_size;
 extern VAL_HEAD_SIZE_T datatype_total_size;
-
-extern enum ValueDataTypeEmbellishment emb_just;
+extern VAL_HEAD_SIZE_T seq_kind_size;
 
 struct Runtime;
 struct Stack;
@@ -65,7 +67,11 @@ enum ValueType {
     VAL_FUNCTION,
     VAL_PTR,
     VAL_UNIT,
-    VAL_DATATYPE
+    VAL_DATATYPE,
+    VAL_DICT,
+    VAL_SEQ,
+    VAL_SAMPLER,
+    VAL_CHANNEL
 };
 
 struct ValueHeader {
@@ -76,7 +82,9 @@ struct ValueHeader {
 enum ValueFuncType {
     VAL_FUNC_AST,
     VAL_FUNC_BIF,
-    VAL_FUNC_CLIF
+    VAL_FUNC_CLIF,
+    VAL_FUNC_ASYNC_CLIF,
+    VAL_FUNC_DIRECT_CLIF
 };
 
 struct ValueFuncData {
@@ -106,6 +114,33 @@ enum ValueDataTypeEmbellishment {
     VAL_EMB_TAG
 };
 
+extern enum ValueDataTypeEmbellishment emb_just;
+
+/**
+ * The lazy sequence value only describes how its elements are generated.
+ * The kind is followed by the parameters, each being a regular value:
+ * - CPD      : the compound,
+ * - RANGE    : the initial integer, the count,
+ * - GEN      : the nullary function, the count,
+ * - MAP      : the function, the source,
+ * - FILTER   : the predicate, the source,
+ * - TAKE     : the count, the source,
+ * - ZIP      : the two sources,
+ * - ZIP_WITH : the binary function, the two sources.
+ * A source is either a compound or another sequence, a negative count
+ * stands for an infinite sequence.
+ */
+enum ValueSeqKind {
+    VAL_SEQ_CPD,
+    VAL_SEQ_RANGE,
+    VAL_SEQ_GEN,
+    VAL_SEQ_MAP,
+    VAL_SEQ_FILTER,
+    VAL_SEQ_TAKE,
+    VAL_SEQ_ZIP,
+    VAL_SEQ_ZIP_WITH
+};
+
 enum ValueDataType {
     VAL_DATA_VOID,
     VAL_DATA_UNIT,
@@ -145,6 +180,44 @@ void rt_val_push_cpd_final(
 
 void rt_val_push_string(struct Stack *stack, char *begin, char *end);
 
+/* Dictionary values.
+ * ------------------
+ */
+
+/**
+ * Computes the index capacity suitable for the given number of entries, up
+ * to the largest index which still fits in a value.
+ */
+VAL_SIZE_T rt_val_dict_capacity_for(int count);
+
+void rt_val_push_dict_init(
+        struct Stack *stack,
+        VAL_SIZE_T capacity,
+        VAL_LOC_T *dict_loc);
+
+/**
+ * Appends a copy of a key and a value to the dictionary at the stack top.
+ * The key must not be present in the dictionary yet. Returns false if the
+ * entry would make the dictionary too large to be stored in a value, in
+ * which case the dictionary is left unchanged.
+ */
+bool rt_val_push_dict_entry(
+        struct Stack *stack,
+        VAL_LOC_T dict_loc,
+        VAL_LOC_T key_loc,
+        VAL_LOC_T value_loc);
+
+/**
+ * Makes the dictionary at the stack top cover the key and value that
+ * directly follow it. The key must not be present in the dictionary yet and
+ * the index must have room for it. Returns false if the dictionary would be
+ * too large to be stored in a value, in which case it is left unchanged.
+ */
+bool rt_val_dict_adopt_entry(
+        struct Stack *stack,
+        VAL_LOC_T dict_loc,
+        VAL_LOC_T key_loc);
+
 /* Datatype values.
  * ----------------
  */
@@ -161,6 +234,47 @@ void rt_val_push_datatype_final(
         VAL_LOC_T size_loc,
         VAL_SIZE_T size);
 
+/* Sequence values.
+ * ----------------
+ */
+
+void rt_val_push_seq_init(
+        struct Stack *stack,
+        enum ValueSeqKind kind,
+        VAL_LOC_T *size_loc);
+
+void rt_val_push_seq_final(
+        struct Stack *stack,
+        VAL_LOC_T size_loc,
+        VAL_SIZE_T size);
+
+/* Sampler values.
+ * ---------------
+ */
+
+/**
+ * Pushes the alias table of a discrete distribution. Outcome i is kept with
+ * probability probs[i], otherwise it is replaced with aliases[i].
+ */
+void rt_val_push_sampler(
+        struct Stack *stack,
+        VAL_REAL_T *probs,
+        VAL_INT_T *aliases,
+        VAL_SIZE_T count);
+
+/* Channel values.
+ * ---------------
+ */
+
+/**
+ * Pushes a handle of a channel, which is only valid within the set of the
+ * fibers of the runtime identified by sched_id.
+ */
+void rt_val_push_channel(
+        struct Stack *stack,
+        VAL_INT_T sched_id,
+        VAL_INT_T index);
+
 /* Function values.
  * ----------------
  */
@@ -217,6 +331,9 @@ void rt_val_print(struct Runtime *rt, VAL_LOC_T loc, bool annotate);
 /** Checks whether a value is a string i.e. an array of characters. */
 bool rt_val_is_string(struct Runtime *rt, VAL_LOC_T loc);
 
+/** Checks whether a value may be used as a dictionary key. */
+bool rt_val_is_hashable(struct Runtime *rt, VAL_LOC_T loc);
+
 /* Value iteration.
  * ----------------
  */
@@ -271,9 +388,51 @@ enum ValueDataTypeEmbellishment rt_val_peek_datatype_embellishment(
 /** Returns the location of the first element of the compound value. */
 VAL_LOC_T rt_val_cpd_first_loc(VAL_LOC_T loc);
 
+/** Returns the capacity of the dictionary index. */
+VAL_SIZE_T rt_val_dict_cap(struct Stack *stack, VAL_LOC_T loc);
+
+/** Returns the number of the dictionary entries. */
+int rt_val_dict_len(struct Stack *stack, VAL_LOC_T loc);
+
+/**
+ * Returns the location of the first key of the dictionary, each key is
+ * directly followed by its value.
+ */
+VAL_LOC_T rt_val_dict_first_loc(struct Stack *stack, VAL_LOC_T loc);
+
+/** Returns the location of the key in the dictionary or -1 if absent. */
+VAL_LOC_T rt_val_dict_find(
+        struct Stack *stack,
+        VAL_LOC_T loc,
+        VAL_LOC_T key_loc);
+
 /** Returns the location of the first element of the datatype value. */
 VAL_LOC_T rt_val_datatype_first_loc(VAL_LOC_T loc);
 
+/** Returns the kind of the lazy sequence value. */
+enum ValueSeqKind rt_val_peek_seq_kind(struct Runtime *rt, VAL_LOC_T loc);
+
+/** Returns the location of the first parameter of the sequence value. */
+VAL_LOC_T rt_val_seq_first_loc(VAL_LOC_T loc);
+
+/** Returns the number of the outcomes of the sampler value. */
+VAL_SIZE_T rt_val_sampler_len(struct Runtime *rt, VAL_LOC_T loc);
+
+/** Peeks the alias table entry of the given outcome of the sampler value. */
+void rt_val_peek_sampler_entry(
+        struct Runtime *rt,
+        VAL_LOC_T loc,
+        VAL_INT_T index,
+        VAL_REAL_T *prob,
+        VAL_INT_T *alias);
+
+/** Peeks the scheduler identifier and the index of the channel value. */
+void rt_val_peek_channel(
+        struct Runtime *rt,
+        VAL_LOC_T loc,
+        VAL_INT_T *sched_id,
+        VAL_INT_T *index);
+
 /**
  * Peek an array of char as a string.
  * NOTE that the client is responsible for releasing the string buffer.
@@ -305,6 +464,12 @@ bool rt_val_pair_homo(struct Runtime *rt, VAL_LOC_T x, VAL_LOC_T y);
  * ==================
  */
 
+/** Checks whether the value is or contains a dictionary. */
+bool rt_val_has_dict(struct Runtime *rt, VAL_LOC_T loc);
+
+/** Checks whether the value is or contains a reference, captures included. */
+bool rt_val_has_ptr(struct Runtime *rt, VAL_LOC_T loc);
+
 bool rt_val_eq_rec(struct Runtime *rt, VAL_LOC_T x, VAL_LOC_T y);
 bool rt_val_eq_bin(struct Runtime *rt, VAL_LOC_T x, VAL_LOC_T y);
 bool rt_val_string_eq(struct Runtime *rt, VAL_LOC_T loc, char *str);
@@ -0,0 +1,240 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "rt_val.h"
+#include "runtime.h"
+#include "stack.h"
+
+/*
+ * The dictionary value is laid out as follows:
+ * - the regular value header,
+ * - the capacity of the index,
+ * - the number of the entries,
+ * - the index: an open addressing table of the entry offsets,
+ * - the entries: the key value followed by the mapped value.
+ *
+ * The offsets in the index are relative to the beginning of the entries and
+ * shifted by one so that zero denotes an empty slot. Since everything is
+ * relative to the value's own location, the dictionary may be freely copied
+ * around the stack like any other value.
+ */
+
+#define DICT_MIN_CAPACITY 4
+
+/* The index of the largest capacity takes half of the largest value. */
+#define DICT_MAX_CAPACITY 16384
+
+static VAL_SIZE_T rt_val_dict_peek_field(struct Stack *stack, VAL_LOC_T loc)
+{
+    VAL_SIZE_T result;
+    memcpy(&result, stack->buffer + loc, VAL_SIZE_BYTES);
+    return result;
+}
+
+static void rt_val_dict_poke_field(
+        struct Stack *stack,
+        VAL_LOC_T loc,
+        VAL_SIZE_T value)
+{
+    memcpy(stack->buffer + loc, &value, VAL_SIZE_BYTES);
+}
+
+static VAL_LOC_T rt_val_dict_cap_loc(VAL_LOC_T loc)
+{
+    return loc + VAL_HEAD_BYTES;
+}
+
+static VAL_LOC_T rt_val_dict_count_loc(VAL_LOC_T loc)
+{
+    return loc + VAL_HEAD_BYTES + VAL_SIZE_BYTES;
+}
+
+static VAL_LOC_T rt_val_dict_index_loc(VAL_LOC_T loc)
+{
+    return loc + VAL_HEAD_BYTES + 2 * VAL_SIZE_BYTES;
+}
+
+/** FNV-1a over the binary representation of the key. */
+static uint32_t rt_val_dict_hash(struct Stack *stack, VAL_LOC_T key_loc)
+{
+    uint32_t hash = 2166136261u;
+    unsigned char *current = (unsigned char*)stack->buffer + key_loc;
+    unsigned char *end = current +
+        rt_val_peek_size(stack, key_loc) + VAL_HEAD_BYTES;
+
+    while (current != end) {
+        hash ^= *current++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static bool rt_val_dict_key_eq(struct Stack *stack, VAL_LOC_T x, VAL_LOC_T y)
+{
+    VAL_SIZE_T x_size = rt_val_peek_size(stack, x);
+    VAL_SIZE_T y_size = rt_val_peek_size(stack, y);
+
+    return x_size == y_size && memcmp(
+            stack->buffer + x,
+            stack->buffer + y,
+            x_size + VAL_HEAD_BYTES) == 0;
+}
+
+/**
+ * Finds the index slot of the given key. Returns the location of either the
+ * slot referring to an equal key or the empty slot where the key belongs.
+ */
+static VAL_LOC_T rt_val_dict_find_slot(
+        struct Stack *stack,
+        VAL_LOC_T loc,
+        VAL_LOC_T key_loc)
+{
+    VAL_SIZE_T cap = rt_val_dict_cap(stack, loc);
+    VAL_LOC_T index_loc = rt_val_dict_index_loc(loc);
+    VAL_LOC_T entries_loc = rt_val_dict_first_loc(stack, loc);
+    uint32_t slot = rt_val_dict_hash(stack, key_loc) & (cap - 1);
+
+    for (;;) {
+        VAL_LOC_T slot_loc = index_loc + slot * VAL_SIZE_BYTES;
+        VAL_SIZE_T offset = rt_val_dict_peek_field(stack, slot_loc);
+        if (offset == 0 ||
+            rt_val_dict_key_eq(stack, entries_loc + offset - 1, key_loc)) {
+            return slot_loc;
+        }
+        slot = (slot + 1) & (cap - 1);
+    }
+}
+
+VAL_SIZE_T rt_val_dict_capacity_for(int count)
+{
+    VAL_SIZE_T cap = DICT_MIN_CAPACITY;
+    while (cap < 2 * count && cap < DICT_MAX_CAPACITY) {
+        cap *= 2;
+    }
+    return cap;
+}
+
+void rt_val_push_dict_init(
+        struct Stack *stack,
+        VAL_SIZE_T capacity,
+        VAL_LOC_T *dict_loc)
+{
+    VAL_HEAD_TYPE_T type = (VAL_HEAD_TYPE_T)VAL_DICT;
+    VAL_SIZE_T size = 2 * VAL_SIZE_BYTES + capacity * VAL_SIZE_BYTES;
+    VAL_SIZE_T i;
+
+    *dict_loc = stack_push(stack, VAL_HEAD_TYPE_BYTES, (char*)&type);
+    stack_push(stack, VAL_HEAD_SIZE_BYTES, (char*)&size);
+    stack_push(stack, VAL_SIZE_BYTES, (char*)&capacity);
+    stack_push(stack, VAL_SIZE_BYTES, (char*)&zero);
+
+    for (i = 0; i < capacity; ++i) {
+        stack_push(stack, VAL_SIZE_BYTES, (char*)&zero);
+    }
+}
+
+bool rt_val_push_dict_entry(
+        struct Stack *stack,
+        VAL_LOC_T dict_loc,
+        VAL_LOC_T key_loc,
+        VAL_LOC_T value_loc)
+{
+    VAL_LOC_T new_key_loc = stack->top;
+    rt_val_push_copy(stack, key_loc);
+    rt_val_push_copy(stack, value_loc);
+    if (!rt_val_dict_adopt_entry(stack, dict_loc, new_key_loc)) {
+        stack->top = new_key_loc;
+        return false;
+    }
+    return true;
+}
+
+bool rt_val_dict_adopt_entry(
+        struct Stack *stack,
+        VAL_LOC_T dict_loc,
+        VAL_LOC_T key_loc)
+{
+    VAL_LOC_T slot_loc, offset, count_loc;
+
+    /* The size and the offsets of the entries are stored on 16 bits. */
+    if (stack->top - dict_loc - VAL_HEAD_BYTES > UINT16_MAX) {
+        return false;
+    }
+
+    slot_loc = rt_val_dict_find_slot(stack, dict_loc, key_loc);
+    offset = key_loc - rt_val_dict_first_loc(stack, dict_loc) + 1;
+    count_loc = rt_val_dict_count_loc(dict_loc);
+
+    rt_val_dict_poke_field(stack, slot_loc, (VAL_SIZE_T)offset);
+    rt_val_dict_poke_field(
+        stack,
+        count_loc,
+        rt_val_dict_peek_field(stack, count_loc) + 1);
+    rt_val_dict_poke_field(
+        stack,
+        dict_loc + VAL_HEAD_TYPE_BYTES,
+        (VAL_SIZE_T)(stack->top - dict_loc - VAL_HEAD_BYTES));
+
+    return true;
+}
+
+bool rt_val_is_hashable(struct Runtime *rt, VAL_LOC_T loc)
+{
+    VAL_LOC_T current, end;
+
+    switch (rt_val_peek_type(&rt->stack, loc)) {
+    case VAL_BOOL:
+    case VAL_CHAR:
+    case VAL_INT:
+        return true;
+
+    case VAL_ARRAY:
+    case VAL_TUPLE:
+        current = rt_val_cpd_first_loc(loc);
+        end = current + rt_val_peek_size(&rt->stack, loc);
+        while (current != end) {
+            if (!rt_val_is_hashable(rt, current)) {
+                return false;
+            }
+            current = rt_val_next_loc(rt, current);
+        }
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+VAL_SIZE_T rt_val_dict_cap(struct Stack *stack, VAL_LOC_T loc)
+{
+    return rt_val_dict_peek_field(stack, rt_val_dict_cap_loc(loc));
+}
+
+int rt_val_dict_len(struct Stack *stack, VAL_LOC_T loc)
+{
+    return rt_val_dict_peek_field(stack, rt_val_dict_count_loc(loc));
+}
+
+VAL_LOC_T rt_val_dict_first_loc(struct Stack *stack, VAL_LOC_T loc)
+{
+    return rt_val_dict_index_loc(loc) +
+        rt_val_dict_cap(stack, loc) * VAL_SIZE_BYTES;
+}
+
+VAL_LOC_T rt_val_dict_find(
+        struct Stack *stack,
+        VAL_LOC_T loc,
+        VAL_LOC_T key_loc)
+{
+    VAL_LOC_T slot_loc = rt_val_dict_find_slot(stack, loc, key_loc);
+    VAL_SIZE_T offset = rt_val_dict_peek_field(stack, slot_loc);
+
+    if (offset == 0) {
+        return -1;
+    } else {
+        return rt_val_dict_first_loc(stack, loc) + offset - 1;
+    }
+}
@@ -30,6 +30,21 @@ static void rt_val_to_string_compound(struct Runtime *rt, VAL_LOC_T x, char **st
     }
 }
 
+static void rt_val_to_string_dict(struct Runtime *rt, VAL_LOC_T x, char **str)
+{
+    int i, len = rt_val_dict_len(&rt->stack, x);
+    VAL_LOC_T item = rt_val_dict_first_loc(&rt->stack, x);
+    for (i = 0; i < len; ++i) {
+        str_append(*str, "{ ");
+        rt_val_to_string(rt, item, str);
+        str_append(*str, " ");
+        item = rt_val_next_loc(rt, item);
+        rt_val_to_string(rt, item, str);
+        str_append(*str, " } ");
+        item = rt_val_next_loc(rt, item);
+    }
+}
+
 static void rt_val_to_string_datatype(struct Runtime *rt, VAL_LOC_T x, char **str)
 {
     int i, len = rt_val_datatype_len(rt, x);
@@ -86,6 +101,12 @@ void rt_val_to_string(struct Runtime *rt, VAL_LOC_T x, char **str)
         str_append(*str, "}");
         break;
 
+    case VAL_DICT:
+        str_append(*str, "(dict [ ");
+        rt_val_to_string_dict(rt, x, str);
+        str_append(*str, "])");
+        break;
+
     case VAL_FUNCTION:
         str_append(*str, "function");
         break;
@@ -94,6 +115,18 @@ void rt_val_to_string(struct Runtime *rt, VAL_LOC_T x, char **str)
         str_append(*str, "pointer");
         break;
 
+    case VAL_SEQ:
+        str_append(*str, "sequence");
+        break;
+
+    case VAL_SAMPLER:
+        str_append(*str, "sampler");
+        break;
+
+    case VAL_CHANNEL:
+        str_append(*str, "channel");
+        break;
+
     case VAL_UNIT:
         str_append(*str, "unit");
         break;
@@ -171,6 +204,10 @@ void rt_val_print(struct Runtime *rt, VAL_LOC_T loc, bool annotate)
                 str_append(buffer, "tuple :: ");
                 break;
 
+            case VAL_DICT:
+                str_append(buffer, "dict :: ");
+                break;
+
             case VAL_FUNCTION:
                 str_append(buffer, "function :: ");
                 break;
@@ -179,6 +216,18 @@ void rt_val_print(struct Runtime *rt, VAL_LOC_T loc, bool annotate)
                 str_append(buffer, "pointer :: ");
                 break;
 
+            case VAL_SEQ:
+                str_append(buffer, "sequence :: ");
+                break;
+
+            case VAL_SAMPLER:
+                str_append(buffer, "sampler :: ");
+                break;
+
+            case VAL_CHANNEL:
+                str_append(buffer, "channel :: ");
+                break;
+
             case VAL_UNIT:
                 str_append(buffer, "unit :: ");
                 break;
@@ -320,6 +369,47 @@ VAL_LOC_T rt_val_datatype_first_loc(VAL_LOC_T loc)
     return loc + VAL_HEAD_BYTES + datatype_embellishment_size;
 }
 
+enum ValueSeqKind rt_val_peek_seq_kind(struct Runtime *rt, VAL_LOC_T loc)
+{
+    enum ValueSeqKind result;
+    memcpy(&result, rt->stack.buffer + loc + VAL_HEAD_BYTES, seq_kind_size);
+    return result;
+}
+
+VAL_LOC_T rt_val_seq_first_loc(VAL_LOC_T loc)
+{
+    return loc + VAL_HEAD_BYTES + seq_kind_size;
+}
+
+VAL_SIZE_T rt_val_sampler_len(struct Runtime *rt, VAL_LOC_T loc)
+{
+    return rt_val_peek_size(&rt->stack, loc) / VAL_SAMPLER_ENTRY_BYTES;
+}
+
+void rt_val_peek_sampler_entry(
+        struct Runtime *rt,
+        VAL_LOC_T loc,
+        VAL_INT_T index,
+        VAL_REAL_T *prob,
+        VAL_INT_T *alias)
+{
+    char *entry = rt->stack.buffer + loc + VAL_HEAD_BYTES +
+        index * VAL_SAMPLER_ENTRY_BYTES;
+    memcpy(prob, entry, VAL_REAL_BYTES);
+    memcpy(alias, entry + VAL_REAL_BYTES, VAL_INT_BYTES);
+}
+
+void rt_val_peek_channel(
+        struct Runtime *rt,
+        VAL_LOC_T loc,
+        VAL_INT_T *sched_id,
+        VAL_INT_T *index)
+{
+    char *data = rt->stack.buffer + loc + VAL_HEAD_BYTES;
+    memcpy(sched_id, data, VAL_INT_BYTES);
+    memcpy(index, data + VAL_INT_BYTES, VAL_INT_BYTES);
+}
+
 char* rt_val_peek_cpd_as_string(struct Runtime *rt, VAL_LOC_T loc)
 {
     VAL_LOC_T current = rt_val_cpd_first_loc(loc);
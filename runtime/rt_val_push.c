@@ -11,15 +11,7 @@
 void rt_val_push_copy(struct Stack *stack, VAL_LOC_T location)
 {
     struct ValueHeader header = rt_val_peek_header(stack, location);
-
-    VAL_LOC_T size = header.size + VAL_HEAD_BYTES;
-
-    char *temp_buffer = mem_malloc(size);
-    memcpy(temp_buffer, stack->buffer + location, size);
-
-    stack_push(stack, size, temp_buffer);
-
-    mem_free(temp_buffer);
+    stack_push_copy(stack, location, header.size + VAL_HEAD_BYTES);
 }
 
 void rt_val_push_bool(struct Stack *stack, VAL_BOOL_T value)
@@ -131,6 +123,55 @@ void rt_val_push_datatype_final(
     memcpy(stack->buffer + size_loc, &size, VAL_HEAD_SIZE_BYTES);
 }
 
+void rt_val_push_seq_init(
+        struct Stack *stack,
+        enum ValueSeqKind kind,
+        VAL_LOC_T *size_loc)
+{
+    VAL_HEAD_TYPE_T type = (VAL_HEAD_TYPE_T)VAL_SEQ;
+    stack_push(stack, VAL_HEAD_TYPE_BYTES, (char*)&type);
+    *size_loc = stack_push(stack, VAL_HEAD_SIZE_BYTES, (char*)&zero);
+    stack_push(stack, seq_kind_size, (char*)&kind);
+}
+
+void rt_val_push_seq_final(
+        struct Stack *stack,
+        VAL_LOC_T size_loc,
+        VAL_SIZE_T size)
+{
+    memcpy(stack->buffer + size_loc, &size, VAL_HEAD_SIZE_BYTES);
+}
+
+void rt_val_push_sampler(
+        struct Stack *stack,
+        VAL_REAL_T *probs,
+        VAL_INT_T *aliases,
+        VAL_SIZE_T count)
+{
+    VAL_SIZE_T i;
+    VAL_HEAD_TYPE_T type = (VAL_HEAD_TYPE_T)VAL_SAMPLER;
+    VAL_HEAD_SIZE_T size = count * VAL_SAMPLER_ENTRY_BYTES;
+    stack_push(stack, VAL_HEAD_TYPE_BYTES, (char*)&type);
+    stack_push(stack, VAL_HEAD_SIZE_BYTES, (char*)&size);
+    for (i = 0; i < count; ++i) {
+        stack_push(stack, VAL_REAL_BYTES, (char*)(probs + i));
+        stack_push(stack, VAL_INT_BYTES, (char*)(aliases + i));
+    }
+}
+
+void rt_val_push_channel(
+        struct Stack *stack,
+        VAL_INT_T sched_id,
+        VAL_INT_T index)
+{
+    VAL_HEAD_TYPE_T type = (VAL_HEAD_TYPE_T)VAL_CHANNEL;
+    VAL_HEAD_SIZE_T size = VAL_CHANNEL_BYTES;
+    stack_push(stack, VAL_HEAD_TYPE_BYTES, (char*)&type);
+    stack_push(stack, VAL_HEAD_SIZE_BYTES, (char*)&size);
+    stack_push(stack, VAL_INT_BYTES, (char*)&sched_id);
+    stack_push(stack, VAL_INT_BYTES, (char*)&index);
+}
+
 void rt_val_push_func_init(
         struct Stack *stack,
         VAL_LOC_T *size_loc,
@@ -1,6 +1,11 @@
 /* Copyright (C) 2014-2016 Krzysztof Stachowiak */
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include "memory.h"
 #include "stack.h"
@@ -9,6 +14,37 @@
 #include "runtime.h"
 #include "rt_val.h"
 #include "bif.h"
+#include "task.h"
+
+/* The number of the steps between the checks of the deadline, frequent
+ * enough to notice it within a fraction of a millisecond. */
+#define RT_BUDGET_INTERVAL 1024
+
+struct RtSharedStore {
+    atomic_int refs;
+    struct AstNode *nodes;
+    struct RtSharedStore *parent;
+};
+
+static struct RtSharedStore *rt_store_acquire(struct RtSharedStore *store)
+{
+    if (store) {
+        atomic_fetch_add(&store->refs, 1);
+    }
+    return store;
+}
+
+static void rt_store_release(struct RtSharedStore *store)
+{
+    while (store && atomic_fetch_sub(&store->refs, 1) == 1) {
+        struct RtSharedStore *parent = store->parent;
+        if (store->nodes) {
+            ast_node_free(store->nodes);
+        }
+        mem_free(store);
+        store = parent;
+    }
+}
 
 static void rt_free_stored(struct Runtime *rt)
 {
@@ -40,6 +76,46 @@ static void rt_init_bif(struct Runtime *rt, struct SymMap *sm)
     sym_map_insert(sm, "length", eval_bif(rt, bif_length, 1));
     sym_map_insert(sm, "at", eval_bif(rt, bif_at, 2));
     sym_map_insert(sm, "slice", eval_bif(rt, bif_slice, 3));
+    sym_map_insert(sm, "sort", eval_bif(rt, bif_sort, 1));
+    sym_map_insert(sm, "sort_cmp", eval_bif(rt, bif_sort_cmp, 2));
+    sym_map_insert(sm, "stable_sort", eval_bif(rt, bif_stable_sort, 2));
+    sym_map_insert(sm, "map", eval_bif(rt, bif_map, 2));
+    sym_map_insert(sm, "filter", eval_bif(rt, bif_filter, 2));
+    sym_map_insert(sm, "foldl", eval_bif(rt, bif_foldl, 3));
+    sym_map_insert(sm, "foldr", eval_bif(rt, bif_foldr, 3));
+    sym_map_insert(sm, "zip", eval_bif(rt, bif_zip, 2));
+    sym_map_insert(sm, "zip_with", eval_bif(rt, bif_zip_with, 3));
+    sym_map_insert(sm, "all_of", eval_bif(rt, bif_all_of, 3));
+    sym_map_insert(sm, "any_of", eval_bif(rt, bif_any_of, 3));
+    sym_map_insert(sm, "pmap", eval_bif(rt, bif_pmap, 2));
+    sym_map_insert(sm, "spawn", eval_bif(rt, bif_spawn, 1));
+    sym_map_insert(sm, "yield", eval_bif(rt, bif_yield, 0));
+    sym_map_insert(sm, "make_chan", eval_bif(rt, bif_make_chan, 1));
+    sym_map_insert(sm, "chan_send", eval_bif(rt, bif_chan_send, 2));
+    sym_map_insert(sm, "chan_recv", eval_bif(rt, bif_chan_recv, 1));
+    sym_map_insert(sm, "lazy", eval_bif(rt, bif_lazy, 1));
+    sym_map_insert(sm, "lazy_range", eval_bif(rt, bif_lazy_range, 2));
+    sym_map_insert(sm, "lazy_gen", eval_bif(rt, bif_lazy_gen, 2));
+    sym_map_insert(sm, "take", eval_bif(rt, bif_take, 2));
+    sym_map_insert(sm, "collect", eval_bif(rt, bif_collect, 1));
+    sym_map_insert(sm, "dict", eval_bif(rt, bif_dict, 1));
+    sym_map_insert(sm, "dict_len", eval_bif(rt, bif_dict_len, 1));
+    sym_map_insert(sm, "dict_keys", eval_bif(rt, bif_dict_keys, 1));
+    sym_map_insert(sm, "dict_has", eval_bif(rt, bif_dict_has, 2));
+    sym_map_insert(sm, "dict_get", eval_bif(rt, bif_dict_get, 2));
+    sym_map_insert(sm, "dict_put", eval_bif(rt, bif_dict_put, 3));
+    sym_map_insert(sm, "dict_remove", eval_bif(rt, bif_dict_remove, 2));
+    sym_map_insert(sm, "vec_add", eval_bif(rt, bif_vec_add, 2));
+    sym_map_insert(sm, "vec_sub", eval_bif(rt, bif_vec_sub, 2));
+    sym_map_insert(sm, "vec_mul", eval_bif(rt, bif_vec_mul, 2));
+    sym_map_insert(sm, "vec_div", eval_bif(rt, bif_vec_div, 2));
+    sym_map_insert(sm, "vec_eq", eval_bif(rt, bif_vec_eq, 2));
+    sym_map_insert(sm, "vec_lt", eval_bif(rt, bif_vec_lt, 2));
+    sym_map_insert(sm, "vec_sum", eval_bif(rt, bif_vec_sum, 1));
+    sym_map_insert(sm, "vec_min", eval_bif(rt, bif_vec_min, 1));
+    sym_map_insert(sm, "vec_max", eval_bif(rt, bif_vec_max, 1));
+    sym_map_insert(sm, "vec_dot", eval_bif(rt, bif_vec_dot, 2));
+    sym_map_insert(sm, "vec_scan", eval_bif(rt, bif_vec_scan, 1));
     sym_map_insert(sm, "print", eval_bif(rt, bif_print, 1));
     sym_map_insert(sm, "format", eval_bif(rt, bif_format, 2));
     sym_map_insert(sm, "to_string", eval_bif(rt, bif_to_string, 1));
@@ -54,6 +130,16 @@ static void rt_init_bif(struct Runtime *rt, struct SymMap *sm)
     sym_map_insert(sm, "rand_exp", eval_bif(rt, bif_rand_exp, 1));
     sym_map_insert(sm, "rand_gauss", eval_bif(rt, bif_rand_gauss, 2));
     sym_map_insert(sm, "rand_distr", eval_bif(rt, bif_rand_distr, 1));
+    sym_map_insert(sm, "rand_ui_array", eval_bif(rt, bif_rand_ui_array, 3));
+    sym_map_insert(sm, "rand_ur_array", eval_bif(rt, bif_rand_ur_array, 3));
+    sym_map_insert(sm, "rand_ber_array", eval_bif(rt, bif_rand_ber_array, 2));
+    sym_map_insert(sm, "rand_exp_array", eval_bif(rt, bif_rand_exp_array, 2));
+    sym_map_insert(sm, "rand_gauss_array", eval_bif(rt, bif_rand_gauss_array, 3));
+    sym_map_insert(sm, "rand_seed", eval_bif(rt, bif_rand_seed, 1));
+    sym_map_insert(sm, "rand_stream", eval_bif(rt, bif_rand_stream, 2));
+    sym_map_insert(sm, "make_sampler", eval_bif(rt, bif_make_sampler, 1));
+    sym_map_insert(sm, "rand_sample", eval_bif(rt, bif_rand_sample, 1));
+    sym_map_insert(sm, "rand_samples", eval_bif(rt, bif_rand_samples, 2));
     sym_map_insert(sm, "is_bool", eval_bif(rt, bif_is_bool, 1));
     sym_map_insert(sm, "is_int", eval_bif(rt, bif_is_int, 1));
     sym_map_insert(sm, "is_real", eval_bif(rt, bif_is_real, 1));
@@ -62,6 +148,31 @@ static void rt_init_bif(struct Runtime *rt, struct SymMap *sm)
     sym_map_insert(sm, "is_tuple", eval_bif(rt, bif_is_tuple, 1));
     sym_map_insert(sm, "is_function", eval_bif(rt, bif_is_function, 1));
     sym_map_insert(sm, "is_pointer", eval_bif(rt, bif_is_pointer, 1));
+    sym_map_insert(sm, "is_dict", eval_bif(rt, bif_is_dict, 1));
+    sym_map_insert(sm, "is_seq", eval_bif(rt, bif_is_seq, 1));
+    sym_map_insert(sm, "is_sampler", eval_bif(rt, bif_is_sampler, 1));
+    sym_map_insert(sm, "is_channel", eval_bif(rt, bif_is_channel, 1));
+}
+
+static void rt_budget_init(struct RtBudget *budget)
+{
+    budget->step_limit = 0;
+    budget->stack_limit = 0;
+    budget->time_limit_ms = 0;
+    budget->slice = 0;
+    budget->stack_max = PTRDIFF_MAX;
+    budget->steps = 0;
+    budget->countdown = INT64_MAX;
+    budget->armed = INT64_MAX;
+    budget->slice_end = 0;
+    budget->deadline_ns = 0;
+    budget->steps_origin = 0;
+}
+
+/** Counts the steps taken so far, including the ones not checked yet. */
+static int64_t rt_budget_steps(struct RtBudget *budget)
+{
+    return budget->steps + budget->armed - budget->countdown;
 }
 
 static void rt_init(struct Runtime *rt)
@@ -70,6 +181,17 @@ static void rt_init(struct Runtime *rt)
 
     stack_init(&rt->stack);
     rt->node_store = NULL;
+    rt->shared_store = NULL;
+    rt->bif_call = NULL;
+    cpprand_init(&rt->rand);
+    rt->pool = NULL;
+    rt->pool_size = pool_default_size();
+    rt->task = NULL;
+    rt->sched = fiber_sched_make();
+    rt->fiber = NULL;
+    rt_budget_init(&rt->budget);
+    atomic_init(&rt->interrupt_flag, false);
+    rt->interrupt = &rt->interrupt_flag;
 
     gsm = &rt->global_sym_map;
     sym_map_init_global(gsm);
@@ -82,8 +204,16 @@ static void rt_init(struct Runtime *rt)
 
 static void rt_deinit(struct Runtime *rt)
 {
+    /* The fibers are unwound first, while everything they refer to exists. */
+    if (rt->sched && !rt->fiber) {
+        fiber_sched_free(rt->sched);
+    }
+    if (rt->pool) {
+        pool_free(rt->pool);
+    }
     dbg_deinit(&rt->debugger);
     rt_free_stored(rt);
+    rt_store_release(rt->shared_store);
     sym_map_deinit(&rt->global_sym_map);
     stack_deinit(&rt->stack);
 }
@@ -95,10 +225,83 @@ struct Runtime *rt_make(void)
     return result;
 }
 
+struct Runtime *rt_clone(struct Runtime *rt)
+{
+    struct Runtime *result = mem_malloc(sizeof(*result));
+
+    /* The ASTs retained so far become immutable, the source runtime keeps
+     * retaining the further ones on its own. */
+    if (rt->node_store) {
+        struct RtSharedStore *store = mem_malloc(sizeof(*store));
+        atomic_init(&store->refs, 1);
+        store->nodes = rt->node_store;
+        store->parent = rt->shared_store;
+        rt->shared_store = store;
+        rt->node_store = NULL;
+        rt->saved_store = NULL;
+    }
+
+    stack_init_copy(&result->stack, &rt->stack);
+    sym_map_init_copy(&result->global_sym_map, &rt->global_sym_map);
+    dbg_init(&result->debugger);
+    result->node_store = NULL;
+    result->shared_store = rt_store_acquire(rt->shared_store);
+    result->debug = rt->debug;
+    result->bif_call = NULL;
+    cpprand_init(&result->rand);
+    result->pool = NULL;
+    result->pool_size = rt->pool_size;
+    result->task = NULL;
+    result->sched = fiber_sched_make();
+    result->fiber = NULL;
+    rt_budget_init(&result->budget);
+    result->budget.step_limit = rt->budget.step_limit;
+    result->budget.stack_limit = rt->budget.stack_limit;
+    result->budget.time_limit_ms = rt->budget.time_limit_ms;
+    result->budget.slice = rt->budget.slice;
+    atomic_init(&result->interrupt_flag, false);
+    result->interrupt = &result->interrupt_flag;
+    result->saved_loc = result->stack.top;
+    result->saved_store = NULL;
+
+    return result;
+}
+
+struct Runtime *rt_make_worker(struct Runtime *rt, uint64_t seed, uint64_t stream)
+{
+    struct Runtime *result = mem_malloc(sizeof(*result));
+
+    stack_init_copy(&result->stack, &rt->stack);
+    sym_map_init_global(&result->global_sym_map);
+    dbg_init(&result->debugger);
+    result->node_store = NULL;
+    result->shared_store = NULL;
+    result->debug = false;
+    result->bif_call = NULL;
+    cpprand_seed(&result->rand, seed, stream);
+    result->pool = NULL;
+    result->pool_size = 0;
+    result->task = NULL;
+    result->sched = NULL;
+    result->fiber = NULL;
+    result->budget = rt->budget;
+    result->budget.steps_origin = rt_budget_steps(&rt->budget);
+    atomic_init(&result->interrupt_flag, false);
+    result->interrupt = rt->interrupt;
+    result->saved_loc = result->stack.top;
+    result->saved_store = NULL;
+
+    return result;
+}
+
 void rt_reset(struct Runtime *rt)
 {
+    int pool_size = rt->pool_size;
+    struct RtBudget budget = rt->budget;
     rt_deinit(rt);
     rt_init(rt);
+    rt->pool_size = pool_size;
+    rt->budget = budget;
 }
 
 void rt_free(struct Runtime *rt)
@@ -107,6 +310,167 @@ void rt_free(struct Runtime *rt)
     mem_free(rt);
 }
 
+void rt_seed(struct Runtime *rt, uint64_t seed, uint64_t stream)
+{
+    cpprand_seed(&rt->rand, seed, stream);
+}
+
+/* Budget.
+ * =======
+ */
+
+static int64_t rt_budget_now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void rt_budget_arm(struct Runtime *rt)
+{
+    struct RtBudget *budget = &rt->budget;
+    int64_t countdown = INT64_MAX;
+
+    if (budget->time_limit_ms > 0) {
+        countdown = RT_BUDGET_INTERVAL;
+    }
+    if (budget->step_limit > 0 && budget->step_limit - budget->steps + 1 < countdown) {
+        countdown = budget->step_limit - budget->steps + 1;
+    }
+    if (budget->slice > 0 && rt->task && budget->slice_end - budget->steps < countdown) {
+        countdown = budget->slice_end - budget->steps;
+    }
+
+    budget->countdown = countdown;
+    budget->armed = countdown;
+}
+
+void rt_budget_start(struct Runtime *rt)
+{
+    struct RtBudget *budget = &rt->budget;
+
+    budget->stack_max = budget->stack_limit > 0 ? budget->stack_limit : PTRDIFF_MAX;
+    budget->steps = 0;
+    budget->slice_end = budget->slice;
+    if (budget->time_limit_ms > 0) {
+        budget->deadline_ns = rt_budget_now_ns() + budget->time_limit_ms * 1000000;
+    }
+
+    rt_budget_arm(rt);
+}
+
+bool rt_budget_check(struct Runtime *rt)
+{
+    struct RtBudget *budget = &rt->budget;
+
+    budget->steps += budget->armed - budget->countdown;
+
+    /* An exhausted budget keeps failing each following step. */
+    budget->countdown = 1;
+    budget->armed = 1;
+
+    if (rt->stack.top > budget->stack_max) {
+        err_push("EVAL", "Evaluation stack limit of %td bytes exceeded", budget->stack_limit);
+        return false;
+    }
+
+    if (budget->step_limit > 0 && budget->steps > budget->step_limit) {
+        err_push("EVAL", "Evaluation step limit of %lld exceeded", (long long)budget->step_limit);
+        return false;
+    }
+
+    if (budget->time_limit_ms > 0 && rt_budget_now_ns() >= budget->deadline_ns) {
+        err_push("EVAL", "Evaluation time limit of %lld ms exceeded", (long long)budget->time_limit_ms);
+        return false;
+    }
+
+    /* The time spent preempted counts against the deadline too. */
+    if (budget->slice > 0 && rt->task && budget->steps >= budget->slice_end) {
+        if (!task_preempt(rt->task)) {
+            return false;
+        }
+        while (budget->slice_end <= budget->steps) {
+            budget->slice_end += budget->slice;
+        }
+    }
+
+    rt_budget_arm(rt);
+    return true;
+}
+
+void rt_budget_charge(struct Runtime *rt, struct Runtime *worker)
+{
+    rt->budget.steps += rt_budget_steps(&worker->budget) - worker->budget.steps_origin;
+}
+
+void rt_interrupt(struct Runtime *rt)
+{
+    atomic_store(rt->interrupt, true);
+}
+
+void rt_clear_interrupt(struct Runtime *rt)
+{
+    atomic_store(rt->interrupt, false);
+}
+
+bool rt_check_interrupt(struct Runtime *rt)
+{
+    /* Only the flag itself is communicated, it needs no ordering. */
+    if (atomic_load_explicit(rt->interrupt, memory_order_relaxed)) {
+        err_push("EVAL", "Evaluation interrupted");
+        return false;
+    }
+    return true;
+}
+
+void rt_set_pool_size(struct Runtime *rt, int size)
+{
+    if (rt->pool) {
+        pool_free(rt->pool);
+        rt->pool = NULL;
+    }
+    rt->pool_size = size;
+}
+
+void rt_run_tasks(struct Runtime *rt, PoolTask task, void *data, int count)
+{
+    int i;
+
+    if (rt->pool_size == 0) {
+        for (i = 0; i < count; ++i) {
+            task(data, i);
+        }
+        return;
+    }
+
+    if (!rt->pool) {
+        rt->pool = pool_make(rt->pool_size);
+    }
+    pool_run(rt->pool, task, data, count);
+}
+
+struct AstNode **rt_retained_lists(struct Runtime *rt, int *count)
+{
+    struct RtSharedStore *store;
+    struct AstNode **result;
+
+    *count = rt->node_store ? 1 : 0;
+    for (store = rt->shared_store; store; store = store->parent) {
+        ++*count;
+    }
+
+    result = mem_malloc(*count * sizeof(*result) + 1);
+    *count = 0;
+    if (rt->node_store) {
+        result[(*count)++] = rt->node_store;
+    }
+    for (store = rt->shared_store; store; store = store->parent) {
+        result[(*count)++] = store->nodes;
+    }
+
+    return result;
+}
+
 void rt_save(struct Runtime *rt)
 {
     rt->saved_loc = rt->stack.top;
@@ -136,18 +500,46 @@ void rt_register_clif_handler(
         eval_clif(rt, handler, arity));
 }
 
-bool rt_consume_one(
+void rt_register_async_clif_handler(
+        struct Runtime *rt,
+        char *symbol,
+        int arity,
+        AsyncClifHandler handler)
+{
+    sym_map_insert(
+        &rt->global_sym_map,
+        symbol,
+        eval_async_clif(rt, handler, arity));
+}
+
+void rt_register_direct_clif_handler(
+        struct Runtime *rt,
+        char *symbol,
+        int arity,
+        DirectClifHandler handler)
+{
+    sym_map_insert(
+        &rt->global_sym_map,
+        symbol,
+        eval_direct_clif(rt, handler, arity));
+}
+
+static void rt_retain(struct Runtime *rt, struct AstNode *ast)
+{
+    ast->next = rt->node_store;
+    rt->node_store = ast;
+}
+
+bool rt_consume_shared(
         struct Runtime *rt,
         struct AstNode *ast,
         struct AstLocMap *alm,
         VAL_LOC_T *loc,
-        struct AstNode **next)
+        bool *retained)
 {
     VAL_LOC_T begin, result;
-
-    if (next) {
-        *next = ast->next;
-    }
+    int spawn_count = fiber_spawn_count(rt->sched);
+    bool spawned;
 
     begin = rt->stack.top;
     result = eval(ast, rt, &rt->global_sym_map, alm);
@@ -156,23 +548,59 @@ bool rt_consume_one(
         *loc = result;
     }
 
+    /* The fibers spawned by the node may call the functions defined in it
+     * long after it has been consumed. */
+    spawned = fiber_spawn_count(rt->sched) != spawn_count;
+    *retained = false;
+
     if (err_state()) {
         err_push_src("RUNTIME", alm_try_get(alm, ast), "Failed consuming AST node");
-        ast_node_free_one(ast);
+        if (spawned) {
+            rt_retain(rt, ast);
+            *retained = true;
+        }
         return false;
 
     } else if (ast->type == AST_SPECIAL && ast->data.special.type == AST_SPEC_BIND) {
-        ast->next = rt->node_store;
-        rt->node_store = ast;
+        rt_retain(rt, ast);
+        *retained = true;
+
+    } else if (spawned) {
+        rt->stack.top = begin;
+        rt_retain(rt, ast);
+        *retained = true;
 
     } else {
         rt->stack.top = begin; /* Discard result value to save the stack. */
-        ast_node_free(ast);
     }
 
     return true;
 }
 
+bool rt_consume_one(
+        struct Runtime *rt,
+        struct AstNode *ast,
+        struct AstLocMap *alm,
+        VAL_LOC_T *loc,
+        struct AstNode **next)
+{
+    bool result, retained;
+
+    if (next) {
+        *next = ast->next;
+    }
+
+    result = rt_consume_shared(rt, ast, alm, loc, &retained);
+
+    if (!retained && result) {
+        ast_node_free(ast);
+    } else if (!retained) {
+        ast_node_free_one(ast);
+    }
+
+    return result;
+}
+
 bool rt_consume_list(
         struct Runtime *rt,
         struct AstNode *ast_list,
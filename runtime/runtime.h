@@ -3,32 +3,175 @@
 #ifndef RUNTIME_H
 #define RUNTIME_H
 
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "dbg.h"
 #include "ast.h"
 #include "stack.h"
 #include "symmap.h"
 #include "ast_loc_map.h"
+#include "cpprand.h"
+#include "pool.h"
+#include "fiber.h"
 #include "moon.h"
 
+/**
+ * State of the BIF call being currently evaluated. The temporaries are the
+ * argument values evaluated for this very call, which are discarded once the
+ * BIF returns, therefore the BIF may reuse them in place to build its result.
+ * The scope of the call site is needed by the BIFs calling back functions
+ * passed to them as arguments.
+ */
+struct BifCall {
+    VAL_LOC_T temp_begin;
+    bool temp_consumed;
+    struct SymMap *sym_map;
+    struct AstLocMap *alm;
+};
+
+/**
+ * The retained ASTs of a runtime, which the function values on its stack
+ * refer to, are handed over to a store shared with its clones when the
+ * runtime is cloned. The store is released by the last of them.
+ */
+struct RtSharedStore;
+
+/**
+ * The limits of an execution of the runtime, zero meaning no limit, and the
+ * state of their accounting. The steps are the evaluated expressions and
+ * the stack limit bounds the bytes in use by the values. A task is preempted
+ * each time it has taken another slice of steps.
+ *
+ * The evaluation only decrements the countdown and compares the top of the
+ * stack with the highest one allowed. The full check is made when the
+ * countdown runs out, which happens at the next step that may exceed a limit
+ * or end the slice, or often enough to notice the deadline in time.
+ */
+struct RtBudget {
+    int64_t step_limit;
+    VAL_LOC_T stack_limit;
+    int64_t time_limit_ms;
+    int64_t slice;
+
+    VAL_LOC_T stack_max;
+    int64_t steps;
+    int64_t countdown;
+    int64_t armed;
+    int64_t slice_end;
+    int64_t deadline_ns;
+
+    /* The steps of the parent of a worker when the worker was made. */
+    int64_t steps_origin;
+};
+
 struct Runtime {
     struct Stack stack;
     struct SymMap global_sym_map;
     struct Debugger debugger;
 
     struct AstNode *node_store;
+    struct RtSharedStore *shared_store;
 
     bool debug;
 
+    struct BifCall *bif_call;
+
+    struct CppRand rand;
+
+    /* The pool is only started by the first parallel call. */
+    struct Pool *pool;
+    int pool_size;
+
+    /* Set while evaluating a task, which asynchronous CLIFs suspend. */
+    struct MoonTask *task;
+
+    /* The fibers are shared with the workers evaluating them, each of which
+     * knows its own fiber. The parallel workers have none. */
+    struct FiberSched *sched;
+    struct Fiber *fiber;
+
+    /* The workers are given a copy of the budget left to the caller, which
+     * is charged the steps they have taken once they are done. */
+    struct RtBudget budget;
+
+    /* Raised by any thread to interrupt the evaluation. The workers poll
+     * the flag of the runtime that has made them. */
+    atomic_bool interrupt_flag;
+    atomic_bool *interrupt;
+
     VAL_LOC_T saved_loc;
     struct AstNode *saved_store;
 };
 
 struct Runtime *rt_make(void);
+struct Runtime *rt_clone(struct Runtime *rt);
+
+/**
+ * Makes a runtime evaluating on a copy of the stack of the given one, which
+ * lets it call the function values found there within the scopes of the
+ * source runtime. The scopes are only read, but the source runtime must not
+ * change until the worker is freed. Workers evaluate parallel calls
+ * sequentially, they have no pool of their own, nor fibers.
+ */
+struct Runtime *rt_make_worker(struct Runtime *rt, uint64_t seed, uint64_t stream);
 void rt_reset(struct Runtime *rt);
 void rt_free(struct Runtime *rt);
 
+void rt_seed(struct Runtime *rt, uint64_t seed, uint64_t stream);
+
+/** Starts accounting a new execution against the limits of the budget. */
+void rt_budget_start(struct Runtime *rt);
+
+/**
+ * Checks the budget when the countdown has run out or the stack has grown
+ * beyond the limit. Reports an error if a limit has been exceeded, otherwise
+ * preempts the current task if its slice is over.
+ */
+bool rt_budget_check(struct Runtime *rt);
+
+/**
+ * Charges the steps taken by a worker to the runtime that has made it, so
+ * that concurrent evaluations share one step limit. The limits are checked
+ * by the next rt_budget_check.
+ */
+void rt_budget_charge(struct Runtime *rt, struct Runtime *worker);
+
+/**
+ * Makes the evaluation in progress, or the next one if there is none, fail
+ * at its next function call or loop iteration. May be called by any thread.
+ */
+void rt_interrupt(struct Runtime *rt);
+
+/** Drops the interrupt once the evaluation it was meant for has ended. */
+void rt_clear_interrupt(struct Runtime *rt);
+
+/** Reports an error if the evaluation has been interrupted. */
+bool rt_check_interrupt(struct Runtime *rt);
+
+/** Sets the number of the worker threads, stopping the current ones. */
+void rt_set_pool_size(struct Runtime *rt, int size);
+
+/**
+ * Runs the tasks on the pool of the runtime, starting it if needed, or on
+ * the calling thread alone if the pool is empty.
+ */
+void rt_run_tasks(struct Runtime *rt, PoolTask task, void *data, int count);
+
+/**
+ * Returns the heads of the lists of the ASTs retained by the runtime, which
+ * include the ones shared with its clones. The caller must free the array.
+ */
+struct AstNode **rt_retained_lists(struct Runtime *rt, int *count);
+
+/**
+ * Writes the image of the runtime to a file. The image may only be loaded by
+ * the very same build of the program, which is checked upon loading.
+ */
+bool rt_image_dump(struct Runtime *rt, char *filename);
+struct Runtime *rt_image_load(char *filename);
+
 void rt_save(struct Runtime *rt);
 void rt_restore(struct Runtime *rt);
 
@@ -38,6 +181,30 @@ void rt_register_clif_handler(
         int arity,
         ClifHandler handler);
 
+void rt_register_async_clif_handler(
+        struct Runtime *rt,
+        char *symbol,
+        int arity,
+        AsyncClifHandler handler);
+
+void rt_register_direct_clif_handler(
+        struct Runtime *rt,
+        char *symbol,
+        int arity,
+        DirectClifHandler handler);
+
+/**
+ * Evaluates the node like rt_consume_one, but only takes the node over if it
+ * must be retained by the runtime, as reported through retained. Otherwise
+ * the node is left to the caller, who may evaluate it again.
+ */
+bool rt_consume_shared(
+        struct Runtime *rt,
+        struct AstNode *ast,
+        struct AstLocMap *alm,
+        VAL_LOC_T *loc,
+        bool *retained);
+
 bool rt_consume_one(
         struct Runtime *rt,
         struct AstNode *ast,
@@ -18,11 +18,28 @@ void stack_init(struct Stack *stack)
     stack->top = 1;
 }
 
+void stack_init_copy(struct Stack *stack, struct Stack *src)
+{
+    stack->buffer = mem_malloc(src->size);
+    stack->size = src->size;
+    stack->top = src->top;
+    memcpy(stack->buffer, src->buffer, src->top);
+}
+
 void stack_deinit(struct Stack *stack)
 {
     mem_free(stack->buffer);
 }
 
+static void stack_reserve(struct Stack *stack, VAL_LOC_T size)
+{
+    while (stack->top + size >= stack->size) {
+        VAL_LOC_T new_size = (VAL_LOC_T)(stack->size * 1.5);
+        stack->buffer = mem_realloc(stack->buffer, new_size);
+        stack->size = new_size;
+    }
+}
+
 VAL_LOC_T stack_push(struct Stack *stack, VAL_LOC_T size, char *data)
 {
     char *dst;
@@ -31,11 +48,7 @@ VAL_LOC_T stack_push(struct Stack *stack, VAL_LOC_T size, char *data)
         return stack->top;
     }
 
-    while (stack->top + size >= stack->size) {
-        VAL_LOC_T new_size = (VAL_LOC_T)(stack->size * 1.5);
-        stack->buffer = mem_realloc(stack->buffer, new_size);
-        stack->size = new_size;
-    }
+    stack_reserve(stack, size);
 
     dst = stack->buffer + stack->top;
     memcpy(dst, data, size);
@@ -44,6 +57,23 @@ VAL_LOC_T stack_push(struct Stack *stack, VAL_LOC_T size, char *data)
     return stack->top - size;
 }
 
+VAL_LOC_T stack_push_copy(struct Stack *stack, VAL_LOC_T loc, VAL_LOC_T size)
+{
+    char *dst;
+
+    if (size == 0) {
+        return stack->top;
+    }
+
+    stack_reserve(stack, size);
+
+    dst = stack->buffer + stack->top;
+    memcpy(dst, stack->buffer + loc, size);
+    stack->top += size;
+
+    return stack->top - size;
+}
+
 /** Peek a size_t at a given location */
 VAL_SIZE_T stack_peek_size(struct Stack *stack, VAL_LOC_T loc)
 {
@@ -15,12 +15,16 @@ struct Stack {
 };
 
 void stack_init(struct Stack *stack);
+void stack_init_copy(struct Stack *stack, struct Stack *src);
 void stack_deinit(struct Stack *stack);
 
 /* This function may reallocate stack buffer,
    therefore data may not point to stack. */
 VAL_LOC_T stack_push(struct Stack *stack, VAL_LOC_T size, char *data);
 
+/* Pushes a copy of a range of the stack itself onto the top. */
+VAL_LOC_T stack_push_copy(struct Stack *stack, VAL_LOC_T loc, VAL_LOC_T size);
+
 VAL_SIZE_T stack_peek_size(struct Stack *stack, VAL_LOC_T loc);
 VAL_TYPE_T stack_peek_type(struct Stack *stack, VAL_LOC_T loc);
 void *stack_peek_ptr(struct Stack *stack, VAL_LOC_T loc);
@@ -27,6 +27,27 @@ void sym_map_init_local(
     memset(&sym_map->root, 0, sizeof(sym_map->root));
 }
 
+static void sym_map_node_copy(struct SymMapNode *node, struct SymMapNode *src)
+{
+    int i;
+    *node = *src;
+    if (src->children.cap) {
+        node->children.data = mem_malloc(
+            src->children.cap * sizeof(*node->children.data));
+        for (i = 0; i < src->children.size; ++i) {
+            sym_map_node_copy(
+                node->children.data + i,
+                src->children.data + i);
+        }
+    }
+}
+
+void sym_map_init_copy(struct SymMap *sym_map, struct SymMap *src)
+{
+    sym_map->parent = src->parent;
+    sym_map_node_copy(&sym_map->root, &src->root);
+}
+
 static void sym_map_node_free(struct SymMapNode *node)
 {
     int i;
@@ -21,6 +21,7 @@ struct SymMap {
 
 void sym_map_init_global(struct SymMap *sym_map);
 void sym_map_init_local(struct SymMap *sym_map, struct SymMap *parent);
+void sym_map_init_copy(struct SymMap *sym_map, struct SymMap *src);
 void sym_map_deinit(struct SymMap *sym_map);
 
 void sym_map_insert(
@@ -0,0 +1,483 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#if defined(__AVX2__)
+#   include <immintrin.h>
+#   define VEC_AVX2
+#elif defined(__SSE2__)
+#   include <emmintrin.h>
+#   define VEC_SSE2
+#endif
+
+#include "vec_kernel.h"
+
+/* Scalar implementations, also used for the loop remainders.
+ * ==========================================================
+ */
+
+static VAL_INT_T vec_int_op(enum VecOp op, VAL_INT_T x, VAL_INT_T y)
+{
+    switch (op) {
+    case VEC_ADD:
+        return x + y;
+    case VEC_SUB:
+        return x - y;
+    case VEC_MUL:
+        return x * y;
+    case VEC_DIV:
+        return x / y;
+    }
+    return 0;
+}
+
+static VAL_REAL_T vec_real_op(enum VecOp op, VAL_REAL_T x, VAL_REAL_T y)
+{
+    switch (op) {
+    case VEC_ADD:
+        return x + y;
+    case VEC_SUB:
+        return x - y;
+    case VEC_MUL:
+        return x * y;
+    case VEC_DIV:
+        return x / y;
+    }
+    return 0.0;
+}
+
+/* Element-wise arythmetic.
+ * ========================
+ */
+
+void vec_int_binary(
+        enum VecOp op,
+        VAL_INT_T *x,
+        VAL_INT_T *y,
+        VAL_INT_T *out,
+        int len)
+{
+    int i = 0;
+
+#if defined(VEC_AVX2)
+    if (op == VEC_ADD || op == VEC_SUB) {
+        for (; i + 4 <= len; i += 4) {
+            __m256i vx = _mm256_loadu_si256((__m256i*)(x + i));
+            __m256i vy = _mm256_loadu_si256((__m256i*)(y + i));
+            __m256i vr = (op == VEC_ADD)
+                ? _mm256_add_epi64(vx, vy)
+                : _mm256_sub_epi64(vx, vy);
+            _mm256_storeu_si256((__m256i*)(out + i), vr);
+        }
+    }
+#elif defined(VEC_SSE2)
+    if (op == VEC_ADD || op == VEC_SUB) {
+        for (; i + 2 <= len; i += 2) {
+            __m128i vx = _mm_loadu_si128((__m128i*)(x + i));
+            __m128i vy = _mm_loadu_si128((__m128i*)(y + i));
+            __m128i vr = (op == VEC_ADD)
+                ? _mm_add_epi64(vx, vy)
+                : _mm_sub_epi64(vx, vy);
+            _mm_storeu_si128((__m128i*)(out + i), vr);
+        }
+    }
+#endif
+
+    for (; i < len; ++i) {
+        out[i] = vec_int_op(op, x[i], y[i]);
+    }
+}
+
+void vec_real_binary(
+        enum VecOp op,
+        VAL_REAL_T *x,
+        VAL_REAL_T *y,
+        VAL_REAL_T *out,
+        int len)
+{
+    int i = 0;
+
+#if defined(VEC_AVX2)
+    for (; i + 4 <= len; i += 4) {
+        __m256d vx = _mm256_loadu_pd(x + i);
+        __m256d vy = _mm256_loadu_pd(y + i);
+        __m256d vr;
+        switch (op) {
+        case VEC_ADD:
+            vr = _mm256_add_pd(vx, vy);
+            break;
+        case VEC_SUB:
+            vr = _mm256_sub_pd(vx, vy);
+            break;
+        case VEC_MUL:
+            vr = _mm256_mul_pd(vx, vy);
+            break;
+        default:
+            vr = _mm256_div_pd(vx, vy);
+            break;
+        }
+        _mm256_storeu_pd(out + i, vr);
+    }
+#elif defined(VEC_SSE2)
+    for (; i + 2 <= len; i += 2) {
+        __m128d vx = _mm_loadu_pd(x + i);
+        __m128d vy = _mm_loadu_pd(y + i);
+        __m128d vr;
+        switch (op) {
+        case VEC_ADD:
+            vr = _mm_add_pd(vx, vy);
+            break;
+        case VEC_SUB:
+            vr = _mm_sub_pd(vx, vy);
+            break;
+        case VEC_MUL:
+            vr = _mm_mul_pd(vx, vy);
+            break;
+        default:
+            vr = _mm_div_pd(vx, vy);
+            break;
+        }
+        _mm_storeu_pd(out + i, vr);
+    }
+#endif
+
+    for (; i < len; ++i) {
+        out[i] = vec_real_op(op, x[i], y[i]);
+    }
+}
+
+/* Element-wise comparison.
+ * ========================
+ */
+
+void vec_int_lt(VAL_INT_T *x, VAL_INT_T *y, VAL_BOOL_T *out, int len)
+{
+    int i = 0;
+
+#if defined(VEC_AVX2)
+    for (; i + 4 <= len; i += 4) {
+        __m256i vx = _mm256_loadu_si256((__m256i*)(x + i));
+        __m256i vy = _mm256_loadu_si256((__m256i*)(y + i));
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(vy, vx)));
+        out[i + 0] = (mask >> 0) & 1;
+        out[i + 1] = (mask >> 1) & 1;
+        out[i + 2] = (mask >> 2) & 1;
+        out[i + 3] = (mask >> 3) & 1;
+    }
+#endif
+
+    for (; i < len; ++i) {
+        out[i] = x[i] < y[i];
+    }
+}
+
+void vec_int_eq(VAL_INT_T *x, VAL_INT_T *y, VAL_BOOL_T *out, int len)
+{
+    int i = 0;
+
+#if defined(VEC_AVX2)
+    for (; i + 4 <= len; i += 4) {
+        __m256i vx = _mm256_loadu_si256((__m256i*)(x + i));
+        __m256i vy = _mm256_loadu_si256((__m256i*)(y + i));
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(vx, vy)));
+        out[i + 0] = (mask >> 0) & 1;
+        out[i + 1] = (mask >> 1) & 1;
+        out[i + 2] = (mask >> 2) & 1;
+        out[i + 3] = (mask >> 3) & 1;
+    }
+#endif
+
+    for (; i < len; ++i) {
+        out[i] = x[i] == y[i];
+    }
+}
+
+void vec_real_lt(VAL_REAL_T *x, VAL_REAL_T *y, VAL_BOOL_T *out, int len)
+{
+    int i = 0;
+
+#if defined(VEC_AVX2)
+    for (; i + 4 <= len; i += 4) {
+        __m256d vx = _mm256_loadu_pd(x + i);
+        __m256d vy = _mm256_loadu_pd(y + i);
+        int mask = _mm256_movemask_pd(_mm256_cmp_pd(vx, vy, _CMP_LT_OQ));
+        out[i + 0] = (mask >> 0) & 1;
+        out[i + 1] = (mask >> 1) & 1;
+        out[i + 2] = (mask >> 2) & 1;
+        out[i + 3] = (mask >> 3) & 1;
+    }
+#elif defined(VEC_SSE2)
+    for (; i + 2 <= len; i += 2) {
+        __m128d vx = _mm_loadu_pd(x + i);
+        __m128d vy = _mm_loadu_pd(y + i);
+        int mask = _mm_movemask_pd(_mm_cmplt_pd(vx, vy));
+        out[i + 0] = (mask >> 0) & 1;
+        out[i + 1] = (mask >> 1) & 1;
+    }
+#endif
+
+    for (; i < len; ++i) {
+        out[i] = x[i] < y[i];
+    }
+}
+
+void vec_real_eq(VAL_REAL_T *x, VAL_REAL_T *y, VAL_BOOL_T *out, int len)
+{
+    int i = 0;
+
+#if defined(VEC_AVX2)
+    for (; i + 4 <= len; i += 4) {
+        __m256d vx = _mm256_loadu_pd(x + i);
+        __m256d vy = _mm256_loadu_pd(y + i);
+        int mask = _mm256_movemask_pd(_mm256_cmp_pd(vx, vy, _CMP_EQ_OQ));
+        out[i + 0] = (mask >> 0) & 1;
+        out[i + 1] = (mask >> 1) & 1;
+        out[i + 2] = (mask >> 2) & 1;
+        out[i + 3] = (mask >> 3) & 1;
+    }
+#elif defined(VEC_SSE2)
+    for (; i + 2 <= len; i += 2) {
+        __m128d vx = _mm_loadu_pd(x + i);
+        __m128d vy = _mm_loadu_pd(y + i);
+        int mask = _mm_movemask_pd(_mm_cmpeq_pd(vx, vy));
+        out[i + 0] = (mask >> 0) & 1;
+        out[i + 1] = (mask >> 1) & 1;
+    }
+#endif
+
+    for (; i < len; ++i) {
+        out[i] = x[i] == y[i];
+    }
+}
+
+/* Reductions.
+ * ===========
+ */
+
+VAL_INT_T vec_int_sum(VAL_INT_T *x, int len)
+{
+    int i = 0;
+    VAL_INT_T result = 0;
+
+#if defined(VEC_AVX2)
+    VAL_INT_T lanes[4];
+    __m256i acc = _mm256_setzero_si256();
+    for (; i + 4 <= len; i += 4) {
+        acc = _mm256_add_epi64(acc, _mm256_loadu_si256((__m256i*)(x + i)));
+    }
+    _mm256_storeu_si256((__m256i*)lanes, acc);
+    result = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(VEC_SSE2)
+    VAL_INT_T lanes[2];
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 2 <= len; i += 2) {
+        acc = _mm_add_epi64(acc, _mm_loadu_si128((__m128i*)(x + i)));
+    }
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    result = lanes[0] + lanes[1];
+#endif
+
+    for (; i < len; ++i) {
+        result += x[i];
+    }
+
+    return result;
+}
+
+VAL_REAL_T vec_real_sum(VAL_REAL_T *x, int len)
+{
+    int i = 0;
+    VAL_REAL_T result = 0.0;
+
+#if defined(VEC_AVX2)
+    VAL_REAL_T lanes[4];
+    __m256d acc = _mm256_setzero_pd();
+    for (; i + 4 <= len; i += 4) {
+        acc = _mm256_add_pd(acc, _mm256_loadu_pd(x + i));
+    }
+    _mm256_storeu_pd(lanes, acc);
+    result = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(VEC_SSE2)
+    VAL_REAL_T lanes[2];
+    __m128d acc = _mm_setzero_pd();
+    for (; i + 2 <= len; i += 2) {
+        acc = _mm_add_pd(acc, _mm_loadu_pd(x + i));
+    }
+    _mm_storeu_pd(lanes, acc);
+    result = lanes[0] + lanes[1];
+#endif
+
+    for (; i < len; ++i) {
+        result += x[i];
+    }
+
+    return result;
+}
+
+VAL_INT_T vec_int_min(VAL_INT_T *x, int len)
+{
+    int i;
+    VAL_INT_T result = x[0];
+    for (i = 1; i < len; ++i) {
+        if (x[i] < result) {
+            result = x[i];
+        }
+    }
+    return result;
+}
+
+VAL_INT_T vec_int_max(VAL_INT_T *x, int len)
+{
+    int i;
+    VAL_INT_T result = x[0];
+    for (i = 1; i < len; ++i) {
+        if (x[i] > result) {
+            result = x[i];
+        }
+    }
+    return result;
+}
+
+VAL_REAL_T vec_real_min(VAL_REAL_T *x, int len)
+{
+    int i = 1;
+    VAL_REAL_T result = x[0];
+
+#if defined(VEC_AVX2)
+    if (len >= 4) {
+        VAL_REAL_T lanes[4];
+        __m256d acc = _mm256_loadu_pd(x);
+        for (i = 4; i + 4 <= len; i += 4) {
+            acc = _mm256_min_pd(acc, _mm256_loadu_pd(x + i));
+        }
+        _mm256_storeu_pd(lanes, acc);
+        result = lanes[0];
+        result = lanes[1] < result ? lanes[1] : result;
+        result = lanes[2] < result ? lanes[2] : result;
+        result = lanes[3] < result ? lanes[3] : result;
+    }
+#elif defined(VEC_SSE2)
+    if (len >= 2) {
+        VAL_REAL_T lanes[2];
+        __m128d acc = _mm_loadu_pd(x);
+        for (i = 2; i + 2 <= len; i += 2) {
+            acc = _mm_min_pd(acc, _mm_loadu_pd(x + i));
+        }
+        _mm_storeu_pd(lanes, acc);
+        result = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+    }
+#endif
+
+    for (; i < len; ++i) {
+        if (x[i] < result) {
+            result = x[i];
+        }
+    }
+
+    return result;
+}
+
+VAL_REAL_T vec_real_max(VAL_REAL_T *x, int len)
+{
+    int i = 1;
+    VAL_REAL_T result = x[0];
+
+#if defined(VEC_AVX2)
+    if (len >= 4) {
+        VAL_REAL_T lanes[4];
+        __m256d acc = _mm256_loadu_pd(x);
+        for (i = 4; i + 4 <= len; i += 4) {
+            acc = _mm256_max_pd(acc, _mm256_loadu_pd(x + i));
+        }
+        _mm256_storeu_pd(lanes, acc);
+        result = lanes[0];
+        result = lanes[1] > result ? lanes[1] : result;
+        result = lanes[2] > result ? lanes[2] : result;
+        result = lanes[3] > result ? lanes[3] : result;
+    }
+#elif defined(VEC_SSE2)
+    if (len >= 2) {
+        VAL_REAL_T lanes[2];
+        __m128d acc = _mm_loadu_pd(x);
+        for (i = 2; i + 2 <= len; i += 2) {
+            acc = _mm_max_pd(acc, _mm_loadu_pd(x + i));
+        }
+        _mm_storeu_pd(lanes, acc);
+        result = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+    }
+#endif
+
+    for (; i < len; ++i) {
+        if (x[i] > result) {
+            result = x[i];
+        }
+    }
+
+    return result;
+}
+
+VAL_INT_T vec_int_dot(VAL_INT_T *x, VAL_INT_T *y, int len)
+{
+    int i;
+    VAL_INT_T result = 0;
+    for (i = 0; i < len; ++i) {
+        result += x[i] * y[i];
+    }
+    return result;
+}
+
+VAL_REAL_T vec_real_dot(VAL_REAL_T *x, VAL_REAL_T *y, int len)
+{
+    int i = 0;
+    VAL_REAL_T result = 0.0;
+
+#if defined(VEC_AVX2)
+    VAL_REAL_T lanes[4];
+    __m256d acc = _mm256_setzero_pd();
+    for (; i + 4 <= len; i += 4) {
+        acc = _mm256_add_pd(acc, _mm256_mul_pd(
+            _mm256_loadu_pd(x + i),
+            _mm256_loadu_pd(y + i)));
+    }
+    _mm256_storeu_pd(lanes, acc);
+    result = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(VEC_SSE2)
+    VAL_REAL_T lanes[2];
+    __m128d acc = _mm_setzero_pd();
+    for (; i + 2 <= len; i += 2) {
+        acc = _mm_add_pd(acc, _mm_mul_pd(
+            _mm_loadu_pd(x + i),
+            _mm_loadu_pd(y + i)));
+    }
+    _mm_storeu_pd(lanes, acc);
+    result = lanes[0] + lanes[1];
+#endif
+
+    for (; i < len; ++i) {
+        result += x[i] * y[i];
+    }
+
+    return result;
+}
+
+/* Scans.
+ * ======
+ */
+
+void vec_int_scan(VAL_INT_T *x, VAL_INT_T *out, int len)
+{
+    int i;
+    VAL_INT_T acc = 0;
+    for (i = 0; i < len; ++i) {
+        acc += x[i];
+        out[i] = acc;
+    }
+}
+
+void vec_real_scan(VAL_REAL_T *x, VAL_REAL_T *out, int len)
+{
+    int i;
+    VAL_REAL_T acc = 0.0;
+    for (i = 0; i < len; ++i) {
+        acc += x[i];
+        out[i] = acc;
+    }
+}
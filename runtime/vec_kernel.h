@@ -0,0 +1,56 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#ifndef VEC_KERNEL_H
+#define VEC_KERNEL_H
+
+#include "rt_val.h"
+
+/*
+ * Kernels operating on unboxed, contiguous buffers of numeric values.
+ * They use the AVX2 or SSE2 instructions if the compiler targets them and
+ * fall back to plain loops otherwise.
+ */
+
+enum VecOp {
+    VEC_ADD,
+    VEC_SUB,
+    VEC_MUL,
+    VEC_DIV
+};
+
+void vec_int_binary(
+        enum VecOp op,
+        VAL_INT_T *x,
+        VAL_INT_T *y,
+        VAL_INT_T *out,
+        int len);
+
+void vec_real_binary(
+        enum VecOp op,
+        VAL_REAL_T *x,
+        VAL_REAL_T *y,
+        VAL_REAL_T *out,
+        int len);
+
+void vec_int_lt(VAL_INT_T *x, VAL_INT_T *y, VAL_BOOL_T *out, int len);
+void vec_int_eq(VAL_INT_T *x, VAL_INT_T *y, VAL_BOOL_T *out, int len);
+void vec_real_lt(VAL_REAL_T *x, VAL_REAL_T *y, VAL_BOOL_T *out, int len);
+void vec_real_eq(VAL_REAL_T *x, VAL_REAL_T *y, VAL_BOOL_T *out, int len);
+
+VAL_INT_T vec_int_sum(VAL_INT_T *x, int len);
+VAL_REAL_T vec_real_sum(VAL_REAL_T *x, int len);
+
+/* The extrema kernels require non-empty input. */
+VAL_INT_T vec_int_min(VAL_INT_T *x, int len);
+VAL_INT_T vec_int_max(VAL_INT_T *x, int len);
+VAL_REAL_T vec_real_min(VAL_REAL_T *x, int len);
+VAL_REAL_T vec_real_max(VAL_REAL_T *x, int len);
+
+VAL_INT_T vec_int_dot(VAL_INT_T *x, VAL_INT_T *y, int len);
+VAL_REAL_T vec_real_dot(VAL_REAL_T *x, VAL_REAL_T *y, int len);
+
+/* Inclusive prefix sums; the input and output may be the same buffer. */
+void vec_int_scan(VAL_INT_T *x, VAL_INT_T *out, int len);
+void vec_real_scan(VAL_REAL_T *x, VAL_REAL_T *out, int len);
+
+#endif
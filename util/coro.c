@@ -0,0 +1,120 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#define _XOPEN_SOURCE 700
+#define _DEFAULT_SOURCE
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "memory.h"
+#include "coro.h"
+
+struct Coro {
+    ucontext_t caller;
+    ucontext_t context;
+    char *stack;
+    size_t stack_size;
+    CoroEntry entry;
+    void *data;
+    bool running;
+    bool finished;
+};
+
+/*
+ * The makecontext function only passes int arguments portably, therefore the
+ * pointer to the coroutine is split in two halves.
+ */
+static void coro_start(unsigned int high, unsigned int low)
+{
+    struct Coro *coro = (struct Coro*)(((uintptr_t)high << 16 << 16) | low);
+    coro->entry(coro, coro->data);
+    coro->finished = true;
+    coro->running = false;
+    /* Returning switches to the caller through the context link. */
+}
+
+/*
+ * The stack is only reserved, the pages get committed as the recursion reaches
+ * them. The lowest page is left inaccessible, so that an overflow faults
+ * instead of corrupting the neighbouring memory.
+ */
+static void coro_alloc_stack(struct Coro *coro, size_t stack_size)
+{
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+
+    stack_size = (stack_size + page_size - 1) / page_size * page_size;
+    coro->stack_size = stack_size + page_size;
+    coro->stack = mmap(
+        NULL, coro->stack_size,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+        -1, 0);
+
+    if (coro->stack == MAP_FAILED || mprotect(coro->stack, page_size, PROT_NONE)) {
+        LOG_ERROR("Failed allocating a coroutine stack.");
+        exit(1);
+    }
+}
+
+struct Coro *coro_make(CoroEntry entry, void *data, size_t stack_size)
+{
+    struct Coro *coro = mem_malloc(sizeof(*coro));
+    uintptr_t address = (uintptr_t)coro;
+
+    coro_alloc_stack(coro, stack_size);
+    coro->entry = entry;
+    coro->data = data;
+    coro->running = false;
+    coro->finished = false;
+
+    if (getcontext(&coro->context)) {
+        LOG_ERROR("Failed getting a coroutine context.");
+        exit(1);
+    }
+    coro->context.uc_stack.ss_sp = coro->stack;
+    coro->context.uc_stack.ss_size = coro->stack_size;
+    coro->context.uc_link = &coro->caller;
+    makecontext(
+        &coro->context,
+        (void (*)(void))coro_start, 2,
+        (unsigned int)(address >> 16 >> 16),
+        (unsigned int)address);
+
+    return coro;
+}
+
+void coro_free(struct Coro *coro)
+{
+    munmap(coro->stack, coro->stack_size);
+    mem_free(coro);
+}
+
+bool coro_resume(struct Coro *coro)
+{
+    if (coro->finished || coro->running) {
+        return false;
+    }
+    coro->running = true;
+    swapcontext(&coro->caller, &coro->context);
+    return !coro->finished;
+}
+
+void coro_yield(struct Coro *coro)
+{
+    coro->running = false;
+    swapcontext(&coro->context, &coro->caller);
+}
+
+bool coro_running(struct Coro *coro)
+{
+    return coro->running;
+}
+
+bool coro_finished(struct Coro *coro)
+{
+    return coro->finished;
+}
@@ -0,0 +1,38 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#ifndef CORO_H
+#define CORO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * A coroutine running a function on a stack of its own, which may suspend
+ * itself and be resumed later by the thread that has started it.
+ */
+struct Coro;
+
+/**
+ * The evaluation is recursive, a coroutine running it needs a stack as large
+ * as that of a main thread.
+ */
+#define CORO_STACK_SIZE (8 * 1024 * 1024)
+
+typedef void (*CoroEntry)(struct Coro *coro, void *data);
+
+struct Coro *coro_make(CoroEntry entry, void *data, size_t stack_size);
+void coro_free(struct Coro *coro);
+
+/**
+ * Runs the coroutine until it yields or its function returns. Returns false
+ * once the function has returned.
+ */
+bool coro_resume(struct Coro *coro);
+
+/** Suspends the coroutine, may only be called from within it. */
+void coro_yield(struct Coro *coro);
+
+bool coro_running(struct Coro *coro);
+bool coro_finished(struct Coro *coro);
+
+#endif
@@ -8,18 +8,12 @@
 #include "memory.h"
 #include "error.h"
 
-struct ErrFrame *err_stack = NULL;
-struct ErrFrame *err_stack_end = NULL;
+_Thread_local struct ErrFrame *err_stack = NULL;
+_Thread_local struct ErrFrame *err_stack_end = NULL;
 
 void err_reset(void)
 {
-    err_stack_end = NULL;
-    while (err_stack) {
-        struct ErrFrame *next = err_stack->next;
-        mem_free(err_stack->message);
-        mem_free(err_stack);
-        err_stack = next;
-    }
+    err_discard(err_detach());
 }
 
 bool err_state(void)
@@ -27,6 +21,35 @@ bool err_state(void)
     return (bool)err_stack;
 }
 
+struct ErrFrame *err_detach(void)
+{
+    struct ErrFrame *result = err_stack;
+    err_stack = NULL;
+    err_stack_end = NULL;
+    return result;
+}
+
+void err_attach(struct ErrFrame *frames)
+{
+    while (frames) {
+        struct ErrFrame *next = frames->next;
+        frames->next = NULL;
+        LIST_APPEND(frames, &err_stack, &err_stack_end);
+        frames = next;
+    }
+}
+
+void err_discard(struct ErrFrame *frames)
+{
+    while (frames) {
+        struct ErrFrame *next = frames->next;
+        mem_free(frames->message);
+        mem_free(frames->src_loc);
+        mem_free(frames);
+        frames = next;
+    }
+}
+
 char *err_msg(void)
 {
     char *result = NULL;
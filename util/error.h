@@ -21,12 +21,27 @@ struct ErrFrame {
     struct ErrFrame *next;
 };
 
-extern struct ErrFrame *err_stack;
-extern struct ErrFrame *err_stack_end;
+/*
+ * The error stack is kept per thread, so that the interpreters running on
+ * separate threads do not see each other's errors.
+ */
+extern _Thread_local struct ErrFrame *err_stack;
+extern _Thread_local struct ErrFrame *err_stack_end;
 
+/** Releases the error frames of the calling thread. */
 void err_reset(void);
 bool err_state(void);
 char *err_msg(void);
+
+/**
+ * Takes the error frames away from the calling thread and append them to the
+ * errors of another one, so that the errors of the worker threads may be
+ * reported by the thread which has spawned them.
+ */
+struct ErrFrame *err_detach(void);
+void err_attach(struct ErrFrame *frames);
+void err_discard(struct ErrFrame *frames);
+
 void err_report(void);
 
 #define err_push_src(MODULE, SRC_LOC, FORMAT, ...) \
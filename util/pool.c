@@ -0,0 +1,144 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "memory.h"
+#include "pool.h"
+
+struct Pool {
+    pthread_t *threads;
+    int size;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    unsigned generation;
+    bool stopping;
+
+    PoolTask task;
+    void *data;
+    int count;
+    int next;
+    int pending;
+};
+
+/**
+ * Runs the iterations left in the current loop. Must be called with the
+ * mutex locked, which is released for the duration of each call.
+ */
+static void pool_work(struct Pool *pool)
+{
+    while (pool->next < pool->count) {
+        int index = pool->next++;
+        PoolTask task = pool->task;
+        void *data = pool->data;
+
+        pthread_mutex_unlock(&pool->mutex);
+        task(data, index);
+        pthread_mutex_lock(&pool->mutex);
+
+        if (--pool->pending == 0) {
+            pthread_cond_signal(&pool->done_cond);
+        }
+    }
+}
+
+static void *pool_thread(void *arg)
+{
+    struct Pool *pool = arg;
+    unsigned seen = 0;
+
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (!pool->stopping && pool->generation == seen) {
+            pthread_cond_wait(&pool->work_cond, &pool->mutex);
+        }
+        if (pool->stopping) {
+            break;
+        }
+        seen = pool->generation;
+        pool_work(pool);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return NULL;
+}
+
+int pool_default_size(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 1 ? (int)count - 1 : 0;
+}
+
+struct Pool *pool_make(int size)
+{
+    int i;
+    struct Pool *pool = mem_malloc(sizeof(*pool));
+
+    pool->threads = mem_malloc((size + 1) * sizeof(*pool->threads));
+    pool->size = 0;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+    pool->generation = 0;
+    pool->stopping = false;
+    pool->count = 0;
+    pool->next = 0;
+    pool->pending = 0;
+
+    /* A worker that failed to start only makes the pool smaller. */
+    for (i = 0; i < size; ++i) {
+        if (pthread_create(pool->threads + pool->size, NULL, pool_thread, pool)) {
+            LOG_ERROR("Failed starting a pool thread.");
+            break;
+        }
+        ++pool->size;
+    }
+
+    return pool;
+}
+
+void pool_free(struct Pool *pool)
+{
+    int i;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (i = 0; i < pool->size; ++i) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_mutex_destroy(&pool->mutex);
+    mem_free(pool->threads);
+    mem_free(pool);
+}
+
+void pool_run(struct Pool *pool, PoolTask task, void *data, int count)
+{
+    pthread_mutex_lock(&pool->mutex);
+
+    pool->task = task;
+    pool->data = data;
+    pool->count = count;
+    pool->next = 0;
+    pool->pending = count;
+    ++pool->generation;
+    pthread_cond_broadcast(&pool->work_cond);
+
+    pool_work(pool);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->done_cond, &pool->mutex);
+    }
+
+    pthread_mutex_unlock(&pool->mutex);
+}
@@ -0,0 +1,28 @@
+/* Copyright (C) 2014-2016 Krzysztof Stachowiak */
+
+#ifndef POOL_H
+#define POOL_H
+
+/**
+ * A pool of worker threads running the iterations of a parallel loop. The
+ * calling thread takes part in the loop as well, so a pool of size zero
+ * simply runs the loop on the calling thread.
+ */
+struct Pool;
+
+typedef void (*PoolTask)(void *data, int index);
+
+/** Returns the number of the workers which saturates the processors. */
+int pool_default_size(void);
+
+struct Pool *pool_make(int size);
+void pool_free(struct Pool *pool);
+
+/**
+ * Calls the task for each index in [0, count) and returns once all the calls
+ * have finished. The calls may be made concurrently in any order. A pool may
+ * only run one loop at a time.
+ */
+void pool_run(struct Pool *pool, PoolTask task, void *data, int count);
+
+#endif
@@ -31,7 +31,7 @@ void ts_deinit(void)
 
 #include <windows.h>
 
-static struct StartStack {
+static _Thread_local struct StartStack {
     LARGE_INTEGER *data;
     int size, cap;
 } starts = { NULL, 0, 0 };
@@ -69,7 +69,7 @@ void ts_deinit(void)
 
 #include <time.h>
 
-static struct StartStack {
+static _Thread_local struct StartStack {
     struct timespec *data;
     int size, cap;
 } starts = { NULL, 0, 0 };